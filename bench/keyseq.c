@@ -0,0 +1,162 @@
+// Times decoding terminal input with keyseq_decode, against the switch
+// platform_get_key used before the decoder had its own module.
+//
+// Usage: keyseq [megabytes]
+//
+// Three inputs of the given size are decoded one key at a time: typing
+// (text with a few arrows and backspaces), navigation (only the escape
+// sequences the old switch knew) and modified keys (Ctrl+arrows, SS3 F1,
+// Alt+letter), which the old switch misreads, so only keyseq_decode is
+// timed on them. Each decoder's best of three runs is reported.
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "keyseq.h"
+
+#define RUNS 3
+
+typedef size_t (*Decoder)(const unsigned char* data, size_t length, int complete, KeyEvent* event);
+
+typedef struct {
+    const char* name;
+    const char* const* keys;
+    size_t count;
+    int old_reads_it;
+} Input;
+
+static const char* const typing_keys[] = {
+    "t", "h", "e", " ", "q", "u", "i", "c", "k", " ", "b", "r", "o", "w", "n", " ",
+    "f", "o", "x", ",", " ", "j", "u", "m", "p", "s", "\x7f", "\r", "\x1b[D", "\x1b[C",
+};
+
+static const char* const navigation_keys[] = {
+    "\x1b[A", "\x1b[B", "\x1b[C", "\x1b[D", "\x1b[H", "\x1b[F", "\x1b[3~", "\x1b[5~", "\x1b[6~",
+};
+
+static const char* const modified_keys[] = {
+    "\x1b[1;5C", "\x1b[1;5D", "\x1b[1;2A", "\x1b[1;2B", "\x1bOP", "\x1bx", "\x1b[3;5~", "\x13",
+};
+
+static const Input inputs[] = {
+    { "typing", typing_keys, sizeof(typing_keys) / sizeof(typing_keys[0]), 1 },
+    { "navigation", navigation_keys, sizeof(navigation_keys) / sizeof(navigation_keys[0]), 1 },
+    { "modified keys", modified_keys, sizeof(modified_keys) / sizeof(modified_keys[0]), 0 },
+};
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// The switch from platform_get_key, reading a buffer instead of the
+// terminal. It never waits for more bytes, so `complete` is unused.
+static size_t old_decode(const unsigned char* data, size_t length, int complete, KeyEvent* event) {
+    (void)complete;
+    unsigned char ch = data[0];
+    size_t used = 1;
+    event->key = ch;
+    event->ctrl = 0;
+    event->alt = 0;
+    event->shift = 0;
+
+    if (ch == '\033' && length >= 3 && data[1] == '[') {
+        used = 3;
+        switch (data[2]) {
+            case 'A': event->key = KEY_UP; break;
+            case 'B': event->key = KEY_DOWN; break;
+            case 'C': event->key = KEY_RIGHT; break;
+            case 'D': event->key = KEY_LEFT; break;
+            case 'H': event->key = KEY_HOME; break;
+            case 'F': event->key = KEY_END; break;
+            default:
+                if (data[2] >= '0' && data[2] <= '9' && length >= 4) {
+                    used = 4;
+                    if (data[3] == '~') {
+                        switch (data[2]) {
+                            case '3': event->key = KEY_DELETE; break;
+                            case '5': event->key = KEY_PAGE_UP; break;
+                            case '6': event->key = KEY_PAGE_DOWN; break;
+                        }
+                    }
+                }
+                break;
+        }
+    }
+
+    if (ch == 127 || ch == 8) {
+        event->key = KEY_BACKSPACE;
+    }
+    return used;
+}
+
+// Keys picked at random from the input's list until size bytes are filled
+static size_t fill(unsigned char* data, size_t size, const Input* input) {
+    unsigned int seed = 1;
+    size_t used = 0;
+    while (1) {
+        seed = seed * 1103515245 + 12345;
+        const char* key = input->keys[(seed >> 16) % input->count];
+        size_t length = strlen(key);
+        if (used + length > size) return used;
+        memcpy(data + used, key, length);
+        used += length;
+    }
+}
+
+// Best MB/s of RUNS passes over data; the keys of a pass go to *keys
+static double time_decoder(Decoder decode, const unsigned char* data, size_t size, size_t* keys) {
+    double best = 0;
+    for (int run = 0; run < RUNS; run++) {
+        KeyEvent event;
+        size_t offset = 0;
+        size_t count = 0;
+        double start = now_seconds();
+        while (offset < size) {
+            offset += decode(data + offset, size - offset, 1, &event);
+            count++;
+        }
+        double elapsed = now_seconds() - start;
+        if (run == 0 || elapsed < best) best = elapsed;
+        *keys = count;
+    }
+    return size / best / 1e6;
+}
+
+int main(int argc, char** argv) {
+    size_t megabytes = argc > 1 ? (size_t)atoi(argv[1]) : 64;
+    if (megabytes == 0) {
+        fprintf(stderr, "usage: %s [megabytes]\n", argv[0]);
+        return 2;
+    }
+
+    size_t capacity = megabytes << 20;
+    unsigned char* data = malloc(capacity);
+    if (!data) {
+        fprintf(stderr, "keyseq: out of memory\n");
+        return 1;
+    }
+
+    // Calls go through a pointer so neither decoder is inlined into the loop
+    Decoder volatile new_decoder = keyseq_decode;
+    Decoder volatile old_decoder = old_decode;
+
+    printf("%llu MB per input, best of %d\n", (unsigned long long)megabytes, RUNS);
+    for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++) {
+        size_t size = fill(data, capacity, &inputs[i]);
+        size_t keys;
+        double new_rate = time_decoder(new_decoder, data, size, &keys);
+        printf("  %-14s keyseq %6.0f MB/s %6.1f Mkeys/s", inputs[i].name, new_rate, keys / (size / new_rate));
+        if (inputs[i].old_reads_it) {
+            double old_rate = time_decoder(old_decoder, data, size, &keys);
+            printf("   switch %6.0f MB/s %6.1f Mkeys/s", old_rate, keys / (size / old_rate));
+        }
+        printf("\n");
+    }
+
+    free(data);
+    return 0;
+}
\ No newline at end of file
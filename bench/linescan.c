@@ -0,0 +1,143 @@
+// Times building the newline index of an in-memory text with each scan
+// kernel, against the memchr loop the piece buffers used before.
+//
+// Usage: linescan [megabytes]
+//
+// Two texts of the given size are scanned: short header-like lines and
+// long base64 lines. Each kernel's best of three runs is reported.
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "arena.h"
+#include "line_index.h"
+#include "linescan.h"
+
+#define RUNS 3
+
+typedef struct {
+    const char* name;
+    int kind;
+} Kernel;
+
+static const Kernel kernels[] = {
+    { "scalar", LINESCAN_SCALAR },
+    { "sse2", LINESCAN_SSE2 },
+    { "avx2", LINESCAN_AVX2 },
+};
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Lines of 20 to 56 bytes, like mail or HTTP headers
+static void fill_headers(char* data, size_t size) {
+    static const char* names[] = { "Host", "Accept", "Content-Type", "X-Request-Id", "Cache-Control" };
+    unsigned int seed = 1;
+    size_t i = 0;
+    while (i < size) {
+        seed = seed * 1103515245 + 12345;
+        const char* name = names[(seed >> 16) % 5];
+        int value = 10 + (int)((seed >> 8) % 30);
+        char line[128];
+        int n = snprintf(line, sizeof(line), "%s: %.*s\r\n", name, value, "abcdefghijklmnopqrstuvwxyz0123456789");
+        if ((size_t)n > size - i) n = (int)(size - i);
+        memcpy(data + i, line, (size_t)n);
+        i += (size_t)n;
+    }
+}
+
+// Lines of 200 base64 characters
+static void fill_base64(char* data, size_t size) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    unsigned int seed = 7;
+    for (size_t i = 0; i < size; i++) {
+        if (i % 201 == 200) {
+            data[i] = '\n';
+        } else {
+            seed = seed * 1103515245 + 12345;
+            data[i] = alphabet[(seed >> 16) & 63];
+        }
+    }
+}
+
+// The index the old way: one memchr and one append per line
+static int scan_memchr(const char* data, size_t size, LineIndex* index, size_t* crlf_count) {
+    const char* p = data;
+    const char* end = data + size;
+    while ((p = (const char*)memchr(p, '\n', (size_t)(end - p))) != NULL) {
+        if (p > data && p[-1] == '\r') (*crlf_count)++;
+        if (!line_index_append(index, (size_t)(p - data))) return 0;
+        p++;
+    }
+    return 1;
+}
+
+// Best time of RUNS scans with one kernel, or with memchr when kind < 0
+static double time_scan(const char* data, size_t size, int kind, size_t* lines) {
+    double best = 0;
+    for (int run = 0; run < RUNS; run++) {
+        Arena arena;
+        LineIndex index;
+        size_t crlf_count = 0;
+        arena_init(&arena);
+        line_index_init(&index, &arena);
+
+        double start = now_seconds();
+        int ok = kind < 0 ? scan_memchr(data, size, &index, &crlf_count)
+                          : linescan_build(data, 0, size, &index, &crlf_count);
+        double elapsed = now_seconds() - start;
+
+        *lines = index.count;
+        line_index_free(&index);
+        arena_free(&arena);
+        if (!ok) return -1;
+        if (run == 0 || elapsed < best) best = elapsed;
+    }
+    return best;
+}
+
+static void report(const char* label, const char* data, size_t size) {
+    size_t lines;
+    double seconds = time_scan(data, size, -1, &lines);
+    printf("%s, %llu MB, %llu lines (%.0f B/line)\n", label, (unsigned long long)(size >> 20),
+           (unsigned long long)lines, lines ? (double)size / lines : 0.0);
+    printf("  %-7s %6.2f GB/s\n", "memchr", size / seconds / 1e9);
+
+    for (size_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++) {
+        if (!linescan_use_kernel(kernels[i].kind)) {
+            printf("  %-7s not available\n", kernels[i].name);
+            continue;
+        }
+        seconds = time_scan(data, size, kernels[i].kind, &lines);
+        printf("  %-7s %6.2f GB/s\n", kernels[i].name, size / seconds / 1e9);
+    }
+    linescan_use_kernel(LINESCAN_AUTO);
+}
+
+int main(int argc, char** argv) {
+    size_t megabytes = argc > 1 ? (size_t)atol(argv[1]) : 256;
+    if (megabytes == 0) {
+        fprintf(stderr, "usage: %s [megabytes]\n", argv[0]);
+        return 2;
+    }
+
+    size_t size = megabytes << 20;
+    char* data = (char*)malloc(size);
+    if (!data) {
+        fprintf(stderr, "linescan: out of memory\n");
+        return 1;
+    }
+
+    fill_headers(data, size);
+    report("headers", data, size);
+    fill_base64(data, size);
+    report("base64", data, size);
+
+    free(data);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,115 @@
+// Times typing with many cursors: each key is one batched edit of the
+// document plus a redraw, and the last one is undone at the end.
+//
+// Usage: multicursor [lines] [cursors] [stride] [keys]
+//
+// The document is `lines` generated lines. The cursors form a column
+// `stride` lines apart, and the keys cycle through typing, Backspace,
+// Enter, Delete and the arrows. Frames are drawn to /dev/null. It fails
+// if any key takes longer than a frame at 60 Hz.
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "tui.h"
+#include "input.h"
+
+// One frame at 60 Hz
+#define FRAME_BUDGET_MS 16.7
+
+static const int key_cycle[] = {
+    'a', 'b', 'c', KEY_BACKSPACE, 'd', KEY_ENTER, 'e', KEY_RIGHT, 'f', KEY_DELETE, 'g', KEY_LEFT
+};
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static char* make_document(int lines, size_t* length) {
+    const char* text = "    value = compute(value, 42); // the quick brown fox jumps";
+    size_t line_length = strlen(text) + 1;
+    char* data = (char*)malloc((size_t)lines * line_length);
+    if (!data) return NULL;
+
+    for (int i = 0; i < lines; i++) {
+        memcpy(data + (size_t)i * line_length, text, line_length - 1);
+        data[(size_t)i * line_length + line_length - 1] = '\n';
+    }
+    *length = (size_t)lines * line_length;
+    return data;
+}
+
+int main(int argc, char** argv) {
+    int lines = argc > 1 ? atoi(argv[1]) : 1000000;
+    int cursors = argc > 2 ? atoi(argv[2]) : 10000;
+    int stride = argc > 3 ? atoi(argv[3]) : 100;
+    int keys = argc > 4 ? atoi(argv[4]) : 300;
+    if (lines < 1 || cursors < 1 || stride < 1 || keys < 1 || (long long)(cursors - 1) * stride >= lines) {
+        fprintf(stderr, "usage: %s [lines] [cursors] [stride] [keys], with (cursors - 1) * stride < lines\n",
+                argv[0]);
+        return 2;
+    }
+
+    size_t length;
+    char* data = make_document(lines, &length);
+    TextBuffer* buffer = buffer_create();
+    if (!data || !buffer || !buffer_load(buffer, data, length, 0)) {
+        fprintf(stderr, "multicursor: out of memory\n");
+        return 1;
+    }
+
+    // Frames go nowhere; the report is on stderr
+    if (!freopen("/dev/null", "w", stdout)) return 1;
+    static TUIState tui;
+    tui_init(&tui);
+
+    // The main cursor on top, the others below it
+    tui.cursor_x = 0;
+    tui.cursor_y = 0;
+    cursor_set_reserve(&tui.cursors, (size_t)cursors);
+    for (int i = 1; i < cursors; i++) {
+        cursor_set_add(&tui.cursors, buffer_get_offset(buffer, i * stride, 0));
+    }
+    cursor_set_normalize(&tui.cursors, buffer_get_offset(buffer, 0, 0));
+    tui_draw(&tui, buffer);
+
+    double total = 0;
+    double worst = 0;
+    int over_budget = 0;
+    for (int k = 0; k < keys; k++) {
+        KeyEvent event;
+        memset(&event, 0, sizeof(event));
+        event.key = key_cycle[k % (int)(sizeof(key_cycle) / sizeof(key_cycle[0]))];
+
+        double start = now_ms();
+        input_handle_key(&tui, buffer, event);
+        tui_draw(&tui, buffer);
+        double elapsed = now_ms() - start;
+
+        total += elapsed;
+        if (elapsed > worst) worst = elapsed;
+        if (elapsed > FRAME_BUDGET_MS) over_budget++;
+    }
+
+    double start = now_ms();
+    int line, column;
+    buffer_undo(buffer, &line, &column);
+    double undo = now_ms() - start;
+
+    fprintf(stderr, "%d lines, %llu cursors %d lines apart, %d keys\n", lines,
+            (unsigned long long)tui.cursors.count + 1, stride, keys);
+    fprintf(stderr, "  key + frame: %.2f ms mean, %.2f ms worst, %d of %d over %.1f ms\n",
+            total / keys, worst, over_budget, keys, FRAME_BUDGET_MS);
+    fprintf(stderr, "  undo of the last key: %.2f ms\n", undo);
+
+    buffer_destroy(buffer);
+    if (over_budget > 0) {
+        fprintf(stderr, "multicursor: %d keys took longer than a frame\n", over_budget);
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,109 @@
+// Times saving a large file through file_save, unedited and after many
+// scattered edits, against writing it one line at a time through stdio
+// the way saves used to.
+//
+// Usage: save [lines] [edits] [directory]
+//
+// The file is made in `directory` (default /tmp) and removed afterwards.
+// file_save includes its fsync calls; the line-by-line write does not.
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "buffer.h"
+#include "fileio.h"
+
+#define RUNS 3
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int make_file(const char* path, int lines) {
+    FILE* file = fopen(path, "wb");
+    if (!file) return 0;
+    for (int i = 0; i < lines; i++) {
+        fprintf(file, "%08d the quick brown fox jumps over the lazy dog\n", i);
+    }
+    return fclose(file) == 0;
+}
+
+// Every line copied out and written with its own stdio call
+static int save_by_lines(TextBuffer* buffer, const char* path) {
+    FILE* file = fopen(path, "wb");
+    if (!file) return 0;
+    const char* eol = buffer_get_eol(buffer);
+    for (int i = 0; i < buffer->line_count; i++) {
+        int length;
+        const char* text = buffer_get_line(buffer, i, &length);
+        fwrite(text, 1, (size_t)length, file);
+        fputs(eol, file);
+    }
+    return fclose(file) == 0;
+}
+
+// Best MB/s of RUNS saves of the buffer to `path`
+static double time_save(TextBuffer* buffer, const char* path, int by_lines, size_t size) {
+    double best = 0;
+    for (int run = 0; run < RUNS; run++) {
+        double start = now_seconds();
+        int ok = by_lines ? save_by_lines(buffer, path) : file_save(buffer, path);
+        double elapsed = now_seconds() - start;
+        if (!ok) return -1;
+        if (run == 0 || elapsed < best) best = elapsed;
+    }
+    return size / best / 1e6;
+}
+
+int main(int argc, char** argv) {
+    int lines = argc > 1 ? atoi(argv[1]) : 3000000;
+    int edits = argc > 2 ? atoi(argv[2]) : 20000;
+    const char* directory = argc > 3 ? argv[3] : "/tmp";
+    if (lines < 1 || edits < 0 || edits > lines) {
+        fprintf(stderr, "usage: %s [lines] [edits] [directory], with edits <= lines\n", argv[0]);
+        return 2;
+    }
+
+    char source[512];
+    char target[512];
+    snprintf(source, sizeof(source), "%s/6r-save-bench-%d.txt", directory, (int)getpid());
+    snprintf(target, sizeof(target), "%s/6r-save-bench-%d.out", directory, (int)getpid());
+    if (!make_file(source, lines)) {
+        fprintf(stderr, "save: cannot write %s\n", source);
+        return 1;
+    }
+
+    TextBuffer* buffer = buffer_create();
+    if (!buffer || !file_open(buffer, source)) {
+        fprintf(stderr, "save: cannot open %s\n", source);
+        unlink(source);
+        return 1;
+    }
+    size_t size = piece_table_length(&buffer->table) + 1;
+    printf("%d lines, %llu MB\n", lines, (unsigned long long)(size >> 20));
+
+    double old_clean = time_save(buffer, target, 1, size);
+    double new_clean = time_save(buffer, target, 0, size);
+    printf("  %-20s lines %6.0f MB/s   file_save %6.0f MB/s\n", "unedited:", old_clean, new_clean);
+
+    // Spread the edits evenly, each one word typed into a line
+    for (int i = 0; i < edits; i++) {
+        buffer_insert_text(buffer, (int)((long long)i * lines / edits), 9, "edited ", 7);
+    }
+    size = piece_table_length(&buffer->table) + 1;
+    double old_edited = time_save(buffer, target, 1, size);
+    double new_edited = time_save(buffer, target, 0, size);
+    char label[32];
+    snprintf(label, sizeof(label), "%d edited lines:", edits);
+    printf("  %-20s lines %6.0f MB/s   file_save %6.0f MB/s\n", label, old_edited, new_edited);
+
+    buffer_destroy(buffer);
+    unlink(source);
+    unlink(target);
+    return old_clean > 0 && new_clean > 0 && old_edited > 0 && new_edited > 0 ? 0 : 1;
+}
\ No newline at end of file
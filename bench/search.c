@@ -0,0 +1,175 @@
+// Times finding a needle that is not there in a large word corpus with
+// each substring kernel, against a naive byte loop and glibc's memmem,
+// then search_document over the same text once it is split into pieces.
+//
+// Usage: search [megabytes]
+//
+// The corpus defaults to 1 GB and is kept in memory. Each kernel's best of
+// three runs is reported.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "piece_table.h"
+#include "search.h"
+
+#define RUNS 3
+
+// Inserts scattered over the document before search_document is timed
+#define EDITS 10000
+
+typedef const char* (*Finder)(const char* haystack, size_t length, const char* needle, size_t needle_length);
+
+typedef struct {
+    const char* name;
+    int kind;            // search_use_kernel argument, or -1 for finder
+    Finder finder;
+} Method;
+
+static const char* find_naive(const char* haystack, size_t length, const char* needle, size_t needle_length) {
+    for (size_t i = 0; i + needle_length <= length; i++) {
+        size_t j = 0;
+        while (j < needle_length && haystack[i + j] == needle[j]) j++;
+        if (j == needle_length) return haystack + i;
+    }
+    return NULL;
+}
+
+static const char* find_memmem(const char* haystack, size_t length, const char* needle, size_t needle_length) {
+    return (const char*)memmem(haystack, length, needle, needle_length);
+}
+
+static const Method methods[] = {
+    { "naive", -1, find_naive },
+    { "memchr+cmp", SEARCH_SCALAR, NULL },
+    { "horspool", SEARCH_HORSPOOL, NULL },
+    { "sse2", SEARCH_SSE2, NULL },
+    { "avx2", SEARCH_AVX2, NULL },
+    { "glibc memmem", -1, find_memmem },
+};
+
+// Absent, but starting and ending with common letters so the filters
+// still see plenty of candidates
+static const char* const needles[] = {
+    "needle",
+    "quick brown fax",
+    "the lazy dog jumped over the quick brown fox again and again",
+};
+
+#define NEEDLE_COUNT (sizeof(needles) / sizeof(needles[0]))
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Words of an editor's vocabulary, about 13 to a line
+static void fill_words(char* data, size_t size) {
+    static const char* words[] = {
+        "the ", "quick ", "brown ", "fox ", "jumps ", "over ", "lazy ", "dog ",
+        "search ", "editor ", "piece ", "table ", "line\n", "buffer ", "query ",
+    };
+    unsigned int seed = 1;
+    size_t i = 0;
+    while (i < size) {
+        seed = seed * 1103515245 + 12345;
+        const char* word = words[(seed >> 16) % 15];
+        size_t length = strlen(word);
+        if (length > size - i) length = size - i;
+        memcpy(data + i, word, length);
+        i += length;
+    }
+}
+
+// Best GB/s of RUNS searches with one method; -1 if it finds the needle
+static double time_method(const Method* method, const char* data, size_t size, const char* needle) {
+    size_t length = strlen(needle);
+    double best = 0;
+    for (int run = 0; run < RUNS; run++) {
+        double start = now_seconds();
+        const char* hit = method->finder ? method->finder(data, size, needle, length)
+                                         : search_memory(data, size, needle, length);
+        double elapsed = now_seconds() - start;
+        if (hit) return -1;
+        if (run == 0 || elapsed < best) best = elapsed;
+    }
+    return size / best / 1e9;
+}
+
+int main(int argc, char** argv) {
+    size_t megabytes = argc > 1 ? (size_t)atol(argv[1]) : 1024;
+    if (megabytes == 0) {
+        fprintf(stderr, "usage: %s [megabytes]\n", argv[0]);
+        return 2;
+    }
+
+    size_t size = megabytes << 20;
+    char* data = (char*)malloc(size);
+    if (!data) {
+        fprintf(stderr, "search: out of memory\n");
+        return 1;
+    }
+    fill_words(data, size);
+
+    printf("%llu MB word corpus, needle absent, best of %d\n", (unsigned long long)megabytes, RUNS);
+    printf("  %-14s", "needle");
+    for (size_t n = 0; n < NEEDLE_COUNT; n++) {
+        char label[32];
+        snprintf(label, sizeof(label), "%llu B", (unsigned long long)strlen(needles[n]));
+        printf("  %10s", label);
+    }
+    printf("\n");
+
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(methods) / sizeof(methods[0]); i++) {
+        if (methods[i].kind >= 0 && !search_use_kernel(methods[i].kind)) {
+            printf("  %-14s not available\n", methods[i].name);
+            continue;
+        }
+        printf("  %-14s", methods[i].name);
+        for (size_t n = 0; n < NEEDLE_COUNT; n++) {
+            double rate = time_method(&methods[i], data, size, needles[n]);
+            if (rate < 0) {
+                printf("  %10s", "found?");
+                failed = 1;
+            } else {
+                printf("  %5.2f GB/s", rate);
+            }
+        }
+        printf("\n");
+    }
+    search_use_kernel(SEARCH_AUTO);
+
+    // The same text in a piece table, cut into pieces by scattered inserts
+    PieceTable table;
+    piece_table_init(&table);
+    if (!piece_table_load(&table, data, size, size, 0)) {
+        fprintf(stderr, "search: cannot load the corpus\n");
+        return 1;
+    }
+    for (size_t i = 0; i < EDITS; i++) {
+        piece_table_insert(&table, (size_t)((unsigned long long)i * size / EDITS), "edit ", 5);
+    }
+
+    const char* needle = needles[1];
+    double best = 0;
+    for (int run = 0; run < RUNS; run++) {
+        double start = now_seconds();
+        long long found = search_document(&table, 0, needle, strlen(needle));
+        double elapsed = now_seconds() - start;
+        if (found >= 0) failed = 1;
+        if (run == 0 || elapsed < best) best = elapsed;
+    }
+    printf("search_document after %d inserts, %llu B needle: %.2f GB/s (%.3f s)\n", EDITS,
+           (unsigned long long)strlen(needle), piece_table_length(&table) / best / 1e9, best);
+
+    piece_table_free(&table);
+    if (failed) {
+        printf("search: a needle that is not in the corpus was found\n");
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file
@@ -12,10 +12,54 @@ echo Compiling platform.c...
 gcc -Wall -Wextra -std=c99 -O2 -DPLATFORM_WINDOWS -Iinclude -c src/platform.c -o obj/platform.o
 if errorlevel 1 goto error
 
+echo Compiling arena.c...
+gcc -Wall -Wextra -std=c99 -O2 -DPLATFORM_WINDOWS -Iinclude -c src/arena.c -o obj/arena.o
+if errorlevel 1 goto error
+
+echo Compiling line_index.c...
+gcc -Wall -Wextra -std=c99 -O2 -DPLATFORM_WINDOWS -Iinclude -c src/line_index.c -o obj/line_index.o
+if errorlevel 1 goto error
+
+echo Compiling linescan.c...
+gcc -Wall -Wextra -std=c99 -O2 -DPLATFORM_WINDOWS -Iinclude -c src/linescan.c -o obj/linescan.o
+if errorlevel 1 goto error
+
+echo Compiling keyseq.c...
+gcc -Wall -Wextra -std=c99 -O2 -DPLATFORM_WINDOWS -Iinclude -c src/keyseq.c -o obj/keyseq.o
+if errorlevel 1 goto error
+
+echo Compiling piece_table.c...
+gcc -Wall -Wextra -std=c99 -O2 -DPLATFORM_WINDOWS -Iinclude -c src/piece_table.c -o obj/piece_table.o
+if errorlevel 1 goto error
+
+echo Compiling undo.c...
+gcc -Wall -Wextra -std=c99 -O2 -DPLATFORM_WINDOWS -Iinclude -c src/undo.c -o obj/undo.o
+if errorlevel 1 goto error
+
 echo Compiling buffer.c...
 gcc -Wall -Wextra -std=c99 -O2 -DPLATFORM_WINDOWS -Iinclude -c src/buffer.c -o obj/buffer.o
 if errorlevel 1 goto error
 
+echo Compiling regexp.c...
+gcc -Wall -Wextra -std=c99 -O2 -DPLATFORM_WINDOWS -Iinclude -c src/regexp.c -o obj/regexp.o
+if errorlevel 1 goto error
+
+echo Compiling search.c...
+gcc -Wall -Wextra -std=c99 -O2 -DPLATFORM_WINDOWS -Iinclude -c src/search.c -o obj/search.o
+if errorlevel 1 goto error
+
+echo Compiling search_pool.c...
+gcc -Wall -Wextra -std=c99 -O2 -DPLATFORM_WINDOWS -Iinclude -c src/search_pool.c -o obj/search_pool.o
+if errorlevel 1 goto error
+
+echo Compiling cursors.c...
+gcc -Wall -Wextra -std=c99 -O2 -DPLATFORM_WINDOWS -Iinclude -c src/cursors.c -o obj/cursors.o
+if errorlevel 1 goto error
+
+echo Compiling syntax.c...
+gcc -Wall -Wextra -std=c99 -O2 -DPLATFORM_WINDOWS -Iinclude -c src/syntax.c -o obj/syntax.o
+if errorlevel 1 goto error
+
 echo Compiling tui.c...
 gcc -Wall -Wextra -std=c99 -O2 -DPLATFORM_WINDOWS -Iinclude -c src/tui.c -o obj/tui.o
 if errorlevel 1 goto error
@@ -24,6 +68,10 @@ echo Compiling input.c...
 gcc -Wall -Wextra -std=c99 -O2 -DPLATFORM_WINDOWS -Iinclude -c src/input.c -o obj/input.o
 if errorlevel 1 goto error
 
+echo Compiling pager.c...
+gcc -Wall -Wextra -std=c99 -O2 -DPLATFORM_WINDOWS -Iinclude -c src/pager.c -o obj/pager.o
+if errorlevel 1 goto error
+
 echo Compiling fileio.c...
 gcc -Wall -Wextra -std=c99 -O2 -DPLATFORM_WINDOWS -Iinclude -c src/fileio.c -o obj/fileio.o
 if errorlevel 1 goto error
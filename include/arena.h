@@ -0,0 +1,34 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_BLOCK_SIZE 65536
+#define ARENA_ALIGNMENT 16
+#define ARENA_SMALL_LIMIT 256
+#define ARENA_SMALL_CLASSES (ARENA_SMALL_LIMIT / ARENA_ALIGNMENT)
+#define ARENA_LARGE_CLASSES 8
+#define ARENA_CLASS_COUNT (ARENA_SMALL_CLASSES + ARENA_LARGE_CLASSES)
+#define ARENA_MAX_CLASS_SIZE (ARENA_SMALL_LIMIT << ARENA_LARGE_CLASSES)
+
+typedef struct ArenaBlock {
+    struct ArenaBlock* next;
+    size_t size;
+    size_t used;
+} ArenaBlock;
+
+// Bump allocator with per-size-class free lists. Sizes up to 256 bytes
+// round to 16, larger ones to a power of two up to 64K; bigger requests
+// get a block of their own. Everything is returned at once by arena_free.
+typedef struct {
+    ArenaBlock* blocks;
+    void* free_lists[ARENA_CLASS_COUNT];
+    size_t bytes_reserved;
+} Arena;
+
+void arena_init(Arena* arena);
+void arena_free(Arena* arena);
+void* arena_alloc(Arena* arena, size_t size);
+void arena_release(Arena* arena, void* ptr, size_t size);
+
+#endif
\ No newline at end of file
@@ -3,26 +3,75 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+#include "piece_table.h"
+#include "undo.h"
 
-#define MAX_LINES 10000
-#define MAX_LINE_LENGTH 1024
+// Line terminator style, detected on load and used for new lines
+#define EOL_LF 0
+#define EOL_CRLF 1
 
+// Lines edited since the view last took the changes: every edit fell within
+// [first, last], numbered as the document is now, and lines past `last`
+// moved by `delta` (negative when lines went away). last is INT_MAX when
+// everything from `first` on may differ.
 typedef struct {
-    char** lines;
+    int first;          // -1 if nothing changed
+    int last;
+    int delta;
+} BufferChanges;
+
+typedef struct {
+    PieceTable table;
     int line_count;
-    int max_lines;
+    char* line_cache;
+    size_t line_cache_capacity;
+    int bounds_line;        // line whose bounds are remembered below, or -1
+    size_t bounds_start;
+    size_t bounds_end;
     char filename[256];
     int modified;
+    int eol;
+    int load_progress;  // percent indexed during a background load, else -1
+    UndoLog undo;
+    BufferChanges changes;
+    int batching;           // between buffer_begin_batch and buffer_commit
+    PieceEdit* batch;       // edits waiting for the commit, sorted
+    size_t batch_count;
+    size_t batch_capacity;
+    char* batch_text;       // their text; sources are offsets in here until the commit
+    size_t batch_text_length;
+    size_t batch_text_capacity;
 } TextBuffer;
 
 TextBuffer* buffer_create();
 void buffer_destroy(TextBuffer* buffer);
-int buffer_insert_line(TextBuffer* buffer, int index, const char* text);
+int buffer_load(TextBuffer* buffer, char* data, size_t size, int mapped);
+size_t buffer_load_begin(TextBuffer* buffer, char* data, size_t size, int mapped);
+int buffer_load_append(TextBuffer* buffer, const LineIndex* newlines, size_t crlf_count, size_t end);
+int buffer_insert_line(TextBuffer* buffer, int index, const char* text, int length);
 int buffer_delete_line(TextBuffer* buffer, int index);
 int buffer_split_line(TextBuffer* buffer, int line_num, int position);
 int buffer_merge_line(TextBuffer* buffer, int line_num);
+int buffer_insert_text(TextBuffer* buffer, int line_num, int position, const char* text, int length);
+int buffer_insert_block(TextBuffer* buffer, int line_num, int position, const char* text, size_t length,
+                        int* end_line, int* end_position);
+char* buffer_convert_eol(TextBuffer* buffer, const char* text, size_t length, size_t* out_length);
+int buffer_delete_text(TextBuffer* buffer, int line_num, int position, int length);
+int buffer_replace_all(TextBuffer* buffer, const size_t* ranges, size_t count, const char* text, size_t length);
+int buffer_begin_batch(TextBuffer* buffer);
+int buffer_apply(TextBuffer* buffer, size_t start, size_t end, const char* text, size_t length);
+int buffer_commit(TextBuffer* buffer);
 void buffer_clear(TextBuffer* buffer);
-char* buffer_get_line(TextBuffer* buffer, int index);
-int buffer_set_line(TextBuffer* buffer, int index, const char* text);
+int buffer_undo(TextBuffer* buffer, int* line, int* column);
+int buffer_redo(TextBuffer* buffer, int* line, int* column);
+const char* buffer_get_line(TextBuffer* buffer, int index, int* length);
+const char* buffer_get_line_part(TextBuffer* buffer, int index, int from, int count, int* length);
+const char* buffer_get_eol(TextBuffer* buffer);
+int buffer_get_line_length(TextBuffer* buffer, int index);
+size_t buffer_get_offset(TextBuffer* buffer, int line, int column);
+void buffer_get_position(TextBuffer* buffer, size_t offset, int* line, int* column);
+int buffer_set_line(TextBuffer* buffer, int index, const char* text, int length);
+BufferChanges buffer_take_changes(TextBuffer* buffer);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,22 @@
+#ifndef CURSORS_H
+#define CURSORS_H
+
+#include <stddef.h>
+
+// The cursors besides the main one, as document offsets kept sorted and
+// free of duplicates, so an edit at all of them is one ordered batch and
+// the ones on screen are found by binary search
+typedef struct {
+    size_t* offsets;
+    size_t count;
+    size_t capacity;
+} CursorSet;
+
+void cursor_set_free(CursorSet* set);
+void cursor_set_clear(CursorSet* set);
+int cursor_set_add(CursorSet* set, size_t offset);
+int cursor_set_reserve(CursorSet* set, size_t count);
+void cursor_set_normalize(CursorSet* set, size_t main_offset);
+size_t cursor_set_lower_bound(const CursorSet* set, size_t offset);
+
+#endif
\ No newline at end of file
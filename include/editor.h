@@ -5,10 +5,16 @@
 #include "tui.h"
 #include "input.h"
 #include "fileio.h"
+#include "pager.h"
 
 typedef struct {
     TextBuffer* buffer;
+    FileLoader* loader;
+    Pager* pager;            // set while a file is open read-only in paging mode
+    size_t pager_limit;      // bytes of the file the pager may keep mapped
+    int force_pager;
     TUIState tui;
+    Search search;           // state of the find prompt, shown while tui.search is set
     int running;
 } Editor;
 
@@ -3,9 +3,20 @@
 
 #include "buffer.h"
 
+// Background load of one file into a TextBuffer (see file_open_async)
+typedef struct FileLoader FileLoader;
+
+// file_save result when the file had other hard links and was rewritten
+// where it is rather than replaced, which a crash mid-save can truncate
+#define FILE_SAVED_IN_PLACE 2
+
 int file_save(TextBuffer* buffer, const char* filename);
 int file_save_as(TextBuffer* buffer);
 int file_open(TextBuffer* buffer, const char* filename);
+FileLoader* file_open_async(TextBuffer* buffer, const char* filename);
+int file_load_poll(FileLoader* loader, TextBuffer* buffer);
+int file_load_wait(FileLoader* loader, TextBuffer* buffer);
+void file_load_close(FileLoader* loader);
 int file_new(TextBuffer* buffer);
 void file_show_message(const char* message);
 
@@ -7,7 +7,14 @@
 
 int input_get_key(KeyEvent* event);
 void input_handle_key(TUIState* tui, TextBuffer* buffer, KeyEvent event);
+void input_handle_pager_key(TUIState* tui, Pager* pager, KeyEvent event);
+int input_handle_search_key(TUIState* tui, TextBuffer* buffer, KeyEvent event);
+void input_replace_all(TUIState* tui, TextBuffer* buffer);
+void input_select_matches(TUIState* tui, TextBuffer* buffer);
 void input_insert_char(TUIState* tui, TextBuffer* buffer, char ch);
+void input_paste(TUIState* tui, TextBuffer* buffer, const char* text, size_t length);
+void input_undo(TUIState* tui, TextBuffer* buffer);
+void input_redo(TUIState* tui, TextBuffer* buffer);
 void input_delete_char(TUIState* tui, TextBuffer* buffer);
 void input_move_cursor(TUIState* tui, TextBuffer* buffer, int dx, int dy);
 void input_scroll_to_cursor(TUIState* tui);
@@ -0,0 +1,16 @@
+#ifndef KEYSEQ_H
+#define KEYSEQ_H
+
+#include <stddef.h>
+#include "platform.h"
+
+// Longest escape sequence looked at; anything longer is dropped unread
+#define KEYSEQ_MAX_LENGTH 16
+
+// Decode the key at the start of data[0, length) into *event and return
+// how many bytes it used. Returns 0 when the bytes so far are the start
+// of an escape sequence and more are needed to tell; once no more are
+// coming, call again with complete set to take what is there.
+size_t keyseq_decode(const unsigned char* data, size_t length, int complete, KeyEvent* event);
+
+#endif
\ No newline at end of file
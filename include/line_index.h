@@ -0,0 +1,29 @@
+#ifndef LINE_INDEX_H
+#define LINE_INDEX_H
+
+#include <stddef.h>
+#include "arena.h"
+
+// Line offsets are stored in fixed-size chunks reached through a small
+// directory, so the index grows without ever copying existing entries
+#define LINE_INDEX_CHUNK_BITS 12
+#define LINE_INDEX_CHUNK_SIZE (1 << LINE_INDEX_CHUNK_BITS)
+#define LINE_INDEX_CHUNK_MASK (LINE_INDEX_CHUNK_SIZE - 1)
+
+typedef struct {
+    Arena* arena;
+    size_t** chunks;
+    size_t chunk_count;
+    size_t directory_capacity;
+    size_t count;
+} LineIndex;
+
+void line_index_init(LineIndex* index, Arena* arena);
+void line_index_free(LineIndex* index);
+int line_index_append(LineIndex* index, size_t offset);
+int line_index_append_many(LineIndex* index, const size_t* offsets, size_t count);
+int line_index_append_all(LineIndex* index, const LineIndex* other);
+size_t line_index_get(const LineIndex* index, size_t position);
+size_t line_index_lower_bound(const LineIndex* index, size_t lo, size_t hi, size_t target);
+
+#endif
\ No newline at end of file
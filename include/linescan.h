@@ -0,0 +1,28 @@
+#ifndef LINESCAN_H
+#define LINESCAN_H
+
+#include <stddef.h>
+#include "line_index.h"
+
+// Kernels for linescan_use_kernel
+#define LINESCAN_AUTO 0
+#define LINESCAN_SCALAR 1
+#define LINESCAN_SSE2 2
+#define LINESCAN_AVX2 3
+
+// Append the offset of every '\n' in data[from, to) to index, and add the
+// number of those preceded by '\r' to *crlf_count. Picks AVX2 at runtime
+// when the CPU has it, otherwise SSE2, otherwise a plain byte loop.
+int linescan_build(const char* data, size_t from, size_t to, LineIndex* index, size_t* crlf_count);
+
+// Append base + offset of every stride-th '\n' in data[0, length). The
+// countdown to the next recorded newline carries over between calls so a
+// file can be sampled one window at a time.
+int linescan_sample(const char* data, size_t length, size_t base, size_t stride,
+                    size_t* countdown, LineIndex* index);
+
+// Make every later scan use one kernel, for benchmarks; LINESCAN_AUTO goes
+// back to picking by CPU. Returns 0 if this CPU or build cannot run it.
+int linescan_use_kernel(int kind);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,69 @@
+#ifndef PAGER_H
+#define PAGER_H
+
+#include "platform.h"
+#include "arena.h"
+#include "line_index.h"
+
+#ifdef PLATFORM_UNIX
+#include <pthread.h>
+#endif
+
+// Files at least this large open read-only in the pager
+#define PAGER_AUTO_SIZE ((size_t)1024 * 1024 * 1024)
+#define PAGER_DEFAULT_RESIDENT_LIMIT ((size_t)64 * 1024 * 1024)
+#define PAGER_WINDOW_SIZE ((size_t)1024 * 1024)
+#define PAGER_MIN_WINDOWS 4
+#define PAGER_CHECKPOINT_LINES 1024
+
+typedef struct {
+    size_t offset;
+    char* data;
+    size_t length;
+    unsigned long last_used;
+} PagerWindow;
+
+// Read-only view of a file too big for a TextBuffer. Only a bounded set of
+// mapped windows is kept, and a background pass records the offset of
+// every PAGER_CHECKPOINT_LINES-th line so any line is a short scan away.
+typedef struct {
+    char filename[256];
+    PlatformHandle file;
+    size_t size;
+
+    PagerWindow* windows;
+    int window_count;
+    int max_windows;
+    unsigned long clock;
+
+    size_t top;              // byte offset of the first visible line
+    long long top_line;      // its line number, or -1 until known
+
+    char* line;
+    size_t line_capacity;
+
+    // Shared with the indexing thread, guarded by lock
+    Arena arena;
+    LineIndex checkpoints;   // offset of the '\n' ending line k*N-1, k >= 1
+    size_t indexed;
+    long long line_total;    // -1 until the index is complete
+    int index_done;
+    int cancel;
+#ifdef PLATFORM_UNIX
+    pthread_t thread;
+    pthread_mutex_t lock;
+#endif
+} Pager;
+
+Pager* pager_open(const char* filename, size_t resident_limit);
+void pager_close(Pager* pager);
+int pager_scroll(Pager* pager, int lines);
+void pager_goto_start(Pager* pager);
+void pager_goto_end(Pager* pager, int rows);
+int pager_goto_line(Pager* pager, size_t line);
+const char* pager_read_line(Pager* pager, size_t* offset, size_t skip, size_t max_length, size_t* length);
+long long pager_get_top_line(Pager* pager);
+long long pager_get_line_count(Pager* pager);
+int pager_get_index_progress(Pager* pager);
+
+#endif
\ No newline at end of file
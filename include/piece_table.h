@@ -0,0 +1,97 @@
+#ifndef PIECE_TABLE_H
+#define PIECE_TABLE_H
+
+#include <stddef.h>
+#include "line_index.h"
+#include "linescan.h"
+
+// Which backing buffer a piece points into
+#define PIECE_ORIGINAL 0
+#define PIECE_ADD 1
+
+// Backing storage for piece text. The original buffer holds the file
+// contents and is never written after load; it is usually a read-only
+// mapping of the file itself. The add buffer only grows. Both keep the
+// offsets of every '\n' so line lookups never rescan text.
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+    int mapped;
+    LineIndex newlines;
+    size_t crlf_count;
+} PieceBuffer;
+
+// Treap node: one piece plus the totals of its whole subtree
+typedef struct PieceNode {
+    struct PieceNode* left;
+    struct PieceNode* right;
+    unsigned int priority;
+    int buffer;
+    size_t start;
+    size_t length;
+    size_t first_newline;
+    size_t newline_count;
+    size_t subtree_length;
+    size_t subtree_newlines;
+} PieceNode;
+
+// Tree nodes and newline index chunks are carved from the table's arena,
+// so dropping the whole document never walks the tree
+typedef struct {
+    PieceNode* root;
+    PieceBuffer buffers[2];
+    Arena arena;
+    unsigned int seed;
+} PieceTable;
+
+// A piece as a plain stretch of one buffer. Neither buffer's text ever
+// changes, so a list of these describes a whole version of the document.
+typedef struct {
+    int buffer;
+    size_t start;
+    size_t length;
+} PieceSpan;
+
+// Pieces next to a batch edit are copied in with its text while the
+// result is no longer than this, instead of being left as they are
+#define PIECE_JOIN_MAX 32
+
+// One replacement for piece_table_splice: bytes [start, end) of the
+// document become bytes [source, source + length) of the add buffer
+typedef struct {
+    size_t start;
+    size_t end;
+    size_t source;
+    size_t length;
+} PieceEdit;
+
+// Called with each piece's text in document order; return 0 to stop
+typedef int (*PieceVisitor)(void* context, const char* data, size_t length);
+
+void piece_table_init(PieceTable* table);
+void piece_table_free(PieceTable* table);
+int piece_table_load(PieceTable* table, char* data, size_t size, size_t length, int mapped);
+int piece_table_extend_original(PieceTable* table, size_t end);
+int piece_table_detach(PieceTable* table);
+size_t piece_table_length(const PieceTable* table);
+size_t piece_table_line_count(const PieceTable* table);
+size_t piece_table_line_start(const PieceTable* table, size_t line);
+size_t piece_table_line_end(const PieceTable* table, size_t line);
+size_t piece_table_line_at(const PieceTable* table, size_t offset);
+size_t piece_table_read(const PieceTable* table, size_t offset, size_t length, char* out);
+void piece_table_read_around(const PieceTable* table, const size_t* offsets, size_t count, size_t radius,
+                             char* out);
+int piece_table_for_each(const PieceTable* table, PieceVisitor visit, void* context);
+int piece_table_for_each_from(const PieceTable* table, size_t from, PieceVisitor visit, void* context);
+int piece_table_insert(PieceTable* table, size_t offset, const char* text, size_t length);
+int piece_table_insert_span(PieceTable* table, size_t offset, int buffer, size_t start, size_t length);
+int piece_table_delete(PieceTable* table, size_t offset, size_t length);
+int piece_table_get_spans(const PieceTable* table, PieceSpan** spans, size_t* count);
+int piece_table_rebuild(PieceTable* table, const PieceSpan* spans, size_t count);
+int piece_table_replace(PieceTable* table, const size_t* ranges, size_t count, const char* text, size_t length);
+int piece_table_append(PieceTable* table, const char* text, size_t length, size_t* source);
+int piece_table_splice(PieceTable* table, const PieceEdit* edits, size_t count, PieceEdit* inverse,
+                       char* removed);
+
+#endif
\ No newline at end of file
@@ -6,7 +6,9 @@
     #include <windows.h>
     #include <conio.h>
 #else
+    #ifndef PLATFORM_UNIX
     #define PLATFORM_UNIX
+    #endif
     #include <unistd.h>
     #include <termios.h>
     #include <sys/ioctl.h>
@@ -110,6 +112,12 @@ typedef struct {
     typedef int PlatformHandle;
 #endif
 
+// A run of bytes for platform_write_spans
+typedef struct {
+    const char* data;
+    size_t length;
+} PlatformSpan;
+
 // Key codes - cross-platform mapping
 #define KEY_UP 0x101
 #define KEY_DOWN 0x102
@@ -120,6 +128,7 @@ typedef struct {
 #define KEY_PAGE_UP 0x107
 #define KEY_PAGE_DOWN 0x108
 #define KEY_DELETE 0x109
+#define KEY_PASTE 0x10A
 #define KEY_ESC 27
 #define KEY_ENTER 13
 #define KEY_BACKSPACE 8
@@ -128,7 +137,17 @@ typedef struct {
 #define KEY_CTRL_O 15
 #define KEY_CTRL_Q 17
 #define KEY_CTRL_N 14
-#define KEY_F1 0x70
+#define KEY_F1 0x10B
+
+// platform_wait_event results
+#define PLATFORM_EVENT_INPUT 1
+#define PLATFORM_EVENT_RESIZE 2
+
+// Default wait after ESC for the rest of an escape sequence
+#define PLATFORM_ESC_TIMEOUT_MS 100
+
+// Longest path platform_create_temp resolves a save target to
+#define PLATFORM_PATH_MAX 4096
 
 // Color definitions
 #define COLOR_BLACK 0
@@ -137,6 +156,9 @@ typedef struct {
 #define COLOR_GREEN 2
 #define COLOR_RED 1
 #define COLOR_YELLOW 3
+#define COLOR_MAGENTA 5
+#define COLOR_CYAN 6
+#define COLOR_BRIGHT 8  // added to a foreground color
 
 // Platform function declarations
 void platform_init_terminal();
@@ -148,7 +170,25 @@ void platform_set_color(int foreground, int background);
 void platform_reset_color();
 void platform_hide_cursor();
 void platform_show_cursor();
+void platform_begin_frame();
+void platform_end_frame();
+void platform_write(const char* data, size_t length);
+int platform_scroll_rows(int top, int bottom, int count);
+int platform_input_pending(int timeout_ms);
+int platform_wait_event(int timeout_ms);
 int platform_get_key(KeyEvent* event);
+const char* platform_get_paste(size_t* length);
+void platform_set_escape_timeout(int timeout_ms);
 void platform_set_raw_mode(int enable);
+int platform_map_file(const char* filename, char** data, size_t* length);
+void platform_unmap_file(char* data, size_t length);
+int platform_open_readonly(const char* filename, PlatformHandle* file, size_t* size);
+char* platform_map_range(PlatformHandle file, size_t offset, size_t length);
+void platform_close_file(PlatformHandle file);
+int platform_create_temp(const char* target, char* temp_path, size_t size, PlatformHandle* file);
+int platform_write_spans(PlatformHandle file, const PlatformSpan* spans, int count);
+int platform_commit_file(PlatformHandle file, const char* temp_path, const char* target);
+void platform_discard_file(PlatformHandle file, const char* temp_path);
+int platform_cpu_count();
 
 #endif
\ No newline at end of file
@@ -0,0 +1,39 @@
+#ifndef REGEXP_H
+#define REGEXP_H
+
+#include <stddef.h>
+
+// Bytes of DFA states a pattern may cache; past it, new states are
+// simulated on the NFA instead of being built
+#define REGEXP_DEFAULT_CACHE ((size_t)2 * 1024 * 1024)
+
+// Instructions a compiled pattern may have, so counted repetition like
+// (a{100}){100} cannot run away
+#define REGEXP_MAX_PROGRAM 20000
+
+// A compiled pattern. Supported syntax: literals, ., [...] classes with
+// ranges and ^, \d \w \s and their negations, ^ $, ( ) (?: ) groups, |,
+// and the * + ? {m} {m,} {m,n} repetitions.
+//
+// Nothing backtracks. The pattern becomes an NFA whose state sets are
+// turned into DFA states as the text needs them and cached, so each byte
+// costs one table lookup once the cache is warm.
+typedef struct Regexp Regexp;
+
+typedef struct {
+    size_t states;       // DFA states built so far
+    size_t memory;       // bytes they use
+    size_t nfa_bytes;    // bytes matched on the NFA because the cache was full
+} RegexpStats;
+
+// Returns NULL with *error set to a message if the pattern is invalid
+Regexp* regexp_compile(const char* pattern, size_t length, const char** error);
+void regexp_free(Regexp* regexp);
+void regexp_set_cache_limit(Regexp* regexp, size_t limit);
+void regexp_get_stats(const Regexp* regexp, RegexpStats* stats);
+
+// Leftmost-longest match starting in text[from, length). The text is one
+// whole line: ^ and $ match only at its ends.
+int regexp_search(Regexp* regexp, const char* text, size_t length, size_t from, size_t* start, size_t* end);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,73 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stddef.h>
+#include "piece_table.h"
+#include "regexp.h"
+#include "search_pool.h"
+
+#define SEARCH_MAX_QUERY 255
+
+// Without SIMD, needles at least this long use Horspool, whose skips grow
+// with the needle
+#define SEARCH_HORSPOOL_MIN 32
+
+// Kernels for search_use_kernel
+#define SEARCH_AUTO 0
+#define SEARCH_SCALAR 1
+#define SEARCH_HORSPOOL 2
+#define SEARCH_SSE2 3
+#define SEARCH_AVX2 4
+
+// State of an incremental find. found[n] is the match for the first n
+// characters of the query, so typing continues from the match already
+// shown and erasing steps straight back to the previous one. A regular
+// expression has no such relation to its prefixes and is searched for
+// afresh from the origin each time it changes. Meanwhile the pool, if
+// there is one, counts every match in the background.
+typedef struct {
+    char query[SEARCH_MAX_QUERY + 1];
+    int length;
+    int regexp;                             // query is a regular expression
+    Regexp* pattern;                        // compiled query, NULL if empty or invalid
+    size_t origin;                          // where the search started
+    long long found[SEARCH_MAX_QUERY + 1];  // document offset, -1 for none
+    size_t found_end;                       // end of the regular expression match
+    SearchPool* pool;                       // owned; NULL to go without a count
+    char replacement[SEARCH_MAX_QUERY + 1];
+    int replacement_length;
+    int replacing;                          // typing goes to the replacement
+} Search;
+
+// First occurrence of needle in haystack, or NULL. Picks AVX2 at runtime
+// when the CPU has it, otherwise SSE2, otherwise memchr on the first byte
+// or Horspool.
+const char* search_memory(const char* haystack, size_t length, const char* needle, size_t needle_length);
+
+// Make every later search use one kernel, for benchmarks; SEARCH_AUTO goes
+// back to picking by CPU. SEARCH_SCALAR is the memchr filter alone, never
+// Horspool. Returns 0 if this CPU or build cannot run it.
+int search_use_kernel(int kind);
+
+// First match at or after `from`, wrapping around to the start of the
+// document; -1 when there is none
+long long search_document(const PieceTable* table, size_t from, const char* needle, size_t length);
+
+// Same for a regular expression, matched one line at a time; *end is set
+// to where the match ends
+long long search_document_regexp(Regexp* pattern, const PieceTable* table, size_t from, size_t* end);
+
+void search_begin(Search* search, size_t origin);
+void search_free(Search* search);
+long long search_type(Search* search, const PieceTable* table, char ch);
+long long search_erase(Search* search, const PieceTable* table);
+long long search_next(Search* search, const PieceTable* table);
+long long search_toggle_regexp(Search* search, const PieceTable* table);
+long long search_current(const Search* search);
+void search_end(Search* search);
+int search_poll(Search* search);
+int search_running(const Search* search);
+int search_count(const Search* search, size_t* index, size_t* total);
+size_t* search_find_all(const Search* search, const PieceTable* table, size_t* count);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,28 @@
+#ifndef SEARCH_POOL_H
+#define SEARCH_POOL_H
+
+#include <stddef.h>
+#include "piece_table.h"
+
+// Bytes of the document per chunk handed to a worker; chunks always hold
+// whole lines since no match crosses a line break
+#define SEARCH_POOL_CHUNK ((size_t)1024 * 1024)
+
+#define SEARCH_POOL_MAX_WORKERS 16
+
+// Finds every match of a query with a pool of worker threads (see
+// search_pool_start). Workers read a snapshot of the piece spans, never
+// the tree, so the document's text must not change until the search is
+// finished or cancelled.
+typedef struct SearchPool SearchPool;
+
+SearchPool* search_pool_create(int workers);
+void search_pool_destroy(SearchPool* pool);
+int search_pool_start(SearchPool* pool, const PieceTable* table, const char* query, size_t length, int regexp);
+void search_pool_cancel(SearchPool* pool);
+int search_pool_poll(SearchPool* pool);
+int search_pool_wait(SearchPool* pool);
+int search_pool_running(const SearchPool* pool);
+const long long* search_pool_matches(const SearchPool* pool, size_t* count);
+
+#endif
\ No newline at end of file
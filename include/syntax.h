@@ -0,0 +1,60 @@
+#ifndef SYNTAX_H
+#define SYNTAX_H
+
+#include "buffer.h"
+
+// Languages, picked from the file name
+#define SYNTAX_NONE 0
+#define SYNTAX_C 1
+#define SYNTAX_JSON 2
+#define SYNTAX_YAML 3
+#define SYNTAX_LOG 4
+
+// What each byte of a line is, as far as coloring goes
+#define HIGHLIGHT_PLAIN 0
+#define HIGHLIGHT_KEYWORD 1
+#define HIGHLIGHT_TYPE 2
+#define HIGHLIGHT_STRING 3
+#define HIGHLIGHT_NUMBER 4
+#define HIGHLIGHT_COMMENT 5
+#define HIGHLIGHT_DIRECTIVE 6
+#define HIGHLIGHT_KEY 7
+#define HIGHLIGHT_ERROR 8
+#define HIGHLIGHT_WARNING 9
+#define HIGHLIGHT_COUNT 10
+
+// Lines further past the last one lexed than this are not lexed from
+// there; highlighting starts afresh SYNTAX_CONTEXT lines above instead
+#define SYNTAX_MAX_CATCHUP 200000
+#define SYNTAX_CONTEXT 500
+
+// Longer lines are not lexed, not even read: they stay uncolored and end
+// in the state they start in
+#define SYNTAX_MAX_LINE (64 * 1024)
+
+// Highlighting for one view of a buffer. The lexer's state at the end of
+// each line is cached, so a line can be colored knowing only the state
+// the line before it ended in. After an edit, lines are lexed again from
+// the first one changed until a line ends in the state cached for it,
+// past which nothing can have changed.
+typedef struct {
+    int language;
+    char filename[256];      // name the language was picked for
+    int* states;             // state at the end of lines [0, known)
+    int known;
+    int capacity;
+    int valid;               // states[0, valid) are right; the rest may be stale
+    int recheck;             // stale lines up to this one must be lexed again
+    int guess_line;          // line whose starting state was last estimated, or 0
+    int guess_state;
+    unsigned char* classes;  // HIGHLIGHT_* of each byte of the last line colored
+    int classes_capacity;
+} Syntax;
+
+int syntax_detect(const char* filename);
+void syntax_free(Syntax* syntax);
+void syntax_attach(Syntax* syntax, TextBuffer* buffer);
+int syntax_state_before(Syntax* syntax, TextBuffer* buffer, int line);
+const unsigned char* syntax_highlight(Syntax* syntax, int line, int state, const char* text, int length, int* end_state);
+
+#endif
\ No newline at end of file
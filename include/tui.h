@@ -3,6 +3,21 @@
 
 #include "platform.h"
 #include "buffer.h"
+#include "pager.h"
+#include "search.h"
+#include "syntax.h"
+#include "cursors.h"
+
+// Cell attribute: foreground | background << 4, or the terminal default
+#define TUI_ATTR(fg, bg) ((unsigned char)((fg) | ((bg) << 4)))
+#define TUI_ATTR_DEFAULT 0xFF
+
+// One screen cell. A frame is composed into a grid of these and only the
+// cells that differ from the previous frame are sent to the terminal.
+typedef struct {
+    char ch;
+    unsigned char attr;
+} TUICell;
 
 typedef struct {
     int rows;
@@ -15,6 +30,16 @@ typedef struct {
     int line_num_width;
     int cursor_line;
     int cursor_col;
+    TUICell* front;     // what the terminal currently shows
+    TUICell* back;      // the frame being composed
+    int grid_rows;
+    int grid_cols;
+    int pen;            // attribute the terminal draws with, -1 if unknown
+    int front_offset_y; // offset_y the front grid was drawn at
+    Search* search;     // find prompt in progress, or NULL
+    char message[64];   // shown in the status bar until the next key
+    Syntax syntax;      // highlighting of the buffer being edited
+    CursorSet cursors;  // cursors besides cursor_x/cursor_y
     PlatformHandle stdout_handle;
 #ifdef PLATFORM_WINDOWS
     ConsoleInfo original_info;
@@ -24,8 +49,10 @@ typedef struct {
 void tui_init(TUIState* tui);
 void tui_cleanup(TUIState* tui);
 void tui_draw(TUIState* tui, TextBuffer* buffer);
+void tui_draw_pager(TUIState* tui, Pager* pager);
 void tui_draw_status(TUIState* tui, TextBuffer* buffer);
 void tui_draw_line_numbers(TUIState* tui, TextBuffer* buffer, int start_line);
+void tui_present(TUIState* tui);
 void tui_update_cursor(TUIState* tui);
 void tui_clear_screen();
 void tui_set_color(int foreground, int background);
@@ -0,0 +1,65 @@
+#ifndef UNDO_H
+#define UNDO_H
+
+#include <stddef.h>
+
+#define UNDO_INSERT 0
+#define UNDO_DELETE 1
+#define UNDO_SWAP 2
+#define UNDO_SPLICE 3
+
+// Bytes of history kept by default; the oldest edits are dropped past it
+#define UNDO_DEFAULT_LIMIT ((size_t)16 * 1024 * 1024)
+
+// One edit. Inserted text is never copied: it stays in the piece table's
+// add buffer, which only grows, and the record keeps where it starts there.
+// Deleted text has nowhere else to live, so the record owns a copy. An
+// edit too scattered for either, such as a replace-all, keeps the piece
+// list of the other version of the document and swaps it in. A batch of
+// edits keeps the edits, the ones that undo them and the text they
+// removed, which the undoing edits point into.
+//
+// Inserted text counts against the limit like deleted text does: the add
+// buffer never shrinks, so the history is what decides how much of it
+// stays worth keeping.
+typedef struct {
+    int type;
+    unsigned int group;
+    size_t offset;       // document offset of the edit
+    size_t length;
+    size_t source;       // UNDO_INSERT: start of the text in the add buffer;
+                         // UNDO_SPLICE: number of edits
+    size_t added;        // UNDO_SPLICE: bytes of add buffer text the edits insert
+    char* text;          // UNDO_DELETE: the removed text; UNDO_SWAP: the other version;
+                         // UNDO_SPLICE: the edits, the ones undoing them, the removed text
+    int typed;           // single typed characters, which may coalesce
+} UndoRecord;
+
+// Append-only log of edits. records[first, current) are applied and can
+// be undone, records[current, count) were undone and can be redone.
+// Records sharing a group number are undone and redone together.
+typedef struct {
+    UndoRecord* records;
+    size_t first;
+    size_t current;
+    size_t count;
+    size_t capacity;
+    size_t memory;
+    size_t limit;
+    unsigned int group;
+    int sealed;          // the last record may not grow any more
+} UndoLog;
+
+void undo_init(UndoLog* log);
+void undo_free(UndoLog* log);
+void undo_clear(UndoLog* log);
+void undo_set_limit(UndoLog* log, size_t limit);
+void undo_begin_group(UndoLog* log);
+void undo_seal(UndoLog* log);
+int undo_record_insert(UndoLog* log, size_t offset, size_t source, size_t length, int typed);
+int undo_record_delete(UndoLog* log, size_t offset, char* text, size_t length, int typed);
+int undo_record_swap(UndoLog* log, size_t offset, char* version, size_t length);
+int undo_record_splice(UndoLog* log, size_t offset, char* edits, size_t length, size_t count, size_t added);
+void undo_swap_version(UndoLog* log, UndoRecord* record, char* version, size_t length);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,99 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define BLOCK_HEADER_SIZE ((sizeof(ArenaBlock) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+// Maps a request to its size class, or -1 when it needs its own block
+static int arena_size_class(size_t size, size_t* class_size) {
+    if (size == 0) size = 1;
+
+    if (size <= ARENA_SMALL_LIMIT) {
+        *class_size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+        return (int)(*class_size / ARENA_ALIGNMENT) - 1;
+    }
+
+    size_t rounded = ARENA_SMALL_LIMIT * 2;
+    int size_class = ARENA_SMALL_CLASSES;
+    while (rounded < size) {
+        rounded *= 2;
+        size_class++;
+    }
+    if (size_class >= ARENA_CLASS_COUNT) return -1;
+
+    *class_size = rounded;
+    return size_class;
+}
+
+static ArenaBlock* arena_add_block(Arena* arena, size_t payload) {
+    ArenaBlock* block = (ArenaBlock*)malloc(BLOCK_HEADER_SIZE + payload);
+    if (!block) return NULL;
+
+    block->size = payload;
+    block->used = 0;
+    block->next = arena->blocks;
+    arena->blocks = block;
+    arena->bytes_reserved += BLOCK_HEADER_SIZE + payload;
+    return block;
+}
+
+void arena_init(Arena* arena) {
+    memset(arena, 0, sizeof(Arena));
+}
+
+void arena_free(Arena* arena) {
+    ArenaBlock* block = arena->blocks;
+    while (block) {
+        ArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+    arena_init(arena);
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+    size_t class_size;
+    int size_class = arena_size_class(size, &class_size);
+
+    if (size_class < 0) {
+        // Oversized: a dedicated block, reclaimed only by arena_free.
+        // It goes behind the head so the current bump block stays in use.
+        ArenaBlock* head = arena->blocks;
+        ArenaBlock* block = arena_add_block(arena, size);
+        if (!block) return NULL;
+        block->used = size;
+        if (head) {
+            arena->blocks = head;
+            block->next = head->next;
+            head->next = block;
+        }
+        return (char*)block + BLOCK_HEADER_SIZE;
+    }
+
+    void* reused = arena->free_lists[size_class];
+    if (reused) {
+        arena->free_lists[size_class] = *(void**)reused;
+        return reused;
+    }
+
+    ArenaBlock* block = arena->blocks;
+    if (!block || block->size - block->used < class_size) {
+        block = arena_add_block(arena, ARENA_BLOCK_SIZE > class_size ? ARENA_BLOCK_SIZE : class_size);
+        if (!block) return NULL;
+    }
+
+    void* ptr = (char*)block + BLOCK_HEADER_SIZE + block->used;
+    block->used += class_size;
+    return ptr;
+}
+
+void arena_release(Arena* arena, void* ptr, size_t size) {
+    if (!ptr) return;
+
+    size_t class_size;
+    int size_class = arena_size_class(size, &class_size);
+    if (size_class < 0) return;
+
+    *(void**)ptr = arena->free_lists[size_class];
+    arena->free_lists[size_class] = ptr;
+}
\ No newline at end of file
@@ -1,138 +1,796 @@
 #include "buffer.h"
 
+static void buffer_changed(TextBuffer* buffer) {
+    buffer->line_count = (int)piece_table_line_count(&buffer->table);
+    buffer->modified = 1;
+    buffer->bounds_line = -1;
+}
+
+// Byte range of a line's text, excluding its "\n" or "\r\n" terminator.
+// The cursor asks about the same line over and over between edits, so the
+// last answer is kept until the next edit.
+static void buffer_line_bounds(TextBuffer* buffer, int index, size_t* start, size_t* end) {
+    if (index == buffer->bounds_line) {
+        *start = buffer->bounds_start;
+        *end = buffer->bounds_end;
+        return;
+    }
+
+    *start = piece_table_line_start(&buffer->table, index);
+    *end = piece_table_line_end(&buffer->table, index);
+
+    if (*end > *start && index + 1 < buffer->line_count) {
+        char last;
+        piece_table_read(&buffer->table, *end - 1, 1, &last);
+        if (last == '\r') (*end)--;
+    }
+
+    buffer->bounds_line = index;
+    buffer->bounds_start = *start;
+    buffer->bounds_end = *end;
+}
+
+// Fold an edit into the pending changes: it touched lines [first, last],
+// numbered as they are after it, and the lines past them moved by delta
+static void buffer_note_range(TextBuffer* buffer, int first, int last, int delta) {
+    BufferChanges* changes = &buffer->changes;
+    buffer->bounds_line = -1;
+
+    if (changes->first < 0) {
+        changes->first = first;
+        changes->last = last;
+        changes->delta = delta;
+        return;
+    }
+
+    // Earlier changes below this edit have moved with it; those inside it
+    // are covered by it
+    if (changes->last != INT_MAX && changes->last > first) {
+        changes->last = changes->last > last - delta ? changes->last + delta : first;
+    }
+    if (first < changes->first) changes->first = first;
+    if (last > changes->last) changes->last = last;
+    changes->delta += delta;
+}
+
+// An edit that touched `line` and added `delta` lines right after it, or
+// removed them if negative
+static void buffer_note_change(TextBuffer* buffer, int line, int delta) {
+    buffer_note_range(buffer, line, line + (delta > 0 ? delta : 0), delta);
+}
+
+// Anything from `line` on may have changed
+static void buffer_note_rest(TextBuffer* buffer, int line) {
+    buffer_note_change(buffer, line, 0);
+    buffer->changes.last = INT_MAX;
+}
+
+// Edit the piece table, noting which lines the edit touched
+static int buffer_insert_piece(TextBuffer* buffer, size_t offset, const char* text, size_t length) {
+    int line = (int)piece_table_line_at(&buffer->table, offset);
+    size_t lines = piece_table_line_count(&buffer->table);
+    if (!piece_table_insert(&buffer->table, offset, text, length)) return 0;
+
+    buffer_note_change(buffer, line, (int)(piece_table_line_count(&buffer->table) - lines));
+    return 1;
+}
+
+static int buffer_insert_span(TextBuffer* buffer, size_t offset, size_t source, size_t length) {
+    int line = (int)piece_table_line_at(&buffer->table, offset);
+    size_t lines = piece_table_line_count(&buffer->table);
+    if (!piece_table_insert_span(&buffer->table, offset, PIECE_ADD, source, length)) return 0;
+
+    buffer_note_change(buffer, line, (int)(piece_table_line_count(&buffer->table) - lines));
+    return 1;
+}
+
+static int buffer_delete_piece(TextBuffer* buffer, size_t offset, size_t length) {
+    int line = (int)piece_table_line_at(&buffer->table, offset);
+    size_t lines = piece_table_line_count(&buffer->table);
+    if (!piece_table_delete(&buffer->table, offset, length)) return 0;
+
+    buffer_note_change(buffer, line, -(int)(lines - piece_table_line_count(&buffer->table)));
+    return 1;
+}
+
+// Every edit goes through these two so the undo log sees all of them. If
+// the log cannot keep up, its history is dropped rather than left wrong.
+static int buffer_put(TextBuffer* buffer, size_t offset, const char* text, size_t length, int typed) {
+    size_t source = buffer->table.buffers[PIECE_ADD].length;
+    if (!buffer_insert_piece(buffer, offset, text, length)) return 0;
+
+    if (length > 0 && !undo_record_insert(&buffer->undo, offset, source, length, typed)) {
+        undo_clear(&buffer->undo);
+    }
+    return 1;
+}
+
+static int buffer_cut(TextBuffer* buffer, size_t offset, size_t length, int typed) {
+    size_t total = piece_table_length(&buffer->table);
+    if (offset > total) return 0;
+    if (length > total - offset) length = total - offset;
+    if (length == 0) return 1;
+
+    char* text = (char*)malloc(length);
+    if (text) {
+        piece_table_read(&buffer->table, offset, length, text);
+    }
+    if (!buffer_delete_piece(buffer, offset, length)) {
+        free(text);
+        return 0;
+    }
+
+    if (!text || !undo_record_delete(&buffer->undo, offset, text, length, typed)) {
+        undo_clear(&buffer->undo);
+    }
+    return 1;
+}
+
+// Make sorted edits with one splice of the piece tree, noting every line
+// from the first edit to the end of the last one as changed
+static int buffer_splice(TextBuffer* buffer, const PieceEdit* edits, size_t count, PieceEdit* inverse,
+                         char* removed) {
+    int first = (int)piece_table_line_at(&buffer->table, edits[0].start);
+    int old_lines = buffer->line_count;
+    size_t last_end = edits[count - 1].end;
+    for (size_t i = 0; i < count; i++) {
+        last_end += edits[i].length - (edits[i].end - edits[i].start);
+    }
+
+    int ok = piece_table_splice(&buffer->table, edits, count, inverse, removed);
+    buffer_changed(buffer);
+    if (ok) {
+        buffer_note_range(buffer, first, (int)piece_table_line_at(&buffer->table, last_end),
+                          buffer->line_count - old_lines);
+    } else {
+        // A failed splice may have made only some of the edits
+        buffer_note_rest(buffer, first);
+    }
+    return ok;
+}
+
+// Undo a splice record: the text its edits removed goes back into the add
+// buffer in one piece and the undoing edits are pointed at it there
+static int buffer_unsplice(TextBuffer* buffer, const UndoRecord* record) {
+    size_t count = record->source;
+    const PieceEdit* inverse = (const PieceEdit*)record->text + count;
+    size_t edits_size = 2 * count * sizeof(PieceEdit);
+
+    PieceEdit* edits = (PieceEdit*)malloc(count * sizeof(PieceEdit));
+    if (!edits) return 0;
+    size_t base;
+    if (!piece_table_append(&buffer->table, record->text + edits_size, record->length - edits_size, &base)) {
+        free(edits);
+        return 0;
+    }
+    for (size_t i = 0; i < count; i++) {
+        edits[i] = inverse[i];
+        edits[i].source += base;
+    }
+
+    int ok = buffer_splice(buffer, edits, count, NULL, NULL);
+    free(edits);
+    return ok;
+}
+
+// Swap the document for the version a swap record keeps, leaving the
+// current one in the record; undo and redo are the same step
+static int buffer_swap(TextBuffer* buffer, UndoRecord* record) {
+    PieceSpan* current;
+    size_t count;
+    if (!piece_table_get_spans(&buffer->table, &current, &count)) return 0;
+    if (!piece_table_rebuild(&buffer->table, (const PieceSpan*)record->text, record->length / sizeof(PieceSpan))) {
+        free(current);
+        return 0;
+    }
+    undo_swap_version(&buffer->undo, record, (char*)current, count * sizeof(PieceSpan));
+    buffer_note_rest(buffer, (int)piece_table_line_at(&buffer->table, record->offset));
+    return 1;
+}
+
 TextBuffer* buffer_create() {
     TextBuffer* buffer = (TextBuffer*)malloc(sizeof(TextBuffer));
     if (!buffer) return NULL;
-    
-    buffer->max_lines = MAX_LINES;
-    buffer->lines = (char**)calloc(buffer->max_lines, sizeof(char*));
-    buffer->line_count = 0;
+
+    piece_table_init(&buffer->table);
+    buffer->line_count = 1;
+    buffer->line_cache = NULL;
+    buffer->line_cache_capacity = 0;
     buffer->filename[0] = '\0';
     buffer->modified = 0;
-    
-    // Initialize with one empty line
-    buffer_insert_line(buffer, 0, "");
-    
+    buffer->eol = EOL_LF;
+    buffer->load_progress = -1;
+    undo_init(&buffer->undo);
+    buffer->changes.first = -1;
+    buffer->bounds_line = -1;
+    buffer->batching = 0;
+    buffer->batch = NULL;
+    buffer->batch_count = 0;
+    buffer->batch_capacity = 0;
+    buffer->batch_text = NULL;
+    buffer->batch_text_length = 0;
+    buffer->batch_text_capacity = 0;
+
     return buffer;
 }
 
 void buffer_destroy(TextBuffer* buffer) {
     if (!buffer) return;
-    
-    for (int i = 0; i < buffer->line_count; i++) {
-        free(buffer->lines[i]);
-    }
-    free(buffer->lines);
+
+    piece_table_free(&buffer->table);
+    undo_free(&buffer->undo);
+    free(buffer->line_cache);
+    free(buffer->batch);
+    free(buffer->batch_text);
     free(buffer);
 }
 
-int buffer_insert_line(TextBuffer* buffer, int index, const char* text) {
-    if (!buffer || index < 0 || index > buffer->line_count || 
-        buffer->line_count >= buffer->max_lines) {
+// Length of the document text in a file image: the final line terminator
+// is implied and file_save writes it back
+static size_t buffer_text_length(const char* data, size_t size, int* crlf_terminated) {
+    size_t length = size;
+    *crlf_terminated = 0;
+
+    if (length > 0 && data[length - 1] == '\n') {
+        length--;
+        if (length > 0 && data[length - 1] == '\r') {
+            length--;
+            *crlf_terminated = 1;
+        }
+    }
+    return length;
+}
+
+// Follow whichever terminator the majority of loaded lines already use
+static void buffer_detect_eol(TextBuffer* buffer, int crlf_terminated) {
+    const PieceBuffer* original = &buffer->table.buffers[PIECE_ORIGINAL];
+
+    if (original->newlines.count == 0) {
+        buffer->eol = crlf_terminated ? EOL_CRLF : EOL_LF;
+    } else {
+        buffer->eol = original->crlf_count * 2 > original->newlines.count ? EOL_CRLF : EOL_LF;
+    }
+}
+
+int buffer_load(TextBuffer* buffer, char* data, size_t size, int mapped) {
+    if (!buffer) return 0;
+
+    int crlf_terminated;
+    size_t length = buffer_text_length(data, size, &crlf_terminated);
+
+    // Takes ownership of data, which becomes the read-only original buffer
+    int ok = piece_table_load(&buffer->table, data, size, length, mapped);
+    undo_clear(&buffer->undo);
+    buffer->line_count = (int)piece_table_line_count(&buffer->table);
+    buffer->modified = 0;
+    buffer->load_progress = -1;
+    buffer_detect_eol(buffer, crlf_terminated);
+    buffer_note_rest(buffer, 0);
+
+    return ok;
+}
+
+size_t buffer_load_begin(TextBuffer* buffer, char* data, size_t size, int mapped) {
+    int crlf_terminated;
+    size_t length = buffer_text_length(data, size, &crlf_terminated);
+
+    // Same ownership as buffer_load, but the document starts out empty and
+    // grows through buffer_load_append as the text gets indexed
+    piece_table_load(&buffer->table, data, size, 0, mapped);
+    undo_clear(&buffer->undo);
+    buffer->line_count = 1;
+    buffer->modified = 0;
+    buffer->load_progress = 0;
+    buffer_detect_eol(buffer, crlf_terminated);
+    buffer_note_rest(buffer, 0);
+
+    return length;
+}
+
+int buffer_load_append(TextBuffer* buffer, const LineIndex* newlines, size_t crlf_count, size_t end) {
+    PieceBuffer* original = &buffer->table.buffers[PIECE_ORIGINAL];
+
+    if (!line_index_append_all(&original->newlines, newlines)) return 0;
+    original->crlf_count += crlf_count;
+
+    // The last line may have grown as well as new ones arriving
+    int last_line = buffer->line_count - 1;
+    int ok = piece_table_extend_original(&buffer->table, end);
+    buffer->line_count = (int)piece_table_line_count(&buffer->table);
+    buffer_note_change(buffer, last_line, buffer->line_count - 1 - last_line);
+    if (original->newlines.count > 0) {
+        buffer_detect_eol(buffer, 0);
+    }
+
+    return ok;
+}
+
+int buffer_insert_line(TextBuffer* buffer, int index, const char* text, int length) {
+    if (!buffer || index < 0 || index > buffer->line_count || length < 0) {
         return 0;
     }
-    
-    // Shift lines down
-    for (int i = buffer->line_count; i > index; i--) {
-        buffer->lines[i] = buffer->lines[i - 1];
+
+    size_t len = (size_t)length;
+
+    const char* eol = buffer_get_eol(buffer);
+    size_t eol_len = strlen(eol);
+
+    int ok;
+    undo_begin_group(&buffer->undo);
+    if (index < buffer->line_count) {
+        size_t offset = piece_table_line_start(&buffer->table, index);
+        ok = buffer_put(buffer, offset, text, len, 0) &&
+             buffer_put(buffer, offset + len, eol, eol_len, 0);
+    } else {
+        // Appending after the last line: the new line needs a separator first
+        size_t offset = piece_table_length(&buffer->table);
+        ok = buffer_put(buffer, offset, eol, eol_len, 0) &&
+             buffer_put(buffer, offset + eol_len, text, len, 0);
     }
-    
-    buffer->lines[index] = (char*)malloc(MAX_LINE_LENGTH);
-    if (!buffer->lines[index]) return 0;
-    
-    strncpy(buffer->lines[index], text, MAX_LINE_LENGTH - 1);
-    buffer->lines[index][MAX_LINE_LENGTH - 1] = '\0';
-    buffer->line_count++;
-    buffer->modified = 1;
-    
-    return 1;
+
+    buffer_changed(buffer);
+    return ok;
 }
 
 int buffer_delete_line(TextBuffer* buffer, int index) {
     if (!buffer || index < 0 || index >= buffer->line_count) {
         return 0;
     }
-    
-    free(buffer->lines[index]);
-    
-    // Shift lines up
-    for (int i = index; i < buffer->line_count - 1; i++) {
-        buffer->lines[i] = buffer->lines[i + 1];
+
+    size_t start = piece_table_line_start(&buffer->table, index);
+    size_t end;
+
+    if (index + 1 < buffer->line_count) {
+        end = piece_table_line_start(&buffer->table, index + 1);
+    } else {
+        // Last line: take the separator in front of it instead
+        size_t prev_start;
+        end = piece_table_length(&buffer->table);
+        if (index > 0) {
+            buffer_line_bounds(buffer, index - 1, &prev_start, &start);
+        }
     }
-    
-    buffer->line_count--;
-    buffer->modified = 1;
-    return 1;
+
+    undo_begin_group(&buffer->undo);
+    int ok = buffer_cut(buffer, start, end - start, 0);
+    buffer_changed(buffer);
+    return ok;
 }
 
 int buffer_split_line(TextBuffer* buffer, int line_num, int position) {
     if (!buffer || line_num < 0 || line_num >= buffer->line_count) {
         return 0;
     }
-    
-    char* line = buffer->lines[line_num];
-    int len = strlen(line);
-    
-    if (position > len) position = len;
-    
-    // Create new line with text after position
-    char second_part[MAX_LINE_LENGTH];
-    strcpy(second_part, line + position);
-    
-    // Truncate original line
-    line[position] = '\0';
-    
-    // Insert new line
-    return buffer_insert_line(buffer, line_num + 1, second_part);
+
+    size_t start, end;
+    buffer_line_bounds(buffer, line_num, &start, &end);
+
+    if (position < 0) position = 0;
+    if ((size_t)position > end - start) position = (int)(end - start);
+
+    const char* eol = buffer_get_eol(buffer);
+    undo_begin_group(&buffer->undo);
+    int ok = buffer_put(buffer, start + position, eol, strlen(eol), 0);
+    buffer_changed(buffer);
+    return ok;
 }
 
 int buffer_merge_line(TextBuffer* buffer, int line_num) {
     if (!buffer || line_num < 0 || line_num >= buffer->line_count - 1) {
         return 0;
     }
-    
-    char* line1 = buffer->lines[line_num];
-    char* line2 = buffer->lines[line_num + 1];
-    int len1 = strlen(line1);
-    int len2 = strlen(line2);
-    
-    if (len1 + len2 >= MAX_LINE_LENGTH) {
+
+    size_t start1, end1, start2, end2;
+    buffer_line_bounds(buffer, line_num, &start1, &end1);
+    buffer_line_bounds(buffer, line_num + 1, &start2, &end2);
+
+    // Drop the line terminator between the two lines
+    undo_begin_group(&buffer->undo);
+    int ok = buffer_cut(buffer, end1, start2 - end1, 0);
+    buffer_changed(buffer);
+    return ok;
+}
+
+int buffer_insert_text(TextBuffer* buffer, int line_num, int position, const char* text, int length) {
+    if (!buffer || line_num < 0 || line_num >= buffer->line_count || length < 0) {
+        return 0;
+    }
+
+    size_t start, end;
+    buffer_line_bounds(buffer, line_num, &start, &end);
+
+    if (position < 0) position = 0;
+    if ((size_t)position > end - start) position = (int)(end - start);
+
+    // Single typed characters coalesce into one undo step
+    int typed = length == 1 && text[0] != '\n' && text[0] != '\r';
+    undo_begin_group(&buffer->undo);
+    int ok = buffer_put(buffer, start + position, text, length, typed);
+    buffer_changed(buffer);
+    return ok;
+}
+
+// Copy text with each "\n", "\r\n" or lone "\r" made the buffer's own line
+// terminator. The copy is malloc'd and its length returned via out_length.
+char* buffer_convert_eol(TextBuffer* buffer, const char* text, size_t length, size_t* out_length) {
+    const char* eol = buffer_get_eol(buffer);
+    size_t eol_len = strlen(eol);
+    char* block = (char*)malloc(length * eol_len + 1);
+    if (!block) return NULL;
+
+    size_t out = 0;
+    for (size_t i = 0; i < length; i++) {
+        char ch = text[i];
+        if (ch == '\r' || ch == '\n') {
+            if (ch == '\r' && i + 1 < length && text[i + 1] == '\n') i++;
+            memcpy(block + out, eol, eol_len);
+            out += eol_len;
+        } else {
+            block[out++] = ch;
+        }
+    }
+    *out_length = out;
+    return block;
+}
+
+// Insert text that may span several lines, such as a paste, with a single
+// piece table insert, converting its line terminators. The end of the
+// inserted text is returned through end_line and end_position.
+int buffer_insert_block(TextBuffer* buffer, int line_num, int position, const char* text, size_t length,
+                        int* end_line, int* end_position) {
+    if (!buffer || line_num < 0 || line_num >= buffer->line_count) {
+        return 0;
+    }
+
+    size_t start, end;
+    buffer_line_bounds(buffer, line_num, &start, &end);
+
+    if (position < 0) position = 0;
+    if ((size_t)position > end - start) position = (int)(end - start);
+
+    size_t out;
+    char* block = buffer_convert_eol(buffer, text, length, &out);
+    if (!block) return 0;
+
+    // Every terminator ends in '\n' once converted
+    size_t last_line = 0;
+    int lines = 0;
+    for (size_t i = 0; i < out; i++) {
+        if (block[i] == '\n') {
+            last_line = i + 1;
+            lines++;
+        }
+    }
+
+    undo_begin_group(&buffer->undo);
+    int ok = buffer_put(buffer, start + position, block, out, 0);
+    free(block);
+    buffer_changed(buffer);
+
+    if (ok) {
+        *end_line = line_num + lines;
+        *end_position = (int)(out - last_line) + (lines == 0 ? position : 0);
+    }
+    return ok;
+}
+
+int buffer_delete_text(TextBuffer* buffer, int line_num, int position, int length) {
+    if (!buffer || line_num < 0 || line_num >= buffer->line_count ||
+        position < 0 || length < 0) {
+        return 0;
+    }
+
+    size_t start = piece_table_line_start(&buffer->table, line_num);
+    undo_begin_group(&buffer->undo);
+    int ok = buffer_cut(buffer, start + position, length, length == 1);
+    buffer_changed(buffer);
+    return ok;
+}
+
+// Replace every range [ranges[2i], ranges[2i + 1]), sorted and not
+// overlapping, with text in one pass over the document. Text between the
+// ranges is shared with the old version, not copied, and the old version's
+// piece list is all that undo needs to bring it back.
+int buffer_replace_all(TextBuffer* buffer, const size_t* ranges, size_t count, const char* text, size_t length) {
+    if (!buffer) return 0;
+    if (count == 0) return 1;
+
+    PieceSpan* old;
+    size_t old_count;
+    if (!piece_table_get_spans(&buffer->table, &old, &old_count)) return 0;
+    if (!piece_table_replace(&buffer->table, ranges, count, text, length)) {
+        free(old);
+        return 0;
+    }
+
+    buffer_note_rest(buffer, (int)piece_table_line_at(&buffer->table, ranges[0]));
+    undo_begin_group(&buffer->undo);
+    if (!undo_record_swap(&buffer->undo, ranges[0], (char*)old, old_count * sizeof(PieceSpan))) {
+        undo_clear(&buffer->undo);
+    }
+    buffer_changed(buffer);
+    return 1;
+}
+
+// Start collecting edits to make all at once. Until buffer_commit, no
+// other edits may be made; offsets given to buffer_apply are those of the
+// document as it is now.
+int buffer_begin_batch(TextBuffer* buffer) {
+    if (!buffer || buffer->batching) return 0;
+
+    buffer->batching = 1;
+    buffer->batch_count = 0;
+    buffer->batch_text_length = 0;
+    return 1;
+}
+
+// Queue replacing bytes [start, end) with text, which is copied. Edits
+// must come in document order without overlapping; an insertion may sit
+// where the edit before it ends. An edit with the same text as the one
+// before it shares that copy, so typing at every cursor stores the key once.
+int buffer_apply(TextBuffer* buffer, size_t start, size_t end, const char* text, size_t length) {
+    if (!buffer || !buffer->batching || start > end || end > piece_table_length(&buffer->table)) {
+        return 0;
+    }
+    if (buffer->batch_count > 0 && start < buffer->batch[buffer->batch_count - 1].end) {
+        return 0;
+    }
+    // Nothing to do, and no undo step for a batch of only these
+    if (start == end && length == 0) return 1;
+
+    if (buffer->batch_count == buffer->batch_capacity) {
+        size_t new_capacity = buffer->batch_capacity ? buffer->batch_capacity * 2 : 64;
+        PieceEdit* grown = (PieceEdit*)realloc(buffer->batch, new_capacity * sizeof(PieceEdit));
+        if (!grown) return 0;
+        buffer->batch = grown;
+        buffer->batch_capacity = new_capacity;
+    }
+
+    PieceEdit* edit = &buffer->batch[buffer->batch_count];
+    const PieceEdit* previous = buffer->batch_count > 0 ? edit - 1 : NULL;
+    edit->source = buffer->batch_text_length;
+    if (length > 0 && previous && previous->length == length &&
+        memcmp(buffer->batch_text + previous->source, text, length) == 0) {
+        edit->source = previous->source;
+    } else if (length > 0) {
+        if (buffer->batch_text_length + length > buffer->batch_text_capacity) {
+            size_t new_capacity = buffer->batch_text_capacity ? buffer->batch_text_capacity : 256;
+            while (new_capacity < buffer->batch_text_length + length) {
+                new_capacity *= 2;
+            }
+            char* grown = (char*)realloc(buffer->batch_text, new_capacity);
+            if (!grown) return 0;
+            buffer->batch_text = grown;
+            buffer->batch_text_capacity = new_capacity;
+        }
+        memcpy(buffer->batch_text + buffer->batch_text_length, text, length);
+        buffer->batch_text_length += length;
+    }
+    edit->start = start;
+    edit->end = end;
+    edit->length = length;
+    buffer->batch_count++;
+    return 1;
+}
+
+// Make the queued edits in one pass over the piece tree, as one undo step
+// and one change note for the view, however many edits there are
+int buffer_commit(TextBuffer* buffer) {
+    if (!buffer || !buffer->batching) return 0;
+
+    size_t count = buffer->batch_count;
+    buffer->batching = 0;
+    buffer->batch_count = 0;
+    if (count == 0) return 1;
+
+    // All the new text goes into the add buffer with one append, outside
+    // the document until the splice links it in
+    size_t base;
+    if (!piece_table_append(&buffer->table, buffer->batch_text, buffer->batch_text_length, &base)) return 0;
+
+    size_t removed = 0;
+    for (size_t i = 0; i < count; i++) {
+        buffer->batch[i].source += base;
+        removed += buffer->batch[i].end - buffer->batch[i].start;
+    }
+
+    // The record holds the edits, the ones that undo them and the text
+    // those put back
+    size_t size = 2 * count * sizeof(PieceEdit) + removed;
+    PieceEdit* record = (PieceEdit*)malloc(size);
+    if (record) {
+        memcpy(record, buffer->batch, count * sizeof(PieceEdit));
+    }
+    if (!buffer_splice(buffer, buffer->batch, count, record ? record + count : NULL,
+                       record ? (char*)(record + 2 * count) : NULL)) {
+        free(record);
+        undo_clear(&buffer->undo);
         return 0;
     }
-    
-    strcat(line1, line2);
-    buffer_delete_line(buffer, line_num + 1);
-    
+
+    // Pieces the splice joined were copied to the add buffer as well
+    size_t added = buffer->table.buffers[PIECE_ADD].length - base;
+    undo_begin_group(&buffer->undo);
+    if (!record || !undo_record_splice(&buffer->undo, record[0].start, (char*)record, size, count, added)) {
+        undo_clear(&buffer->undo);
+    }
     return 1;
 }
 
 void buffer_clear(TextBuffer* buffer) {
     if (!buffer) return;
-    
-    for (int i = 0; i < buffer->line_count; i++) {
-        free(buffer->lines[i]);
-    }
-    buffer->line_count = 0;
-    buffer_insert_line(buffer, 0, "");
+
+    piece_table_free(&buffer->table);
+    piece_table_init(&buffer->table);
+    undo_clear(&buffer->undo);
+    buffer->line_count = 1;
     buffer->filename[0] = '\0';
     buffer->modified = 0;
+    buffer->eol = EOL_LF;
+    buffer->load_progress = -1;
+    buffer_note_rest(buffer, 0);
 }
 
-char* buffer_get_line(TextBuffer* buffer, int index) {
-    if (!buffer || index < 0 || index >= buffer->line_count) {
+// Revert the newest group of edits, leaving *line and *column where the
+// change happened. Inserted text is cut out again with one delete and
+// removed text goes back with one insert, however large either was.
+int buffer_undo(TextBuffer* buffer, int* line, int* column) {
+    if (!buffer) return 0;
+
+    UndoLog* log = &buffer->undo;
+    if (log->current == log->first) return 0;
+
+    unsigned int group = log->records[log->current - 1].group;
+    size_t cursor = 0;
+    int ok = 1;
+    while (ok && log->current > log->first && log->records[log->current - 1].group == group) {
+        UndoRecord* record = &log->records[log->current - 1];
+        if (record->type == UNDO_INSERT) {
+            ok = buffer_delete_piece(buffer, record->offset, record->length);
+            cursor = record->offset;
+        } else if (record->type == UNDO_SWAP) {
+            ok = buffer_swap(buffer, record);
+            cursor = record->offset;
+        } else if (record->type == UNDO_SPLICE) {
+            ok = buffer_unsplice(buffer, record);
+            cursor = record->offset;
+        } else {
+            ok = buffer_insert_piece(buffer, record->offset, record->text, record->length);
+            cursor = record->offset + record->length;
+        }
+        if (ok) log->current--;
+    }
+
+    undo_seal(log);
+    buffer_changed(buffer);
+    buffer_get_position(buffer, cursor, line, column);
+    return ok;
+}
+
+// Apply the next undone group again. Redone inserts relink their text
+// from the add buffer instead of copying it.
+int buffer_redo(TextBuffer* buffer, int* line, int* column) {
+    if (!buffer) return 0;
+
+    UndoLog* log = &buffer->undo;
+    if (log->current == log->count) return 0;
+
+    unsigned int group = log->records[log->current].group;
+    size_t cursor = 0;
+    int ok = 1;
+    while (ok && log->current < log->count && log->records[log->current].group == group) {
+        UndoRecord* record = &log->records[log->current];
+        if (record->type == UNDO_INSERT) {
+            ok = buffer_insert_span(buffer, record->offset, record->source, record->length);
+            cursor = record->offset + record->length;
+        } else if (record->type == UNDO_SWAP) {
+            ok = buffer_swap(buffer, record);
+            cursor = record->offset;
+        } else if (record->type == UNDO_SPLICE) {
+            ok = buffer_splice(buffer, (const PieceEdit*)record->text, record->source, NULL, NULL);
+            cursor = record->offset;
+        } else {
+            ok = buffer_delete_piece(buffer, record->offset, record->length);
+            cursor = record->offset;
+        }
+        if (ok) log->current++;
+    }
+
+    undo_seal(log);
+    buffer_changed(buffer);
+    buffer_get_position(buffer, cursor, line, column);
+    return ok;
+}
+
+// Text of a line and its length in *length, which may be NULL. The text
+// may hold NUL bytes; it is NUL-terminated as well for callers that know
+// it does not.
+const char* buffer_get_line(TextBuffer* buffer, int index, int* length) {
+    return buffer_get_line_part(buffer, index, 0, INT_MAX, length);
+}
+
+// Bytes [from, from + count) of a line, clipped to it, so a view of a very
+// long line reads only what it shows
+const char* buffer_get_line_part(TextBuffer* buffer, int index, int from, int count, int* length) {
+    if (length) *length = 0;
+    if (!buffer || index < 0 || index >= buffer->line_count || from < 0 || count < 0) {
         return NULL;
     }
-    return buffer->lines[index];
+
+    size_t start, end;
+    buffer_line_bounds(buffer, index, &start, &end);
+    start = start + (size_t)from < end ? start + (size_t)from : end;
+    size_t len = end - start < (size_t)count ? end - start : (size_t)count;
+
+    // Lines are assembled from their pieces into a scratch buffer that
+    // stays valid until the next buffer_get_line call
+    if (len + 1 > buffer->line_cache_capacity) {
+        size_t new_capacity = buffer->line_cache_capacity ? buffer->line_cache_capacity : 1024;
+        while (new_capacity < len + 1) {
+            new_capacity *= 2;
+        }
+        char* grown = (char*)realloc(buffer->line_cache, new_capacity);
+        if (!grown) return NULL;
+        buffer->line_cache = grown;
+        buffer->line_cache_capacity = new_capacity;
+    }
+
+    piece_table_read(&buffer->table, start, len, buffer->line_cache);
+    buffer->line_cache[len] = '\0';
+    if (length) *length = (int)len;
+    return buffer->line_cache;
+}
+
+const char* buffer_get_eol(TextBuffer* buffer) {
+    return buffer->eol == EOL_CRLF ? "\r\n" : "\n";
 }
 
-int buffer_set_line(TextBuffer* buffer, int index, const char* text) {
+int buffer_get_line_length(TextBuffer* buffer, int index) {
     if (!buffer || index < 0 || index >= buffer->line_count) {
         return 0;
     }
-    
-    strncpy(buffer->lines[index], text, MAX_LINE_LENGTH - 1);
-    buffer->lines[index][MAX_LINE_LENGTH - 1] = '\0';
-    buffer->modified = 1;
-    
-    return 1;
+
+    size_t start, end;
+    buffer_line_bounds(buffer, index, &start, &end);
+    return (int)(end - start);
+}
+
+// Document offset of a line and column, the column clamped to the line
+size_t buffer_get_offset(TextBuffer* buffer, int line, int column) {
+    size_t start, end;
+    buffer_line_bounds(buffer, line, &start, &end);
+    if (column < 0) column = 0;
+    return start + (size_t)column < end ? start + (size_t)column : end;
+}
+
+// Line and column of a document offset
+void buffer_get_position(TextBuffer* buffer, size_t offset, int* line, int* column) {
+    *line = (int)piece_table_line_at(&buffer->table, offset);
+
+    size_t start, end;
+    buffer_line_bounds(buffer, *line, &start, &end);
+    *column = (int)((offset < end ? offset : end) - start);
+}
+
+int buffer_set_line(TextBuffer* buffer, int index, const char* text, int length) {
+    if (!buffer || index < 0 || index >= buffer->line_count || length < 0) {
+        return 0;
+    }
+
+    size_t start, end;
+    buffer_line_bounds(buffer, index, &start, &end);
+
+    undo_begin_group(&buffer->undo);
+    int ok = buffer_cut(buffer, start, end - start, 0) &&
+             buffer_put(buffer, start, text, (size_t)length, 0);
+    buffer_changed(buffer);
+    return ok;
+}
+
+// Hand the changes made since the last call to the view, which uses them
+// to keep what it cached about lines that did not change
+BufferChanges buffer_take_changes(TextBuffer* buffer) {
+    BufferChanges changes = buffer->changes;
+    buffer->changes.first = -1;
+    return changes;
 }
\ No newline at end of file
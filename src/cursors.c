@@ -0,0 +1,74 @@
+#include "cursors.h"
+#include <stdlib.h>
+
+void cursor_set_free(CursorSet* set) {
+    free(set->offsets);
+    set->offsets = NULL;
+    set->count = 0;
+    set->capacity = 0;
+}
+
+void cursor_set_clear(CursorSet* set) {
+    set->count = 0;
+}
+
+int cursor_set_reserve(CursorSet* set, size_t count) {
+    if (count <= set->capacity) return 1;
+
+    size_t new_capacity = set->capacity ? set->capacity : 64;
+    while (new_capacity < count) new_capacity *= 2;
+    size_t* grown = (size_t*)realloc(set->offsets, new_capacity * sizeof(size_t));
+    if (!grown) return 0;
+    set->offsets = grown;
+    set->capacity = new_capacity;
+    return 1;
+}
+
+// Adds in any order; cursor_set_normalize restores the order afterwards
+int cursor_set_add(CursorSet* set, size_t offset) {
+    if (!cursor_set_reserve(set, set->count + 1)) return 0;
+    set->offsets[set->count++] = offset;
+    return 1;
+}
+
+static int compare_offsets(const void* a, const void* b) {
+    size_t x = *(const size_t*)a;
+    size_t y = *(const size_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static int is_sorted(const CursorSet* set) {
+    for (size_t i = 1; i < set->count; i++) {
+        if (set->offsets[i - 1] > set->offsets[i]) return 0;
+    }
+    return 1;
+}
+
+// Sort the set and drop duplicates and any cursor on the main one, since
+// cursors that ran into each other act as one from then on. Edits keep
+// the order, so the sort is only paid after cursors were added.
+void cursor_set_normalize(CursorSet* set, size_t main_offset) {
+    if (!is_sorted(set)) {
+        qsort(set->offsets, set->count, sizeof(size_t), compare_offsets);
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < set->count; i++) {
+        size_t offset = set->offsets[i];
+        if (offset == main_offset) continue;
+        if (kept > 0 && set->offsets[kept - 1] == offset) continue;
+        set->offsets[kept++] = offset;
+    }
+    set->count = kept;
+}
+
+// Index of the first cursor at or after offset
+size_t cursor_set_lower_bound(const CursorSet* set, size_t offset) {
+    size_t lo = 0, hi = set->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (set->offsets[mid] < offset) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
\ No newline at end of file
@@ -1,10 +1,19 @@
 #include "editor.h"
+#include "file_ops.h"
 #include "platform.h"
+#include <errno.h>
 #include <stdio.h>
 #include <string.h>
 
 void editor_init(Editor* editor) {
     editor->buffer = buffer_create();
+    editor->loader = NULL;
+    editor->pager = NULL;
+    editor->pager_limit = PAGER_DEFAULT_RESIDENT_LIMIT;
+    editor->force_pager = 0;
+    memset(&editor->tui, 0, sizeof(TUIState));
+    memset(&editor->search, 0, sizeof(Search));
+    editor->search.pool = search_pool_create(platform_cpu_count());
     tui_init(&editor->tui);
     editor->running = 1;
 }
@@ -27,11 +36,17 @@ void editor_show_help() {
         "  Type          Insert text",
         "  Backspace     Delete character",
         "  Enter         New line",
+        "  Ctrl+F        Find (Ctrl+R switches to regex, Tab to replace all)",
+        "  Alt+Up/Down   Add a cursor above/below (ESC: back to one cursor)",
+        "  Alt+Enter     In Find: a cursor on every match",
+        "  Ctrl+Z        Undo",
+        "  Ctrl+Y        Redo",
         "",
         "Commands:",
         "  Ctrl+S        Save file",
         "  Ctrl+O        Open file",
         "  Ctrl+N        New file",
+        "  Ctrl+G        Go to line (read-only view)",
         "  Ctrl+Q        Quit",
         "  F1            This help",
         "  ESC           Exit from help",
@@ -58,7 +73,7 @@ void editor_show_help() {
         } else if (strstr(help_lines[i], "Navigation:") || strstr(help_lines[i], "Editing:") || strstr(help_lines[i], "Commands:")) {
             // Section headers - yellow on black
             platform_set_color(COLOR_YELLOW, COLOR_BLACK);
-        } else if (strstr(help_lines[i], "Ctrl+") || strstr(help_lines[i], "F1") || strstr(help_lines[i], "ESC")) {
+        } else if (strstr(help_lines[i], "Ctrl+") || strstr(help_lines[i], "Alt+") || strstr(help_lines[i], "F1") || strstr(help_lines[i], "ESC")) {
             // Commands - green on black
             platform_set_color(COLOR_GREEN, COLOR_BLACK);
         } else if (strstr(help_lines[i], "Press ESC") || strstr(help_lines[i], "Exit")) {
@@ -87,130 +102,243 @@ void editor_show_help() {
     }
 }
 
-void editor_run(Editor* editor) {
-    KeyEvent event;
+// Ask for a 1-based line number and move the read-only view there
+static void editor_pager_goto(Editor* editor) {
+    unsigned long long line;
     
-    while (editor->running) {
-        tui_handle_resize(&editor->tui);
-        tui_draw(&editor->tui, editor->buffer);
-        
-        if (input_get_key(&event)) {
-            if (event.ctrl) {
-                switch (event.key) {
-                    case 's':  // Ctrl+S
-                    case 'S':
-                        if (editor_file_save(editor)) {
-                            // File saved successfully
-                        } else {
-                            // Show error message
-                        }
-                        break;
-                    case 'o':  // Ctrl+O
-                    case 'O':
-                        tui_cleanup(&editor->tui);
-                        char filename[256];
-                        printf("Open file: ");
-                        if (scanf("%255s", filename) == 1) {
-                            editor_file_open(editor, filename);
-                        }
-                        tui_init(&editor->tui);
-                        break;
-                    case 'n':  // Ctrl+N
-                    case 'N':
-                        tui_cleanup(&editor->tui);
-                        editor_new(editor);
-                        tui_init(&editor->tui);
-                        break;
-                    case 'q':  // Ctrl+Q
-                    case 'Q':
-                        if (editor->buffer->modified) {
-                            tui_cleanup(&editor->tui);
-                            printf("Save changes before quitting? (y/n): ");
-                            char ch = getchar();
-                            if (ch == 'y' || ch == 'Y') {
-                                editor_file_save(editor);
-                            }
-                            tui_init(&editor->tui);
-                        }
-                        editor->running = 0;
-                        break;
+    tui_cleanup(&editor->tui);
+    printf("Go to line: ");
+    if (scanf("%llu", &line) == 1 && line > 0) {
+        if (!pager_goto_line(editor->pager, (size_t)(line - 1))) {
+            printf("Line %llu has not been indexed yet.\nPress any key to continue...", line);
+            getchar(); getchar();
+        }
+    }
+    tui_init(&editor->tui);
+}
+
+// Apply one key to the editor or the pager
+static void editor_handle_key(Editor* editor, KeyEvent event) {
+    editor->tui.message[0] = '\0';
+    if (editor->tui.search) {
+        if (!input_handle_search_key(&editor->tui, editor->buffer, event)) {
+            search_end(&editor->search);
+            editor->tui.search = NULL;
+        }
+        return;
+    }
+    
+    if (event.ctrl) {
+        switch (event.key) {
+            case 's':  // Ctrl+S
+            case 'S': {
+                errno = 0;
+                int saved = editor_file_save(editor);
+                if (saved == FILE_SAVED_IN_PLACE) {
+                    snprintf(editor->tui.message, sizeof(editor->tui.message),
+                             "Saved in place (file has other hard links)");
+                } else if (saved) {
+                    snprintf(editor->tui.message, sizeof(editor->tui.message), "Saved");
+                } else {
+                    snprintf(editor->tui.message, sizeof(editor->tui.message), "Save failed: %s",
+                             errno ? strerror(errno) : "unknown error");
+                }
+                break;
+            }
+            case 'o':  // Ctrl+O
+            case 'O':
+                tui_cleanup(&editor->tui);
+                char filename[256];
+                printf("Open file: ");
+                if (scanf("%255s", filename) == 1) {
+                    cursor_set_clear(&editor->tui.cursors);
+                    editor_file_open(editor, filename);
                 }
-            } else if (event.key == KEY_F1) {
+                tui_init(&editor->tui);
+                break;
+            case 'n':  // Ctrl+N
+            case 'N':
                 tui_cleanup(&editor->tui);
-                editor_show_help();
+                cursor_set_clear(&editor->tui.cursors);
+                editor_new(editor);
                 tui_init(&editor->tui);
-            } else if (event.key == KEY_ESC) {
-                // Handle ESC key for exit with confirmation
-                int rows, cols;
-                platform_get_console_size(&rows, &cols);
-                platform_clear_screen();
-                
-                // Center the exit confirmation dialog
-                const char* confirm_lines[] = {
-                    "Are you sure you want to exit?",
-                    "",
-                    "Press 'y' to exit, any other key to continue"
-                };
-                
-                int num_lines = sizeof(confirm_lines) / sizeof(confirm_lines[0]);
-                int start_row = (rows - num_lines) / 2;
-                if (start_row < 0) start_row = 0;
-                
-                for (int i = 0; i < num_lines; i++) {
-                    platform_set_cursor_position(0, start_row + i);
-                    
-                    int line_len = strlen(confirm_lines[i]);
-                    int start_col = (cols - line_len) / 2;
-                    if (start_col < 0) start_col = 0;
-                    
-                    // Set colors for exit confirmation
-                    if (i == 0) {
-                        platform_set_color(COLOR_RED, COLOR_BLACK);  // Warning in red
-                    } else if (i == 2) {
-                        platform_set_color(COLOR_YELLOW, COLOR_BLACK);  // Instructions in yellow
-                    } else {
-                        platform_set_color(COLOR_WHITE, COLOR_BLACK);  // Normal text
+                break;
+            case 'g':  // Ctrl+G
+            case 'G':
+                if (editor->pager) {
+                    editor_pager_goto(editor);
+                }
+                break;
+            case 'f':  // Ctrl+F
+            case 'F':
+                if (!editor->pager) {
+                    size_t origin = buffer_get_offset(editor->buffer, editor->tui.cursor_y, editor->tui.cursor_x);
+                    search_begin(&editor->search, origin);
+                    editor->tui.search = &editor->search;
+                }
+                break;
+            case 'z':  // Ctrl+Z
+            case 'Z':
+                if (!editor->pager) {
+                    input_undo(&editor->tui, editor->buffer);
+                }
+                break;
+            case 'y':  // Ctrl+Y
+            case 'Y':
+                if (!editor->pager) {
+                    input_redo(&editor->tui, editor->buffer);
+                }
+                break;
+            case 'q':  // Ctrl+Q
+            case 'Q':
+                if (editor->buffer->modified) {
+                    tui_cleanup(&editor->tui);
+                    printf("Save changes before quitting? (y/n): ");
+                    char ch = getchar();
+                    if (ch == 'y' || ch == 'Y') {
+                        editor_file_save(editor);
                     }
+                    tui_init(&editor->tui);
+                }
+                editor->running = 0;
+                break;
+        }
+    } else if (event.key == KEY_F1) {
+        tui_cleanup(&editor->tui);
+        editor_show_help();
+        tui_init(&editor->tui);
+    } else if (event.key == KEY_ESC && editor->tui.cursors.count > 0) {
+        // Back to the one cursor before ESC means exit
+        cursor_set_clear(&editor->tui.cursors);
+    } else if (event.key == KEY_ESC) {
+        // Handle ESC key for exit with confirmation
+        int rows, cols;
+        platform_get_console_size(&rows, &cols);
+        platform_clear_screen();
+        
+        // Center the exit confirmation dialog
+        const char* confirm_lines[] = {
+            "Are you sure you want to exit?",
+            "",
+            "Press 'y' to exit, any other key to continue"
+        };
+        
+        int num_lines = sizeof(confirm_lines) / sizeof(confirm_lines[0]);
+        int start_row = (rows - num_lines) / 2;
+        if (start_row < 0) start_row = 0;
+        
+        for (int i = 0; i < num_lines; i++) {
+            platform_set_cursor_position(0, start_row + i);
+            
+            int line_len = strlen(confirm_lines[i]);
+            int start_col = (cols - line_len) / 2;
+            if (start_col < 0) start_col = 0;
+            
+            // Set colors for exit confirmation
+            if (i == 0) {
+                platform_set_color(COLOR_RED, COLOR_BLACK);  // Warning in red
+            } else if (i == 2) {
+                platform_set_color(COLOR_YELLOW, COLOR_BLACK);  // Instructions in yellow
+            } else {
+                platform_set_color(COLOR_WHITE, COLOR_BLACK);  // Normal text
+            }
+            
+            for (int j = 0; j < start_col; j++) {
+                putchar(' ');
+            }
+            
+            printf("%s", confirm_lines[i]);
+            platform_reset_color();
+        }
+        
+        KeyEvent confirm_event;
+        if (platform_get_key(&confirm_event)) {
+            if (confirm_event.key == 'y' || confirm_event.key == 'Y') {
+                if (editor->buffer->modified) {
+                    platform_clear_screen();
+                    platform_set_cursor_position(0, rows/2);
+                    platform_set_color(COLOR_YELLOW, COLOR_BLACK);
                     
-                    for (int j = 0; j < start_col; j++) {
-                        putchar(' ');
-                    }
+                    int start_col = (cols - 40) / 2;
+                    for (int j = 0; j < start_col; j++) putchar(' ');
                     
-                    printf("%s", confirm_lines[i]);
+                    printf("Save changes before exiting? (y/n): ");
                     platform_reset_color();
-                }
-                
-                KeyEvent confirm_event;
-                if (platform_get_key(&confirm_event)) {
-                    if (confirm_event.key == 'y' || confirm_event.key == 'Y') {
-                        if (editor->buffer->modified) {
-                            platform_clear_screen();
-                            platform_set_cursor_position(0, rows/2);
-                            platform_set_color(COLOR_YELLOW, COLOR_BLACK);
-                            
-                            int start_col = (cols - 40) / 2;
-                            for (int j = 0; j < start_col; j++) putchar(' ');
-                            
-                            printf("Save changes before exiting? (y/n): ");
-                            platform_reset_color();
-                            
-                            char ch = getchar();
-                            if (ch == 'y' || ch == 'Y') {
-                                editor_file_save(editor);
-                            }
-                        }
-                        editor->running = 0;
+                    
+                    char ch = getchar();
+                    if (ch == 'y' || ch == 'Y') {
+                        editor_file_save(editor);
                     }
                 }
-                tui_init(&editor->tui);
+                editor->running = 0;
+            }
+        }
+        tui_init(&editor->tui);
+    } else if (editor->pager) {
+        input_handle_pager_key(&editor->tui, editor->pager, event);
+    } else {
+        input_handle_key(&editor->tui, editor->buffer, event);
+    }
+}
+
+void editor_run(Editor* editor) {
+    KeyEvent event;
+    int dirty = 1;
+    
+    while (editor->running) {
+        if (editor->loader && file_load_poll(editor->loader, editor->buffer)) {
+            file_load_close(editor->loader);
+            editor->loader = NULL;
+        }
+        if (editor->tui.search && search_poll(&editor->search)) {
+            dirty = 1;
+        }
+        
+        // Only repaint after a key, a resize or a background load step
+        if (dirty) {
+            if (editor->pager) {
+                tui_draw_pager(&editor->tui, editor->pager);
             } else {
-                input_handle_key(&editor->tui, editor->buffer, event);
+                tui_draw(&editor->tui, editor->buffer);
             }
+            dirty = 0;
+        }
+        
+        // Sleep until something happens; while a file is still loading or
+        // matches are being counted, wake up regularly to show progress
+        int loading = editor->loader || (editor->pager && pager_get_index_progress(editor->pager) >= 0);
+        int counting = editor->tui.search && search_running(&editor->search);
+        int events = platform_wait_event(loading || counting ? 50 : -1);
+        
+        if (events & PLATFORM_EVENT_RESIZE) {
+            tui_handle_resize(&editor->tui);
+            dirty = 1;
+        }
+        if (loading) {
+            dirty = 1;
+        }
+        if (!(events & PLATFORM_EVENT_INPUT)) {
+            continue;
+        }
+        dirty = 1;
+        
+        // Apply every key that has already arrived before drawing again,
+        // so a paste or fast typing costs one frame instead of one per key
+        while (editor->running && platform_input_pending(0)) {
+            if (!input_get_key(&event)) break;
+            editor_handle_key(editor, event);
         }
     }
 }
 
 void editor_cleanup(Editor* editor) {
+    search_free(&editor->search);
+    syntax_free(&editor->tui.syntax);
+    cursor_set_free(&editor->tui.cursors);
+    file_load_close(editor->loader);
+    editor->loader = NULL;
+    pager_close(editor->pager);
+    editor->pager = NULL;
     tui_cleanup(&editor->tui);
     buffer_destroy(editor->buffer);
 }
@@ -237,10 +365,14 @@ int editor_get_line_count(const Editor* editor) {
 }
 
 const char* editor_get_line(const Editor* editor, int index) {
-    return buffer_get_line(editor->buffer, index);
+    return buffer_get_line(editor->buffer, index, NULL);
 }
 
 void editor_new(Editor* editor) {
+    file_load_close(editor->loader);
+    editor->loader = NULL;
+    pager_close(editor->pager);
+    editor->pager = NULL;
     buffer_clear(editor->buffer);
     strcpy(editor->buffer->filename, "");
     editor->buffer->modified = 0;
@@ -1,14 +1,65 @@
 #include "file_ops.h"
 #include "display.h"
 #include "fileio.h"
+#include "platform.h"
 #include <stdio.h>
 #include <string.h>
 
+static size_t editor_file_size(const char *filename) {
+    PlatformHandle file;
+    size_t size;
+    
+    if (!platform_open_readonly(filename, &file, &size)) {
+        return 0;
+    }
+    platform_close_file(file);
+    return size;
+}
+
+// Files too big to hold in a TextBuffer are shown read-only by the pager
+static int editor_file_page(Editor *editor, const char *filename) {
+    Pager *pager = pager_open(filename, editor->pager_limit);
+    if (!pager) {
+        return 0;
+    }
+    
+    buffer_clear(editor->buffer);
+    editor->pager = pager;
+    editor->tui.offset_x = 0;
+    editor->tui.offset_y = 0;
+    return 1;
+}
+
 int editor_file_open(Editor *editor, const char *filename) {
-    return file_open(editor->buffer, filename);
+    // Any load still running targets the buffer we are about to reuse
+    file_load_close(editor->loader);
+    editor->loader = NULL;
+    pager_close(editor->pager);
+    editor->pager = NULL;
+    
+    if (editor->force_pager || editor_file_size(filename) >= PAGER_AUTO_SIZE) {
+        return editor_file_page(editor, filename);
+    }
+    
+    editor->loader = file_open_async(editor->buffer, filename);
+    return editor->loader != NULL;
+}
+
+// Saving needs the whole file, so let a background load catch up first
+static int editor_finish_load(Editor *editor) {
+    if (!editor->loader) return 1;
+    
+    int ok = file_load_wait(editor->loader, editor->buffer);
+    file_load_close(editor->loader);
+    editor->loader = NULL;
+    return ok;
 }
 
 int editor_file_save(Editor *editor) {
+    if (editor->pager || !editor_finish_load(editor)) {
+        return 0;
+    }
+    
     if (editor->buffer->filename[0]) {
         return file_save(editor->buffer, editor->buffer->filename);
     } else {
@@ -17,5 +68,9 @@ int editor_file_save(Editor *editor) {
 }
 
 int editor_file_save_as(Editor *editor, const char *filename) {
+    if (editor->pager || !editor_finish_load(editor)) {
+        return 0;
+    }
+    
     return file_save(editor->buffer, filename);
 }
\ No newline at end of file
@@ -4,24 +4,113 @@
 #include <string.h>
 #include <stdlib.h>
 
+#ifdef PLATFORM_UNIX
+#include <pthread.h>
+#endif
+
+// Bytes indexed per published slice of a background load
+#define FILE_LOAD_SLICE (4 * 1024 * 1024)
+
+// Piece spans gathered into one writev during a save
+#define FILE_SAVE_SPANS 256
+
+typedef struct {
+    PlatformHandle file;
+    PlatformSpan spans[FILE_SAVE_SPANS];
+    int count;
+} SaveBatch;
+
+// Newline offsets for one stretch of the file, handed from the loading
+// thread to the editor. `end` is where the visible text may grow to: the
+// start of the last line terminator found, so the tail line is only shown
+// once it is complete and never shows half of a "\r\n".
+typedef struct LoadSlice {
+    struct LoadSlice* next;
+    Arena arena;
+    LineIndex newlines;
+    size_t crlf_count;
+    size_t end;
+} LoadSlice;
+
+struct FileLoader {
+    const char* data;
+    size_t length;
+    size_t adopted;
+    LoadSlice* head;
+    LoadSlice* tail;
+    int done;
+    int failed;          // set by the loading thread, under the lock
+    int adopt_failed;    // set by the editor thread alone
+    int cancel;
+    int joined;
+#ifdef PLATFORM_UNIX
+    pthread_t thread;
+    pthread_mutex_t lock;
+#endif
+};
+
+static int save_flush(SaveBatch* batch) {
+    int ok = platform_write_spans(batch->file, batch->spans, batch->count);
+    batch->count = 0;
+    return ok;
+}
+
+static int save_span(void* context, const char* data, size_t length) {
+    SaveBatch* batch = (SaveBatch*)context;
+    
+    if (batch->count == FILE_SAVE_SPANS && !save_flush(batch)) {
+        return 0;
+    }
+    batch->spans[batch->count].data = data;
+    batch->spans[batch->count].length = length;
+    batch->count++;
+    return 1;
+}
+
+// The text goes to a temp file straight from the piece buffers, then
+// replaces the target in one rename, so a failed save leaves it intact.
+// Files a rename would split from their other names are written in place
+// and FILE_SAVED_IN_PLACE is returned.
 int file_save(TextBuffer* buffer, const char* filename) {
-    FILE* file = fopen(filename, "w");
-    if (!file) {
+#ifdef PLATFORM_WINDOWS
+    // Windows refuses to replace a file that is still mapped
+    if (!piece_table_detach(&buffer->table)) {
         return 0;
     }
+#endif
     
-    for (int i = 0; i < buffer->line_count; i++) {
-        char* line = buffer_get_line(buffer, i);
-        if (line) {
-            fprintf(file, "%s\n", line);
-        }
+    // Room for the resolved target, which may be longer than the name
+    char temp_path[PLATFORM_PATH_MAX + 16];
+    SaveBatch batch;
+    batch.count = 0;
+    if (!platform_create_temp(filename, temp_path, sizeof(temp_path), &batch.file)) {
+        return 0;
     }
     
-    fclose(file);
-    strncpy(buffer->filename, filename, sizeof(buffer->filename) - 1);
+    // No temp file: the target is rewritten where it is, so its text must
+    // not still be read from a mapping of it
+    if (!temp_path[0] && !piece_table_detach(&buffer->table)) {
+        platform_discard_file(batch.file, temp_path);
+        return 0;
+    }
+    
+    // The buffer leaves out the final line terminator
+    const char* eol = buffer_get_eol(buffer);
+    if (!piece_table_for_each(&buffer->table, save_span, &batch) ||
+        !save_span(&batch, eol, strlen(eol)) || !save_flush(&batch)) {
+        platform_discard_file(batch.file, temp_path);
+        return 0;
+    }
+    if (!platform_commit_file(batch.file, temp_path, filename)) {
+        return 0;
+    }
+    
+    if (filename != buffer->filename) {
+        strncpy(buffer->filename, filename, sizeof(buffer->filename) - 1);
+    }
     buffer->modified = 0;
     
-    return 1;
+    return temp_path[0] ? 1 : FILE_SAVED_IN_PLACE;
 }
 
 int file_save_as(TextBuffer* buffer) {
@@ -46,39 +135,210 @@ int file_save_as(TextBuffer* buffer) {
 }
 
 int file_open(TextBuffer* buffer, const char* filename) {
-    FILE* file = fopen(filename, "r");
-    if (!file) {
+    char* data;
+    size_t size;
+    
+    // Map the file instead of copying it: unedited text is read straight
+    // from the mapping and only edits go to private memory
+    if (!platform_map_file(filename, &data, &size)) {
         return 0;
     }
     
     buffer_clear(buffer);
+    if (!buffer_load(buffer, data, size, 1)) {
+        buffer_clear(buffer);
+        return 0;
+    }
     
-    char line[MAX_LINE_LENGTH];
-    int line_num = 0;
+    strncpy(buffer->filename, filename, sizeof(buffer->filename) - 1);
+    buffer->modified = 0;
+    
+    return 1;
+}
+
+static void file_load_lock(FileLoader* loader) {
+#ifdef PLATFORM_UNIX
+    pthread_mutex_lock(&loader->lock);
+#else
+    (void)loader;
+#endif
+}
+
+static void file_load_unlock(FileLoader* loader) {
+#ifdef PLATFORM_UNIX
+    pthread_mutex_unlock(&loader->lock);
+#else
+    (void)loader;
+#endif
+}
+
+static void load_slice_free(LoadSlice* slice) {
+    arena_free(&slice->arena);
+    free(slice);
+}
+
+// Runs on the loading thread. It only reads the mapping and fills slices
+// of its own; the piece table is touched by the editor thread alone.
+static void* file_load_worker(void* arg) {
+    FileLoader* loader = (FileLoader*)arg;
+    size_t from = 0;
+    size_t published = 0;
+    int failed = 0;
     
-    while (fgets(line, sizeof(line), file) && line_num < MAX_LINES) {
-        // Remove newline
-        size_t len = strlen(line);
-        if (len > 0 && line[len - 1] == '\n') {
-            line[len - 1] = '\0';
+    while (from < loader->length) {
+        file_load_lock(loader);
+        int cancel = loader->cancel;
+        file_load_unlock(loader);
+        if (cancel) break;
+        
+        size_t to = loader->length - from > FILE_LOAD_SLICE ? from + FILE_LOAD_SLICE : loader->length;
+        
+        LoadSlice* slice = (LoadSlice*)malloc(sizeof(LoadSlice));
+        if (!slice) {
+            failed = 1;
+            break;
         }
-        if (len > 1 && line[len - 2] == '\r') {
-            line[len - 2] = '\0';
+        slice->next = NULL;
+        slice->crlf_count = 0;
+        arena_init(&slice->arena);
+        line_index_init(&slice->newlines, &slice->arena);
+        
+        if (!linescan_build(loader->data, from, to, &slice->newlines, &slice->crlf_count)) {
+            load_slice_free(slice);
+            failed = 1;
+            break;
         }
         
-        if (line_num == 0) {
-            buffer_set_line(buffer, 0, line);
+        if (to == loader->length) {
+            slice->end = to;
+        } else if (slice->newlines.count > 0) {
+            size_t newline = line_index_get(&slice->newlines, slice->newlines.count - 1);
+            if (newline > 0 && loader->data[newline - 1] == '\r') newline--;
+            slice->end = newline;
         } else {
-            buffer_insert_line(buffer, line_num, line);
+            slice->end = published;
         }
-        line_num++;
+        published = slice->end;
+        
+        file_load_lock(loader);
+        if (loader->tail) {
+            loader->tail->next = slice;
+        } else {
+            loader->head = slice;
+        }
+        loader->tail = slice;
+        file_load_unlock(loader);
+        
+        from = to;
     }
     
-    fclose(file);
+    file_load_lock(loader);
+    loader->done = 1;
+    loader->failed = failed;
+    file_load_unlock(loader);
+    return NULL;
+}
+
+FileLoader* file_open_async(TextBuffer* buffer, const char* filename) {
+    char* data;
+    size_t size;
+    
+    if (!platform_map_file(filename, &data, &size)) {
+        return NULL;
+    }
+    
+    FileLoader* loader = (FileLoader*)calloc(1, sizeof(FileLoader));
+    if (!loader) {
+        platform_unmap_file(data, size);
+        return NULL;
+    }
+    
+    buffer_clear(buffer);
+    loader->data = data;
+    loader->length = buffer_load_begin(buffer, data, size, 1);
     strncpy(buffer->filename, filename, sizeof(buffer->filename) - 1);
-    buffer->modified = 0;
     
-    return 1;
+#ifdef PLATFORM_UNIX
+    pthread_mutex_init(&loader->lock, NULL);
+    if (pthread_create(&loader->thread, NULL, file_load_worker, loader) != 0) {
+        pthread_mutex_destroy(&loader->lock);
+        free(loader);
+        buffer_clear(buffer);
+        return NULL;
+    }
+#else
+    // No loading thread here: index the whole file up front
+    file_load_worker(loader);
+#endif
+    
+    return loader;
+}
+
+// Adopt every slice the loading thread has published so far. Returns 1
+// once the load has finished and the whole file is in the buffer.
+int file_load_poll(FileLoader* loader, TextBuffer* buffer) {
+    file_load_lock(loader);
+    LoadSlice* slice = loader->head;
+    loader->head = NULL;
+    loader->tail = NULL;
+    int done = loader->done;
+    file_load_unlock(loader);
+    
+    while (slice) {
+        LoadSlice* next = slice->next;
+        if (!buffer_load_append(buffer, &slice->newlines, slice->crlf_count, slice->end)) {
+            loader->adopt_failed = 1;
+        }
+        loader->adopted = slice->end;
+        load_slice_free(slice);
+        slice = next;
+    }
+    
+    if (done) {
+        buffer->load_progress = -1;
+    } else {
+        buffer->load_progress = loader->length ? (int)(loader->adopted * 100 / loader->length) : 100;
+    }
+    return done;
+}
+
+// Block until the whole file is in the buffer; returns 0 if it failed
+int file_load_wait(FileLoader* loader, TextBuffer* buffer) {
+#ifdef PLATFORM_UNIX
+    if (!loader->joined) {
+        pthread_join(loader->thread, NULL);
+        loader->joined = 1;
+    }
+#endif
+    file_load_poll(loader, buffer);
+    
+    file_load_lock(loader);
+    int failed = loader->failed;
+    file_load_unlock(loader);
+    return !failed && !loader->adopt_failed;
+}
+
+// Stop the loading thread and release the loader. Must run before the
+// buffer it was loading into is cleared or destroyed.
+void file_load_close(FileLoader* loader) {
+    if (!loader) return;
+    
+#ifdef PLATFORM_UNIX
+    file_load_lock(loader);
+    loader->cancel = 1;
+    file_load_unlock(loader);
+    if (!loader->joined) {
+        pthread_join(loader->thread, NULL);
+    }
+    pthread_mutex_destroy(&loader->lock);
+#endif
+    
+    while (loader->head) {
+        LoadSlice* next = loader->head->next;
+        load_slice_free(loader->head);
+        loader->head = next;
+    }
+    free(loader);
 }
 
 int file_new(TextBuffer* buffer) {
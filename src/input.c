@@ -1,13 +1,17 @@
 #include "input.h"
 #include "platform.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 int input_get_key(KeyEvent* event) {
     return platform_get_key(event);
 }
 
-void input_handle_key(TUIState* tui, TextBuffer* buffer, KeyEvent event) {
-    switch (event.key) {
+// Apply a movement key to the cursor at cursor_x/cursor_y. Returns 0 for
+// keys that do not move it.
+static int input_move_key(TUIState* tui, TextBuffer* buffer, int key) {
+    switch (key) {
         case KEY_UP:
             input_move_cursor(tui, buffer, 0, -1);
             break;
@@ -23,11 +27,9 @@ void input_handle_key(TUIState* tui, TextBuffer* buffer, KeyEvent event) {
         case KEY_HOME:
             tui->cursor_x = 0;
             break;
-        case KEY_END: {
-            char* line = buffer_get_line(buffer, tui->cursor_y);
-            tui->cursor_x = line ? strlen(line) : 0;
+        case KEY_END:
+            tui->cursor_x = buffer_get_line_length(buffer, tui->cursor_y);
             break;
-        }
         case KEY_PAGE_UP:
             tui->cursor_y -= tui_get_max_display_lines(tui);
             if (tui->cursor_y < 0) tui->cursor_y = 0;
@@ -38,87 +40,386 @@ void input_handle_key(TUIState* tui, TextBuffer* buffer, KeyEvent event) {
                 tui->cursor_y = buffer->line_count - 1;
             }
             break;
-        case KEY_BACKSPACE:
-            if (tui->cursor_x > 0) {
-                char* line = buffer_get_line(buffer, tui->cursor_y);
-                if (line) {
-                    int len = strlen(line);
-                    for (int i = tui->cursor_x - 1; i < len; i++) {
-                        line[i] = line[i + 1];
+        default:
+            return 0;
+    }
+    return 1;
+}
+
+// The two bytes on either side of a cursor tell whether it is at the
+// start or the end of its line, which is cheaper than finding its line
+// when there are many. They are read for all cursors in one walk.
+#define INPUT_AROUND 2
+
+static char* input_read_around(TextBuffer* buffer, const size_t* offsets, size_t count) {
+    char* around = (char*)malloc(count * 2 * INPUT_AROUND);
+    if (around) {
+        piece_table_read_around(&buffer->table, offsets, count, INPUT_AROUND, around);
+    }
+    return around;
+}
+
+// Length of the line terminator just before a cursor
+static int input_break_before(const char* around) {
+    if (around[1] != '\n') return 0;
+    return around[0] == '\r' ? 2 : 1;
+}
+
+static int input_at_line_end(TextBuffer* buffer, size_t offset, const char* around) {
+    return offset == piece_table_length(&buffer->table) || around[2] == '\n' ||
+           (around[2] == '\r' && around[3] == '\n');
+}
+
+// Move the other cursors the way the main one just moved. Cursors that
+// meet become one.
+static void input_move_cursors(TUIState* tui, TextBuffer* buffer, int key) {
+    CursorSet* cursors = &tui->cursors;
+    int x = tui->cursor_x;
+    int y = tui->cursor_y;
+    
+    char* around = NULL;
+    if (key == KEY_LEFT || key == KEY_RIGHT) {
+        around = input_read_around(buffer, cursors->offsets, cursors->count);
+        if (!around) return;
+    }
+    
+    for (size_t i = 0; i < cursors->count; i++) {
+        size_t offset = cursors->offsets[i];
+        if (key == KEY_LEFT) {
+            if (offset > 0 && !input_break_before(around + i * 2 * INPUT_AROUND)) cursors->offsets[i]--;
+            continue;
+        } else if (key == KEY_RIGHT) {
+            if (!input_at_line_end(buffer, offset, around + i * 2 * INPUT_AROUND)) cursors->offsets[i]++;
+            continue;
+        }
+        buffer_get_position(buffer, offset, &tui->cursor_y, &tui->cursor_x);
+        input_move_key(tui, buffer, key);
+        cursors->offsets[i] = buffer_get_offset(buffer, tui->cursor_y, tui->cursor_x);
+    }
+    free(around);
+    tui->cursor_x = x;
+    tui->cursor_y = y;
+    cursor_set_normalize(cursors, buffer_get_offset(buffer, y, x));
+}
+
+// Make an editing key's edit at every cursor, the main one included, as
+// one batch: one pass over the document and one undo step however many
+// cursors there are
+static void input_edit_cursors(TUIState* tui, TextBuffer* buffer, KeyEvent event) {
+    CursorSet* cursors = &tui->cursors;
+    char ch = (char)event.key;
+    const char* text = &ch;
+    size_t length = 1;
+    char* pasted = NULL;
+    
+    if (event.key == KEY_BACKSPACE || event.key == KEY_DELETE) {
+        length = 0;
+    } else if (event.key == KEY_ENTER) {
+        text = buffer_get_eol(buffer);
+        length = strlen(text);
+    } else if (event.key == KEY_PASTE) {
+        size_t raw_length;
+        const char* raw = platform_get_paste(&raw_length);
+        if (raw_length == 0) return;
+        pasted = buffer_convert_eol(buffer, raw, raw_length, &length);
+        if (!pasted) return;
+        text = pasted;
+    } else if (event.key < 32 || event.key > 126) {
+        return;
+    }
+    
+    // The main cursor joins the others for the edit
+    size_t main_offset = buffer_get_offset(buffer, tui->cursor_y, tui->cursor_x);
+    size_t main_index = cursor_set_lower_bound(cursors, main_offset);
+    if (!cursor_set_add(cursors, main_offset)) {
+        free(pasted);
+        return;
+    }
+    size_t count = cursors->count;
+    size_t* offsets = cursors->offsets;
+    memmove(offsets + main_index + 1, offsets + main_index, (count - 1 - main_index) * sizeof(size_t));
+    offsets[main_index] = main_offset;
+    
+    char* around = NULL;
+    if (event.key == KEY_BACKSPACE || event.key == KEY_DELETE) {
+        around = input_read_around(buffer, offsets, count);
+    }
+    
+    // Each cursor ends up after its own edit, moved by the size change of
+    // all the edits before it
+    buffer_begin_batch(buffer);
+    long long shift = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t start = offsets[i];
+        size_t end = offsets[i];
+        // Without the bytes around the cursors nothing is deleted
+        const char* bytes = around ? around + i * 2 * INPUT_AROUND : NULL;
+        if (bytes && event.key == KEY_DELETE) {
+            if (!input_at_line_end(buffer, end, bytes)) end++;
+        } else if (bytes && event.key == KEY_BACKSPACE && start > 0) {
+            // At the start of a line, the terminator goes and the lines join
+            int terminator = input_break_before(bytes);
+            start -= terminator ? (size_t)terminator : 1;
+        }
+        
+        size_t inserted = length;
+        if (!buffer_apply(buffer, start, end, text, length)) {
+            start = end = offsets[i];
+            inserted = 0;
+        }
+        offsets[i] = (size_t)((long long)start + shift) + inserted;
+        shift += (long long)inserted - (long long)(end - start);
+    }
+    buffer_commit(buffer);
+    free(around);
+    free(pasted);
+    
+    main_offset = offsets[main_index];
+    memmove(offsets + main_index, offsets + main_index + 1, (count - 1 - main_index) * sizeof(size_t));
+    cursors->count--;
+    buffer_get_position(buffer, main_offset, &tui->cursor_y, &tui->cursor_x);
+    cursor_set_normalize(cursors, main_offset);
+}
+
+// Leave a cursor where the main one is and move the main one a line up or
+// down, building a column of cursors
+static void input_add_cursor(TUIState* tui, TextBuffer* buffer, int dy) {
+    int y = tui->cursor_y + dy;
+    if (y < 0 || y >= buffer->line_count) return;
+    
+    if (!cursor_set_add(&tui->cursors, buffer_get_offset(buffer, tui->cursor_y, tui->cursor_x))) return;
+    input_move_cursor(tui, buffer, 0, dy);
+    cursor_set_normalize(&tui->cursors, buffer_get_offset(buffer, tui->cursor_y, tui->cursor_x));
+}
+
+void input_handle_key(TUIState* tui, TextBuffer* buffer, KeyEvent event) {
+    if (event.alt && (event.key == KEY_UP || event.key == KEY_DOWN)) {
+        input_add_cursor(tui, buffer, event.key == KEY_UP ? -1 : 1);
+    } else if (input_move_key(tui, buffer, event.key)) {
+        if (tui->cursors.count > 0) {
+            input_move_cursors(tui, buffer, event.key);
+        }
+    } else if (tui->cursors.count > 0) {
+        input_edit_cursors(tui, buffer, event);
+    } else {
+        switch (event.key) {
+            case KEY_BACKSPACE:
+                if (tui->cursor_x > 0) {
+                    if (buffer_delete_text(buffer, tui->cursor_y, tui->cursor_x - 1, 1)) {
+                        tui->cursor_x--;
                     }
-                    tui->cursor_x--;
-                    buffer->modified = 1;
-                }
-            } else if (tui->cursor_y > 0) {
-                // Merge with previous line
-                char* prev_line = buffer_get_line(buffer, tui->cursor_y - 1);
-                char* curr_line = buffer_get_line(buffer, tui->cursor_y);
-                if (prev_line && curr_line) {
-                    int prev_len = strlen(prev_line);
-                    int curr_len = strlen(curr_line);
-                    
-                    if (prev_len + curr_len < MAX_LINE_LENGTH) {
-                        strcat(prev_line, curr_line);
-                        buffer_delete_line(buffer, tui->cursor_y);
+                } else if (tui->cursor_y > 0) {
+                    // Merge with previous line
+                    int prev_len = buffer_get_line_length(buffer, tui->cursor_y - 1);
+                    if (buffer_merge_line(buffer, tui->cursor_y - 1)) {
                         tui->cursor_x = prev_len;
                         tui->cursor_y--;
                     }
                 }
+                break;
+            case KEY_DELETE:
+                input_delete_char(tui, buffer);
+                break;
+            case KEY_ENTER:
+                if (buffer_split_line(buffer, tui->cursor_y, tui->cursor_x)) {
+                    tui->cursor_y++;
+                    tui->cursor_x = 0;
+                }
+                break;
+            case KEY_PASTE: {
+                size_t length;
+                const char* text = platform_get_paste(&length);
+                input_paste(tui, buffer, text, length);
+                break;
             }
+            default:
+                if (event.key >= 32 && event.key <= 126) {  // Printable ASCII
+                    input_insert_char(tui, buffer, (char)event.key);
+                } else if (event.ctrl) {
+                    // Handle Ctrl+key combinations
+                    // These will be processed in main loop
+                    break;
+                }
+                break;
+        }
+    }
+    
+    input_scroll_to_cursor(tui);
+}
+
+// Paging mode is read-only: keys only move the view
+void input_handle_pager_key(TUIState* tui, Pager* pager, KeyEvent event) {
+    int page = tui_get_max_display_lines(tui);
+    
+    switch (event.key) {
+        case KEY_UP:
+            pager_scroll(pager, -1);
             break;
-        case KEY_DELETE:
-            input_delete_char(tui, buffer);
+        case KEY_DOWN:
+            pager_scroll(pager, 1);
             break;
-        case KEY_ENTER: {
-            char* line = buffer_get_line(buffer, tui->cursor_y);
-            if (line) {
-                buffer_split_line(buffer, tui->cursor_y, tui->cursor_x);
-                tui->cursor_y++;
-                tui->cursor_x = 0;
-            }
+        case KEY_LEFT:
+            if (tui->offset_x > 0) tui->offset_x--;
             break;
-        }
-        default:
-            if (event.key >= 32 && event.key <= 126) {  // Printable ASCII
-                input_insert_char(tui, buffer, (char)event.key);
-            } else if (event.ctrl) {
-                // Handle Ctrl+key combinations
-                // These will be processed in main loop
-                break;
-            }
+        case KEY_RIGHT:
+            tui->offset_x++;
+            break;
+        case KEY_PAGE_UP:
+            pager_scroll(pager, -page);
+            break;
+        case KEY_PAGE_DOWN:
+            pager_scroll(pager, page);
+            break;
+        case KEY_HOME:
+            pager_goto_start(pager);
+            tui->offset_x = 0;
+            break;
+        case KEY_END:
+            pager_goto_end(pager, page);
             break;
     }
+}
+
+// Replace every match of the find query at once and report how many
+void input_replace_all(TUIState* tui, TextBuffer* buffer) {
+    Search* search = tui->search;
+    size_t count;
     
-    input_scroll_to_cursor(tui);
+    // The background count reads the document, so it stops first
+    search_end(search);
+    size_t* ranges = search_find_all(search, &buffer->table, &count);
+    if (!ranges) return;
+    
+    if (buffer_replace_all(buffer, ranges, count, search->replacement, search->replacement_length)) {
+        cursor_set_clear(&tui->cursors);
+        snprintf(tui->message, sizeof(tui->message), "Replaced %llu", (unsigned long long)count);
+        
+        // Matches never span lines, so the cursor's line is still there
+        int len = buffer_get_line_length(buffer, tui->cursor_y);
+        if (tui->cursor_x > len) tui->cursor_x = len;
+    }
+    free(ranges);
 }
 
-void input_insert_char(TUIState* tui, TextBuffer* buffer, char ch) {
-    char* line = buffer_get_line(buffer, tui->cursor_y);
-    if (!line) return;
+// Put a cursor on the start of every match of the find query, the main
+// one staying on the current match
+void input_select_matches(TUIState* tui, TextBuffer* buffer) {
+    Search* search = tui->search;
+    size_t count;
+    
+    search_end(search);
+    size_t* ranges = search_find_all(search, &buffer->table, &count);
+    if (!ranges) return;
+    
+    cursor_set_clear(&tui->cursors);
+    if (cursor_set_reserve(&tui->cursors, count)) {
+        for (size_t i = 0; i < count; i++) {
+            cursor_set_add(&tui->cursors, ranges[2 * i]);
+        }
+        cursor_set_normalize(&tui->cursors, buffer_get_offset(buffer, tui->cursor_y, tui->cursor_x));
+        snprintf(tui->message, sizeof(tui->message), "%llu cursors", (unsigned long long)count);
+    }
+    free(ranges);
+}
+
+// Keys while the find prompt is open. The cursor follows the match as the
+// query changes. Returns 0 once the prompt is closed.
+int input_handle_search_key(TUIState* tui, TextBuffer* buffer, KeyEvent event) {
+    Search* search = tui->search;
+    long long found;
     
-    int len = strlen(line);
-    if (len >= MAX_LINE_LENGTH - 1) return;
+    // Tab moves between the query and the replacement, which is edited
+    // without moving the cursor
+    if (event.key == KEY_TAB) {
+        search->replacing = !search->replacing;
+        return 1;
+    }
+    if (event.key == KEY_ENTER && event.alt) {
+        input_select_matches(tui, buffer);
+        return 0;
+    }
+    if (search->replacing) {
+        if (event.key == KEY_ENTER) {
+            input_replace_all(tui, buffer);
+            return 0;
+        } else if (event.key == KEY_BACKSPACE) {
+            if (search->replacement_length > 0) {
+                search->replacement[--search->replacement_length] = '\0';
+            }
+            return 1;
+        } else if (!event.ctrl && !event.alt && event.key >= 32 && event.key <= 126) {
+            if (search->replacement_length < SEARCH_MAX_QUERY) {
+                search->replacement[search->replacement_length++] = (char)event.key;
+                search->replacement[search->replacement_length] = '\0';
+            }
+            return 1;
+        }
+    }
     
-    // Make space for new character
-    for (int i = len; i >= tui->cursor_x; i--) {
-        line[i + 1] = line[i];
+    if (event.key == KEY_ENTER) {
+        return 0;
+    } else if (event.key == KEY_ESC) {
+        found = (long long)search->origin;
+    } else if (event.key == KEY_BACKSPACE) {
+        found = search_erase(search, &buffer->table);
+    } else if (event.key == KEY_DOWN || (event.ctrl && (event.key == 'f' || event.key == 'F'))) {
+        found = search_next(search, &buffer->table);
+    } else if (event.ctrl && (event.key == 'r' || event.key == 'R')) {
+        found = search_toggle_regexp(search, &buffer->table);
+    } else if (!event.ctrl && !event.alt && event.key >= 32 && event.key <= 126) {
+        found = search_type(search, &buffer->table, (char)event.key);
+    } else {
+        return 1;
     }
     
-    line[tui->cursor_x] = ch;
-    tui->cursor_x++;
-    buffer->modified = 1;
+    if (found >= 0) {
+        buffer_get_position(buffer, (size_t)found, &tui->cursor_y, &tui->cursor_x);
+        input_scroll_to_cursor(tui);
+    }
+    return event.key != KEY_ESC;
 }
 
-void input_delete_char(TUIState* tui, TextBuffer* buffer) {
-    char* line = buffer_get_line(buffer, tui->cursor_y);
-    if (!line) return;
+void input_insert_char(TUIState* tui, TextBuffer* buffer, char ch) {
+    if (buffer_insert_text(buffer, tui->cursor_y, tui->cursor_x, &ch, 1)) {
+        tui->cursor_x++;
+    }
+}
+
+// A paste is inserted as one block instead of being typed key by key
+void input_paste(TUIState* tui, TextBuffer* buffer, const char* text, size_t length) {
+    if (length == 0) return;
     
-    int len = strlen(line);
+    int line, position;
+    if (buffer_insert_block(buffer, tui->cursor_y, tui->cursor_x, text, length, &line, &position)) {
+        tui->cursor_y = line;
+        tui->cursor_x = position;
+    }
+}
+
+void input_undo(TUIState* tui, TextBuffer* buffer) {
+    int line, column;
+    if (buffer_undo(buffer, &line, &column)) {
+        cursor_set_clear(&tui->cursors);
+        tui->cursor_y = line;
+        tui->cursor_x = column;
+        input_scroll_to_cursor(tui);
+    }
+}
+
+void input_redo(TUIState* tui, TextBuffer* buffer) {
+    int line, column;
+    if (buffer_redo(buffer, &line, &column)) {
+        cursor_set_clear(&tui->cursors);
+        tui->cursor_y = line;
+        tui->cursor_x = column;
+        input_scroll_to_cursor(tui);
+    }
+}
+
+void input_delete_char(TUIState* tui, TextBuffer* buffer) {
+    int len = buffer_get_line_length(buffer, tui->cursor_y);
     if (tui->cursor_x < len) {
-        for (int i = tui->cursor_x; i < len; i++) {
-            line[i] = line[i + 1];
-        }
-        buffer->modified = 1;
+        buffer_delete_text(buffer, tui->cursor_y, tui->cursor_x, 1);
     }
 }
 
@@ -129,8 +430,7 @@ void input_move_cursor(TUIState* tui, TextBuffer* buffer, int dx, int dy) {
     if (new_y >= 0 && new_y < buffer->line_count) {
         tui->cursor_y = new_y;
         
-        char* line = buffer_get_line(buffer, tui->cursor_y);
-        int line_len = line ? strlen(line) : 0;
+        int line_len = buffer_get_line_length(buffer, tui->cursor_y);
         
         if (new_x < 0) new_x = 0;
         if (new_x > line_len) new_x = line_len;
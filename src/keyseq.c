@@ -0,0 +1,150 @@
+#include "keyseq.h"
+
+#define KEYSEQ_ESC 0x1B
+
+// Keys named by the final byte of "ESC [ ... x" or "ESC O x", indexed
+// by that byte
+static const unsigned short final_keys[128] = {
+    ['A'] = KEY_UP,
+    ['B'] = KEY_DOWN,
+    ['C'] = KEY_RIGHT,
+    ['D'] = KEY_LEFT,
+    ['H'] = KEY_HOME,
+    ['F'] = KEY_END,
+    ['P'] = KEY_F1,
+};
+
+// Keys named by the number in "ESC [ n ~", indexed by that number
+#define KEYSEQ_MAX_NUMBER 200
+
+static const unsigned short number_keys[KEYSEQ_MAX_NUMBER + 1] = {
+    [1] = KEY_HOME,
+    [3] = KEY_DELETE,
+    [4] = KEY_END,
+    [5] = KEY_PAGE_UP,
+    [6] = KEY_PAGE_DOWN,
+    [7] = KEY_HOME,
+    [8] = KEY_END,
+    [11] = KEY_F1,
+    [200] = KEY_PASTE,
+};
+
+static int lookup_final(unsigned char final) {
+    return final < 128 ? final_keys[final] : 0;
+}
+
+static int lookup_number(int number) {
+    return number <= KEYSEQ_MAX_NUMBER ? number_keys[number] : 0;
+}
+
+// xterm modifier parameter: 1 + (shift | alt << 1 | ctrl << 2 | meta << 3)
+static void apply_modifiers(KeyEvent* event, int modifier) {
+    if (modifier < 2) return;
+    modifier--;
+    event->shift = (modifier & 1) != 0;
+    event->alt = (modifier & (2 | 8)) != 0;
+    event->ctrl = (modifier & 4) != 0;
+}
+
+// A single byte: printable, or a control code standing for Ctrl+letter
+static void decode_byte(unsigned char ch, KeyEvent* event) {
+    event->key = ch;
+    if (ch == 127 || ch == 8) {
+        event->key = KEY_BACKSPACE;
+    } else if (ch >= 1 && ch <= 26 && ch != KEY_TAB && ch != KEY_ENTER) {
+        event->key = 'a' + ch - 1;
+        event->ctrl = 1;
+    }
+}
+
+// "ESC [ params final". Parameters are up to two numbers split by ';':
+// a key number for '~' sequences and an xterm modifier.
+static size_t decode_csi(const unsigned char* data, size_t length, int complete, KeyEvent* event) {
+    // Most keys are a bare final byte ("ESC [ A") or one digit ("ESC [ 3 ~")
+    if (length >= 3 && data[2] >= 0x40 && data[2] <= 0x7E) {
+        event->key = lookup_final(data[2]);
+        return 3;
+    }
+    if (length >= 4 && data[3] == '~' && data[2] >= '0' && data[2] <= '9') {
+        event->key = lookup_number(data[2] - '0');
+        return 4;
+    }
+
+    int params[2] = { 0, 0 };
+    int count = 0;
+    size_t i = 2;
+
+    while (i < length && i < KEYSEQ_MAX_LENGTH) {
+        unsigned char ch = data[i];
+        if (ch >= '0' && ch <= '9') {
+            if (count < 2 && params[count] < 10000) params[count] = params[count] * 10 + (ch - '0');
+        } else if (ch == ';') {
+            count++;
+        } else if (ch >= 0x40 && ch <= 0x7E) {
+            break;
+        }
+        // Other parameter bytes ('?', '<', ...) carry nothing we use
+        i++;
+    }
+
+    if (i >= KEYSEQ_MAX_LENGTH) {
+        return i;
+    }
+    if (i >= length) {
+        if (!complete) return 0;
+        event->key = KEY_ESC;
+        return 1;
+    }
+
+    unsigned char final = data[i];
+    event->key = final == '~' ? lookup_number(params[0]) : lookup_final(final);
+    apply_modifiers(event, params[1]);
+    return i + 1;
+}
+
+size_t keyseq_decode(const unsigned char* data, size_t length, int complete, KeyEvent* event) {
+    event->key = 0;
+    event->ctrl = 0;
+    event->alt = 0;
+    event->shift = 0;
+
+    if (length == 0) return 0;
+    // Typed text is nearly all of the input, so it goes first
+    if (data[0] >= 0x20 && data[0] < 0x7F) {
+        event->key = data[0];
+        return 1;
+    }
+    if (data[0] != KEYSEQ_ESC) {
+        decode_byte(data[0], event);
+        return 1;
+    }
+
+    // A bare ESC can only be told from the start of a sequence by waiting
+    if (length < 2) {
+        if (!complete) return 0;
+        event->key = KEY_ESC;
+        return 1;
+    }
+
+    if (data[1] == '[') {
+        return decode_csi(data, length, complete, event);
+    }
+    if (data[1] == 'O') {
+        if (length < 3) {
+            if (!complete) return 0;
+            event->key = KEY_ESC;
+            return 1;
+        }
+        event->key = lookup_final(data[2]);
+        return 3;
+    }
+    if (data[1] == KEYSEQ_ESC) {
+        event->key = KEY_ESC;
+        return 1;
+    }
+
+    // ESC before any other key is how terminals send Alt+key
+    decode_byte(data[1], event);
+    event->alt = 1;
+    return 2;
+}
\ No newline at end of file
@@ -0,0 +1,88 @@
+#include "line_index.h"
+#include <string.h>
+
+#define ENTRY(index, i) ((index)->chunks[(i) >> LINE_INDEX_CHUNK_BITS][(i) & LINE_INDEX_CHUNK_MASK])
+
+void line_index_init(LineIndex* index, Arena* arena) {
+    memset(index, 0, sizeof(LineIndex));
+    index->arena = arena;
+}
+
+void line_index_free(LineIndex* index) {
+    for (size_t i = 0; i < index->chunk_count; i++) {
+        arena_release(index->arena, index->chunks[i], LINE_INDEX_CHUNK_SIZE * sizeof(size_t));
+    }
+    arena_release(index->arena, index->chunks, index->directory_capacity * sizeof(size_t*));
+    line_index_init(index, index->arena);
+}
+
+int line_index_append(LineIndex* index, size_t offset) {
+    if (index->count == index->chunk_count * LINE_INDEX_CHUNK_SIZE) {
+        // Current chunks are full: only the directory of pointers may move
+        if (index->chunk_count == index->directory_capacity) {
+            size_t new_capacity = index->directory_capacity ? index->directory_capacity * 2 : 16;
+            size_t** grown = (size_t**)arena_alloc(index->arena, new_capacity * sizeof(size_t*));
+            if (!grown) return 0;
+            if (index->chunk_count) {
+                memcpy(grown, index->chunks, index->chunk_count * sizeof(size_t*));
+            }
+            arena_release(index->arena, index->chunks, index->directory_capacity * sizeof(size_t*));
+            index->chunks = grown;
+            index->directory_capacity = new_capacity;
+        }
+
+        size_t* chunk = (size_t*)arena_alloc(index->arena, LINE_INDEX_CHUNK_SIZE * sizeof(size_t));
+        if (!chunk) return 0;
+        index->chunks[index->chunk_count++] = chunk;
+    }
+
+    ENTRY(index, index->count) = offset;
+    index->count++;
+    return 1;
+}
+
+int line_index_append_many(LineIndex* index, const size_t* offsets, size_t count) {
+    while (count > 0) {
+        size_t room = index->chunk_count * LINE_INDEX_CHUNK_SIZE - index->count;
+        if (room == 0) {
+            // Let the single append open the next chunk
+            if (!line_index_append(index, *offsets)) return 0;
+            offsets++;
+            count--;
+            continue;
+        }
+
+        size_t n = count < room ? count : room;
+        memcpy(&ENTRY(index, index->count), offsets, n * sizeof(size_t));
+        index->count += n;
+        offsets += n;
+        count -= n;
+    }
+    return 1;
+}
+
+int line_index_append_all(LineIndex* index, const LineIndex* other) {
+    for (size_t i = 0; i < other->chunk_count; i++) {
+        size_t from = i * LINE_INDEX_CHUNK_SIZE;
+        size_t count = other->count - from;
+        if (count > LINE_INDEX_CHUNK_SIZE) count = LINE_INDEX_CHUNK_SIZE;
+        if (!line_index_append_many(index, other->chunks[i], count)) return 0;
+    }
+    return 1;
+}
+
+size_t line_index_get(const LineIndex* index, size_t position) {
+    return ENTRY(index, position);
+}
+
+size_t line_index_lower_bound(const LineIndex* index, size_t lo, size_t hi, size_t target) {
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (ENTRY(index, mid) < target) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
\ No newline at end of file
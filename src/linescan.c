@@ -0,0 +1,162 @@
+#include "linescan.h"
+
+#if defined(__GNUC__) && defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__))
+#define LINESCAN_X86 1
+#include <immintrin.h>
+#endif
+
+// Offsets are collected on the stack and handed to the index in batches
+#define LINESCAN_BATCH 512
+
+typedef struct {
+    const char* data;
+    LineIndex* index;
+    size_t* crlf_count;
+    size_t base;
+    size_t stride;
+    size_t countdown;
+    size_t offsets[LINESCAN_BATCH];
+    size_t pending;
+} LinescanState;
+
+typedef int (*LinescanKernel)(LinescanState* state, size_t from, size_t to);
+
+static int flush(LinescanState* state) {
+    int ok = line_index_append_many(state->index, state->offsets, state->pending);
+    state->pending = 0;
+    return ok;
+}
+
+static int record_newline(LinescanState* state, size_t pos) {
+    if (pos > 0 && state->data[pos - 1] == '\r') (*state->crlf_count)++;
+    if (--state->countdown > 0) return 1;
+
+    state->countdown = state->stride;
+    state->offsets[state->pending++] = state->base + pos;
+    return state->pending < LINESCAN_BATCH || flush(state);
+}
+
+static int scan_scalar(LinescanState* state, size_t from, size_t to) {
+    for (size_t i = from; i < to; i++) {
+        if (state->data[i] == '\n' && !record_newline(state, i)) return 0;
+    }
+    return 1;
+}
+
+#ifdef LINESCAN_X86
+static int scan_sse2(LinescanState* state, size_t from, size_t to) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    size_t i = from;
+
+    for (; i + 16 <= to; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(state->data + i));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(block, newline));
+        while (mask) {
+            if (!record_newline(state, i + __builtin_ctz(mask))) return 0;
+            mask &= mask - 1;
+        }
+    }
+    return scan_scalar(state, i, to);
+}
+
+__attribute__((target("avx2")))
+static int scan_avx2(LinescanState* state, size_t from, size_t to) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    size_t i = from;
+
+    for (; i + 64 <= to; i += 64) {
+        __m256i lo = _mm256_loadu_si256((const __m256i*)(state->data + i));
+        __m256i hi = _mm256_loadu_si256((const __m256i*)(state->data + i + 32));
+        unsigned long long mask =
+            (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, newline)) |
+            ((unsigned long long)(unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, newline)) << 32);
+        while (mask) {
+            if (!record_newline(state, i + __builtin_ctzll(mask))) return 0;
+            mask &= mask - 1;
+        }
+    }
+    return scan_sse2(state, i, to);
+}
+#endif
+
+static LinescanKernel select_kernel(void) {
+#ifdef LINESCAN_X86
+    if (__builtin_cpu_supports("avx2")) return scan_avx2;
+    return scan_sse2;
+#else
+    return scan_scalar;
+#endif
+}
+
+static LinescanKernel kernel = NULL;
+
+// The loader, pager and main threads all scan, so the choice is published
+// atomically; threads racing here store the same kernel
+static LinescanKernel get_kernel(void) {
+    LinescanKernel chosen = __atomic_load_n(&kernel, __ATOMIC_RELAXED);
+    if (!chosen) {
+        chosen = select_kernel();
+        __atomic_store_n(&kernel, chosen, __ATOMIC_RELAXED);
+    }
+    return chosen;
+}
+
+int linescan_build(const char* data, size_t from, size_t to, LineIndex* index, size_t* crlf_count) {
+    LinescanKernel scan = get_kernel();
+
+    LinescanState state;
+    state.data = data;
+    state.index = index;
+    state.crlf_count = crlf_count;
+    state.base = 0;
+    state.stride = 1;
+    state.countdown = 1;
+    state.pending = 0;
+
+    int ok = scan(&state, from, to);
+    return flush(&state) && ok;
+}
+
+int linescan_sample(const char* data, size_t length, size_t base, size_t stride,
+                    size_t* countdown, LineIndex* index) {
+    LinescanKernel scan = get_kernel();
+
+    size_t crlf_count = 0;
+    LinescanState state;
+    state.data = data;
+    state.index = index;
+    state.crlf_count = &crlf_count;
+    state.base = base;
+    state.stride = stride;
+    state.countdown = *countdown;
+    state.pending = 0;
+
+    int ok = scan(&state, 0, length);
+    *countdown = state.countdown;
+    return flush(&state) && ok;
+}
+
+int linescan_use_kernel(int kind) {
+    LinescanKernel chosen;
+    switch (kind) {
+        case LINESCAN_AUTO:
+            chosen = select_kernel();
+            break;
+        case LINESCAN_SCALAR:
+            chosen = scan_scalar;
+            break;
+#ifdef LINESCAN_X86
+        case LINESCAN_SSE2:
+            chosen = scan_sse2;
+            break;
+        case LINESCAN_AVX2:
+            if (!__builtin_cpu_supports("avx2")) return 0;
+            chosen = scan_avx2;
+            break;
+#endif
+        default:
+            return 0;
+    }
+    __atomic_store_n(&kernel, chosen, __ATOMIC_RELAXED);
+    return 1;
+}
\ No newline at end of file
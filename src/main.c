@@ -1,6 +1,9 @@
 #include "editor.h"
+#include "file_ops.h"
 #include "platform.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 int main(int argc, char* argv[]) {
@@ -10,10 +13,28 @@ int main(int argc, char* argv[]) {
     Editor editor;
     editor_init(&editor);
     
+    // -r opens the file read-only in the pager, -m caps its mapped memory in MB,
+    // -e sets how many ms ESC waits for the rest of an escape sequence,
+    // -u caps the undo history in MB
+    const char* filename = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-r") == 0) {
+            editor.force_pager = 1;
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            editor.pager_limit = (size_t)atol(argv[++i]) * 1024 * 1024;
+        } else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+            platform_set_escape_timeout(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "-u") == 0 && i + 1 < argc) {
+            undo_set_limit(&editor.buffer->undo, (size_t)atol(argv[++i]) * 1024 * 1024);
+        } else {
+            filename = argv[i];
+        }
+    }
+    
     // If filename provided as argument
-    if (argc > 1) {
-        if (!file_open(editor.buffer, argv[1])) {
-            printf("Could not open file: %s\n", argv[1]);
+    if (filename) {
+        if (!editor_file_open(&editor, filename)) {
+            printf("Could not open file: %s\n", filename);
             printf("Creating new file instead.\n");
 #ifdef PLATFORM_WINDOWS
             Sleep(1000);
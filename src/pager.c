@@ -0,0 +1,387 @@
+#include "pager.h"
+#include "linescan.h"
+#include <stdlib.h>
+#include <string.h>
+
+static void pager_lock(Pager* pager) {
+#ifdef PLATFORM_UNIX
+    pthread_mutex_lock(&pager->lock);
+#else
+    (void)pager;
+#endif
+}
+
+static void pager_unlock(Pager* pager) {
+#ifdef PLATFORM_UNIX
+    pthread_mutex_unlock(&pager->lock);
+#else
+    (void)pager;
+#endif
+}
+
+// Pointer to the byte at `offset` (which must be < size) and how many bytes
+// follow it in the same window. Windows are mapped on demand and the least
+// recently used one is dropped once the resident limit is reached.
+static const char* pager_span(Pager* pager, size_t offset, size_t* available) {
+    size_t window_offset = offset - offset % PAGER_WINDOW_SIZE;
+    PagerWindow* window = NULL;
+
+    for (int i = 0; i < pager->window_count; i++) {
+        if (pager->windows[i].offset == window_offset) {
+            window = &pager->windows[i];
+            break;
+        }
+    }
+
+    if (!window) {
+        if (pager->window_count < pager->max_windows) {
+            window = &pager->windows[pager->window_count++];
+        } else {
+            window = &pager->windows[0];
+            for (int i = 1; i < pager->window_count; i++) {
+                if (pager->windows[i].last_used < window->last_used) {
+                    window = &pager->windows[i];
+                }
+            }
+            platform_unmap_file(window->data, window->length);
+        }
+
+        window->offset = window_offset;
+        window->length = pager->size - window_offset > PAGER_WINDOW_SIZE ?
+                         PAGER_WINDOW_SIZE : pager->size - window_offset;
+        window->data = platform_map_range(pager->file, window_offset, window->length);
+        if (!window->data) {
+            *window = pager->windows[--pager->window_count];
+            return NULL;
+        }
+    }
+
+    window->last_used = ++pager->clock;
+    *available = window->offset + window->length - offset;
+    return window->data + (offset - window->offset);
+}
+
+// Offset just past the '\n' ending the line that starts at `start`
+static size_t pager_next_line(Pager* pager, size_t start) {
+    size_t offset = start;
+
+    while (offset < pager->size) {
+        size_t available;
+        const char* span = pager_span(pager, offset, &available);
+        if (!span) return pager->size;
+
+        const char* newline = (const char*)memchr(span, '\n', available);
+        if (newline) {
+            return offset + (newline - span) + 1;
+        }
+        offset += available;
+    }
+    return pager->size;
+}
+
+// Start of the line before the one starting at `start`. Given the file
+// size it finds the start of the last line.
+static size_t pager_prev_line(Pager* pager, size_t start) {
+    if (start == 0) return 0;
+
+    // Skip the terminator of the previous line, then look for the one before
+    size_t end = start - 1;
+    while (end > 0) {
+        size_t window_offset = (end - 1) - (end - 1) % PAGER_WINDOW_SIZE;
+        size_t available;
+        const char* span = pager_span(pager, window_offset, &available);
+        if (!span) return 0;
+
+        for (size_t i = end - window_offset; i > 0; i--) {
+            if (span[i - 1] == '\n') {
+                return window_offset + i;
+            }
+        }
+        end = window_offset;
+    }
+    return 0;
+}
+
+static size_t pager_count_newlines(Pager* pager, size_t from, size_t to) {
+    size_t count = 0;
+
+    while (from < to) {
+        size_t available;
+        const char* span = pager_span(pager, from, &available);
+        if (!span) break;
+        if (available > to - from) available = to - from;
+
+        const char* end = span + available;
+        const char* p = span;
+        while ((p = (const char*)memchr(p, '\n', end - p)) != NULL) {
+            count++;
+            p++;
+        }
+        from += available;
+    }
+    return count;
+}
+
+// Runs on the indexing thread. It maps its own windows one at a time so it
+// never touches the viewer's window cache.
+static void* pager_index_worker(void* arg) {
+    Pager* pager = (Pager*)arg;
+    Arena arena;
+    LineIndex sampled;
+    size_t countdown = PAGER_CHECKPOINT_LINES;
+    size_t offset = 0;
+    int last_newline = 0;
+    int failed = 0;
+
+    arena_init(&arena);
+    line_index_init(&sampled, &arena);
+
+    while (offset < pager->size) {
+        pager_lock(pager);
+        int cancel = pager->cancel;
+        pager_unlock(pager);
+        if (cancel) break;
+
+        size_t length = pager->size - offset > PAGER_WINDOW_SIZE ? PAGER_WINDOW_SIZE : pager->size - offset;
+        char* data = platform_map_range(pager->file, offset, length);
+        if (!data) {
+            failed = 1;
+            break;
+        }
+
+        int ok = linescan_sample(data, length, offset, PAGER_CHECKPOINT_LINES, &countdown, &sampled);
+        last_newline = data[length - 1] == '\n';
+        platform_unmap_file(data, length);
+
+        pager_lock(pager);
+        ok = ok && line_index_append_all(&pager->checkpoints, &sampled);
+        pager->indexed = offset + length;
+        pager_unlock(pager);
+
+        line_index_free(&sampled);
+        if (!ok) {
+            failed = 1;
+            break;
+        }
+        offset += length;
+    }
+
+    pager_lock(pager);
+    if (offset >= pager->size && !failed) {
+        size_t newlines = pager->checkpoints.count * PAGER_CHECKPOINT_LINES +
+                          (PAGER_CHECKPOINT_LINES - countdown);
+        pager->line_total = (long long)newlines + (pager->size > 0 && !last_newline);
+    }
+    pager->index_done = 1;
+    pager_unlock(pager);
+
+    arena_free(&arena);
+    return NULL;
+}
+
+Pager* pager_open(const char* filename, size_t resident_limit) {
+    Pager* pager = (Pager*)calloc(1, sizeof(Pager));
+    if (!pager) return NULL;
+
+    if (!platform_open_readonly(filename, &pager->file, &pager->size)) {
+        free(pager);
+        return NULL;
+    }
+
+    pager->max_windows = (int)(resident_limit / PAGER_WINDOW_SIZE);
+    if (pager->max_windows < PAGER_MIN_WINDOWS) pager->max_windows = PAGER_MIN_WINDOWS;
+    pager->windows = (PagerWindow*)calloc(pager->max_windows, sizeof(PagerWindow));
+    if (!pager->windows) {
+        platform_close_file(pager->file);
+        free(pager);
+        return NULL;
+    }
+
+    strncpy(pager->filename, filename, sizeof(pager->filename) - 1);
+    pager->top_line = 0;
+    pager->line_total = -1;
+    arena_init(&pager->arena);
+    line_index_init(&pager->checkpoints, &pager->arena);
+
+#ifdef PLATFORM_UNIX
+    pthread_mutex_init(&pager->lock, NULL);
+    if (pthread_create(&pager->thread, NULL, pager_index_worker, pager) != 0) {
+        pthread_mutex_destroy(&pager->lock);
+        free(pager->windows);
+        platform_close_file(pager->file);
+        free(pager);
+        return NULL;
+    }
+#else
+    // No indexing thread here: sample the whole file up front
+    pager_index_worker(pager);
+#endif
+
+    return pager;
+}
+
+void pager_close(Pager* pager) {
+    if (!pager) return;
+
+#ifdef PLATFORM_UNIX
+    pager_lock(pager);
+    pager->cancel = 1;
+    pager_unlock(pager);
+    pthread_join(pager->thread, NULL);
+    pthread_mutex_destroy(&pager->lock);
+#endif
+
+    for (int i = 0; i < pager->window_count; i++) {
+        platform_unmap_file(pager->windows[i].data, pager->windows[i].length);
+    }
+    free(pager->windows);
+    free(pager->line);
+    arena_free(&pager->arena);
+    platform_close_file(pager->file);
+    free(pager);
+}
+
+// Move the top of the view by up to `lines` lines; returns how many it moved
+int pager_scroll(Pager* pager, int lines) {
+    int moved = 0;
+
+    while (lines > 0) {
+        size_t next = pager_next_line(pager, pager->top);
+        if (next >= pager->size) break;
+        pager->top = next;
+        moved++;
+        lines--;
+    }
+    while (lines < 0 && pager->top > 0) {
+        pager->top = pager_prev_line(pager, pager->top);
+        moved--;
+        lines++;
+    }
+
+    if (pager->top_line >= 0) {
+        pager->top_line += moved;
+    }
+    return moved;
+}
+
+void pager_goto_start(Pager* pager) {
+    pager->top = 0;
+    pager->top_line = 0;
+}
+
+void pager_goto_end(Pager* pager, int rows) {
+    pager->top = pager_prev_line(pager, pager->size);
+    pager->top_line = -1;
+    pager_scroll(pager, -(rows - 1));
+}
+
+// Show `line` (0-based) at the top. The nearest checkpoint is at most
+// PAGER_CHECKPOINT_LINES lines away. Returns 0 if indexing has not
+// reached that line yet.
+int pager_goto_line(Pager* pager, size_t line) {
+    size_t checkpoint = line / PAGER_CHECKPOINT_LINES;
+
+    pager_lock(pager);
+    if (checkpoint > pager->checkpoints.count) {
+        if (!pager->index_done) {
+            pager_unlock(pager);
+            return 0;
+        }
+        checkpoint = pager->checkpoints.count;
+    }
+    size_t start = checkpoint > 0 ? line_index_get(&pager->checkpoints, checkpoint - 1) + 1 : 0;
+    pager_unlock(pager);
+
+    if (start >= pager->size && start > 0) {
+        // The last checkpoint was the file's final newline
+        start = pager_prev_line(pager, pager->size);
+        pager->top = start;
+        pager->top_line = -1;
+        return 1;
+    }
+
+    pager->top = start;
+    pager->top_line = (long long)(checkpoint * PAGER_CHECKPOINT_LINES);
+    pager_scroll(pager, (int)(line - checkpoint * PAGER_CHECKPOINT_LINES));
+    return 1;
+}
+
+// Copy up to max_length bytes of the line starting at *offset, skipping the
+// first `skip`, into a scratch buffer valid until the next call. Advances
+// *offset to the next line; returns NULL past the end of the file.
+const char* pager_read_line(Pager* pager, size_t* offset, size_t skip, size_t max_length, size_t* length) {
+    size_t start = *offset;
+    if (start >= pager->size) return NULL;
+
+    size_t next = pager_next_line(pager, start);
+    size_t end = next;
+    if (end > start) {
+        size_t available;
+        const char* span = pager_span(pager, end - 1, &available);
+        if (span && *span == '\n') {
+            end--;
+            if (end > start && (span = pager_span(pager, end - 1, &available)) && *span == '\r') {
+                end--;
+            }
+        }
+    }
+
+    if (max_length + 1 > pager->line_capacity) {
+        char* grown = (char*)realloc(pager->line, max_length + 1);
+        if (!grown) return NULL;
+        pager->line = grown;
+        pager->line_capacity = max_length + 1;
+    }
+
+    size_t from = start + skip < end ? start + skip : end;
+    size_t to = end - from > max_length ? from + max_length : end;
+    size_t copied = 0;
+    while (from + copied < to) {
+        size_t available;
+        const char* span = pager_span(pager, from + copied, &available);
+        if (!span) break;
+        if (available > to - from - copied) available = to - from - copied;
+        memcpy(pager->line + copied, span, available);
+        copied += available;
+    }
+
+    pager->line[copied] = '\0';
+    *length = copied;
+    *offset = next;
+    return pager->line;
+}
+
+// Line number of the top of the view, or -1 while indexing has not got
+// that far. Resolved from the closest checkpoint and cached.
+long long pager_get_top_line(Pager* pager) {
+    if (pager->top_line >= 0) return pager->top_line;
+
+    pager_lock(pager);
+    if (pager->indexed < pager->top) {
+        pager_unlock(pager);
+        return -1;
+    }
+    size_t checkpoint = line_index_lower_bound(&pager->checkpoints, 0, pager->checkpoints.count, pager->top);
+    size_t base = checkpoint > 0 ? line_index_get(&pager->checkpoints, checkpoint - 1) + 1 : 0;
+    pager_unlock(pager);
+
+    pager->top_line = (long long)(checkpoint * PAGER_CHECKPOINT_LINES) +
+                      (long long)pager_count_newlines(pager, base, pager->top);
+    return pager->top_line;
+}
+
+long long pager_get_line_count(Pager* pager) {
+    pager_lock(pager);
+    long long total = pager->line_total;
+    pager_unlock(pager);
+    return total;
+}
+
+// Percent of the file indexed, or -1 once indexing is over
+int pager_get_index_progress(Pager* pager) {
+    pager_lock(pager);
+    int progress = pager->index_done ? -1 :
+                   (int)(pager->size ? pager->indexed * 100 / pager->size : 100);
+    pager_unlock(pager);
+    return progress;
+}
\ No newline at end of file
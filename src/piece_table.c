@@ -0,0 +1,895 @@
+#include "piece_table.h"
+#include "platform.h"
+#include <stdlib.h>
+#include <string.h>
+
+static unsigned int next_priority(PieceTable* table) {
+    // xorshift32 - treap priorities only need to be well spread
+    unsigned int x = table->seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    table->seed = x;
+    return x;
+}
+
+static void piece_buffer_init(PieceBuffer* buf, Arena* arena) {
+    memset(buf, 0, sizeof(PieceBuffer));
+    line_index_init(&buf->newlines, arena);
+}
+
+static int piece_buffer_scan(PieceBuffer* buf, size_t from) {
+    return linescan_build(buf->data, from, buf->length, &buf->newlines, &buf->crlf_count);
+}
+
+// Make room for length more bytes past the end of the text
+static int piece_buffer_reserve(PieceBuffer* buf, size_t length) {
+    if (buf->length + length > buf->capacity) {
+        size_t new_capacity = buf->capacity ? buf->capacity : 4096;
+        while (new_capacity < buf->length + length) {
+            new_capacity *= 2;
+        }
+        char* grown = (char*)realloc(buf->data, new_capacity);
+        if (!grown) return 0;
+        buf->data = grown;
+        buf->capacity = new_capacity;
+    }
+    return 1;
+}
+
+static int piece_buffer_append(PieceBuffer* buf, const char* text, size_t length) {
+    if (!piece_buffer_reserve(buf, length)) return 0;
+
+    size_t from = buf->length;
+    memcpy(buf->data + from, text, length);
+    buf->length += length;
+    return piece_buffer_scan(buf, from);
+}
+
+static void node_update(PieceNode* node) {
+    node->subtree_length = node->length;
+    node->subtree_newlines = node->newline_count;
+    if (node->left) {
+        node->subtree_length += node->left->subtree_length;
+        node->subtree_newlines += node->left->subtree_newlines;
+    }
+    if (node->right) {
+        node->subtree_length += node->right->subtree_length;
+        node->subtree_newlines += node->right->subtree_newlines;
+    }
+}
+
+// Move a subtree's totals into or out of an ancestor's. Split and merge
+// use these instead of node_update so they never read the child off
+// their path, which is rarely in cache.
+static void node_add(PieceNode* node, const PieceNode* subtree) {
+    if (!subtree) return;
+    node->subtree_length += subtree->subtree_length;
+    node->subtree_newlines += subtree->subtree_newlines;
+}
+
+static void node_remove(PieceNode* node, const PieceNode* subtree) {
+    if (!subtree) return;
+    node->subtree_length -= subtree->subtree_length;
+    node->subtree_newlines -= subtree->subtree_newlines;
+}
+
+static PieceNode* node_create(PieceTable* table, int buffer, size_t start, size_t length,
+                              size_t first_newline, size_t newline_count) {
+    PieceNode* node = (PieceNode*)arena_alloc(&table->arena, sizeof(PieceNode));
+    if (!node) return NULL;
+
+    node->left = NULL;
+    node->right = NULL;
+    node->priority = next_priority(table);
+    node->buffer = buffer;
+    node->start = start;
+    node->length = length;
+    node->first_newline = first_newline;
+    node->newline_count = newline_count;
+    node_update(node);
+    return node;
+}
+
+static void node_release(PieceTable* table, PieceNode* node) {
+    if (!node) return;
+    node_release(table, node->left);
+    node_release(table, node->right);
+    arena_release(&table->arena, node, sizeof(PieceNode));
+}
+
+static PieceNode* first_node(PieceNode* node) {
+    while (node && node->left) {
+        node = node->left;
+    }
+    return node;
+}
+
+static PieceNode* last_node(PieceNode* node) {
+    while (node && node->right) {
+        node = node->right;
+    }
+    return node;
+}
+
+// Unlink the first piece of a tree and return what is left; the caller
+// still holds the piece
+static PieceNode* drop_first(PieceNode* node) {
+    if (!node->left) return node->right;
+    node->left = drop_first(node->left);
+    node_update(node);
+    return node;
+}
+
+static PieceNode* merge(PieceNode* left, PieceNode* right) {
+    if (!left) return right;
+    if (!right) return left;
+
+    if (left->priority > right->priority) {
+        node_add(left, right);
+        left->right = merge(left->right, right);
+        return left;
+    }
+    node_add(right, left);
+    right->left = merge(left, right->left);
+    return right;
+}
+
+// Split the tree so that *out_left holds exactly the first `offset` bytes.
+// A piece straddling the offset is cut in two; returns 0 on allocation failure.
+static int split(PieceTable* table, PieceNode* node, size_t offset,
+                 PieceNode** out_left, PieceNode** out_right) {
+    if (!node) {
+        *out_left = NULL;
+        *out_right = NULL;
+        return 1;
+    }
+
+    size_t left_length = node->left ? node->left->subtree_length : 0;
+
+    if (offset <= left_length) {
+        int ok = split(table, node->left, offset, out_left, &node->left);
+        node_remove(node, *out_left);
+        *out_right = node;
+        return ok;
+    }
+
+    if (offset >= left_length + node->length) {
+        int ok = split(table, node->right, offset - left_length - node->length,
+                       &node->right, out_right);
+        node_remove(node, *out_right);
+        *out_left = node;
+        return ok;
+    }
+
+    // Cut this piece: the head stays in place, the tail joins the right side
+    const PieceBuffer* buf = &table->buffers[node->buffer];
+    size_t cut = offset - left_length;
+    size_t split_newline = line_index_lower_bound(&buf->newlines, node->first_newline,
+                                                  node->first_newline + node->newline_count,
+                                                  node->start + cut);
+    size_t head_newlines = split_newline - node->first_newline;
+
+    PieceNode* tail = node_create(table, node->buffer, node->start + cut, node->length - cut,
+                                  split_newline, node->newline_count - head_newlines);
+    if (!tail) {
+        *out_left = node->left;
+        *out_right = node;
+        node->left = NULL;
+        node_update(node);
+        return 0;
+    }
+
+    PieceNode* right = node->right;
+    node->right = NULL;
+    node->length = cut;
+    node->newline_count = head_newlines;
+    node_update(node);
+
+    *out_left = node;
+    *out_right = merge(tail, right);
+    return 1;
+}
+
+// Grow the piece ending at `offset` when it also ends where the new text
+// starts in its buffer, so a run of typed characters stays one piece
+static int extend_piece(PieceTable* table, PieceNode* node, size_t offset, int buffer,
+                        size_t buffer_end, size_t length, size_t newlines) {
+    if (!node) return 0;
+
+    size_t left_length = node->left ? node->left->subtree_length : 0;
+    int extended = 0;
+
+    if (offset <= left_length) {
+        extended = extend_piece(table, node->left, offset, buffer, buffer_end, length, newlines);
+    } else if (offset == left_length + node->length) {
+        if (node->buffer == buffer && node->start + node->length == buffer_end) {
+            node->length += length;
+            node->newline_count += newlines;
+            extended = 1;
+        }
+    } else if (offset > left_length + node->length) {
+        extended = extend_piece(table, node->right, offset - left_length - node->length,
+                                buffer, buffer_end, length, newlines);
+    }
+
+    if (extended) {
+        node_update(node);
+    }
+    return extended;
+}
+
+static void read_node(const PieceTable* table, const PieceNode* node, size_t base,
+                      size_t from, size_t to, char* out) {
+    if (!node || base >= to) return;
+
+    size_t piece_start = base + (node->left ? node->left->subtree_length : 0);
+    size_t piece_end = piece_start + node->length;
+
+    if (from < piece_start) {
+        read_node(table, node->left, base, from, to, out);
+    }
+
+    if (from < piece_end && to > piece_start) {
+        size_t copy_from = from > piece_start ? from : piece_start;
+        size_t copy_to = to < piece_end ? to : piece_end;
+        const char* src = table->buffers[node->buffer].data + node->start + (copy_from - piece_start);
+        memcpy(out + (copy_from - from), src, copy_to - copy_from);
+    }
+
+    if (to > piece_end) {
+        read_node(table, node->right, piece_end, from, to, out);
+    }
+}
+
+// Visit the text at document offsets >= from; base is where node's subtree starts
+static int visit_node(const PieceTable* table, const PieceNode* node, size_t base, size_t from,
+                      PieceVisitor visit, void* context) {
+    if (!node) return 1;
+
+    size_t piece_start = base + (node->left ? node->left->subtree_length : 0);
+    size_t piece_end = piece_start + node->length;
+
+    if (from < piece_start && !visit_node(table, node->left, base, from, visit, context)) {
+        return 0;
+    }
+    if (from < piece_end) {
+        size_t skip = from > piece_start ? from - piece_start : 0;
+        if (!visit(context, table->buffers[node->buffer].data + node->start + skip, node->length - skip)) {
+            return 0;
+        }
+    }
+    return visit_node(table, node->right, piece_end, from, visit, context);
+}
+
+void piece_table_init(PieceTable* table) {
+    table->root = NULL;
+    table->seed = 0x9E3779B9u;
+    arena_init(&table->arena);
+    piece_buffer_init(&table->buffers[PIECE_ORIGINAL], &table->arena);
+    piece_buffer_init(&table->buffers[PIECE_ADD], &table->arena);
+}
+
+void piece_table_free(PieceTable* table) {
+    PieceBuffer* original = &table->buffers[PIECE_ORIGINAL];
+    if (original->mapped) {
+        platform_unmap_file(original->data, original->capacity);
+    } else {
+        free(original->data);
+    }
+    free(table->buffers[PIECE_ADD].data);
+    arena_free(&table->arena);
+    piece_table_init(table);
+}
+
+int piece_table_load(PieceTable* table, char* data, size_t size, size_t length, int mapped) {
+    piece_table_free(table);
+
+    // Takes ownership of the first `size` bytes of data; only `length` of
+    // them are document text
+    PieceBuffer* original = &table->buffers[PIECE_ORIGINAL];
+    original->data = data;
+    original->length = length;
+    original->capacity = size;
+    original->mapped = mapped;
+    if (!piece_buffer_scan(original, 0)) return 0;
+
+    if (length > 0) {
+        table->root = node_create(table, PIECE_ORIGINAL, 0, length, 0, original->newlines.count);
+        if (!table->root) return 0;
+    }
+    return 1;
+}
+
+int piece_table_extend_original(PieceTable* table, size_t end) {
+    PieceBuffer* original = &table->buffers[PIECE_ORIGINAL];
+    size_t start = original->length;
+    if (end <= start) return 1;
+    if (end > original->capacity) return 0;
+
+    // The newline offsets for [start, end) must already be in the index
+    size_t first_newline = line_index_lower_bound(&original->newlines, 0,
+                                                  original->newlines.count, start);
+    size_t newlines = line_index_lower_bound(&original->newlines, first_newline,
+                                             original->newlines.count, end) - first_newline;
+    original->length = end;
+
+    size_t document_end = piece_table_length(table);
+    if (extend_piece(table, table->root, document_end, PIECE_ORIGINAL, start, end - start, newlines)) {
+        return 1;
+    }
+
+    PieceNode* node = node_create(table, PIECE_ORIGINAL, start, end - start, first_newline, newlines);
+    if (!node) return 0;
+
+    table->root = merge(table->root, node);
+    return 1;
+}
+
+int piece_table_detach(PieceTable* table) {
+    PieceBuffer* original = &table->buffers[PIECE_ORIGINAL];
+    if (!original->mapped) return 1;
+
+    // Copy the mapped text into private memory so the file can be rewritten
+    char* copy = (char*)malloc(original->length > 0 ? original->length : 1);
+    if (!copy) return 0;
+    memcpy(copy, original->data, original->length);
+
+    platform_unmap_file(original->data, original->capacity);
+    original->data = copy;
+    original->capacity = original->length;
+    original->mapped = 0;
+    return 1;
+}
+
+size_t piece_table_length(const PieceTable* table) {
+    return table->root ? table->root->subtree_length : 0;
+}
+
+size_t piece_table_line_count(const PieceTable* table) {
+    return (table->root ? table->root->subtree_newlines : 0) + 1;
+}
+
+size_t piece_table_line_start(const PieceTable* table, size_t line) {
+    if (line == 0 || !table->root) return 0;
+    if (line > table->root->subtree_newlines) return piece_table_length(table);
+
+    // Descend by cached newline counts to the piece holding newline #line
+    const PieceNode* node = table->root;
+    size_t base = 0;
+    size_t remaining = line;
+
+    while (node) {
+        size_t left_newlines = node->left ? node->left->subtree_newlines : 0;
+        size_t left_length = node->left ? node->left->subtree_length : 0;
+
+        if (remaining <= left_newlines) {
+            node = node->left;
+            continue;
+        }
+
+        remaining -= left_newlines;
+        if (remaining <= node->newline_count) {
+            const PieceBuffer* buf = &table->buffers[node->buffer];
+            size_t newline = line_index_get(&buf->newlines, node->first_newline + remaining - 1);
+            return base + left_length + (newline - node->start) + 1;
+        }
+
+        remaining -= node->newline_count;
+        base += left_length + node->length;
+        node = node->right;
+    }
+
+    return piece_table_length(table);
+}
+
+// Line holding the byte at offset: the number of newlines before it
+size_t piece_table_line_at(const PieceTable* table, size_t offset) {
+    const PieceNode* node = table->root;
+    size_t line = 0;
+
+    while (node) {
+        size_t left_length = node->left ? node->left->subtree_length : 0;
+        size_t left_newlines = node->left ? node->left->subtree_newlines : 0;
+
+        if (offset < left_length) {
+            node = node->left;
+            continue;
+        }
+
+        line += left_newlines;
+        offset -= left_length;
+        if (offset < node->length) {
+            const PieceBuffer* buf = &table->buffers[node->buffer];
+            return line + line_index_lower_bound(&buf->newlines, node->first_newline,
+                                                 node->first_newline + node->newline_count,
+                                                 node->start + offset) - node->first_newline;
+        }
+
+        line += node->newline_count;
+        offset -= node->length;
+        node = node->right;
+    }
+    return line;
+}
+
+size_t piece_table_line_end(const PieceTable* table, size_t line) {
+    if (line + 1 < piece_table_line_count(table)) {
+        return piece_table_line_start(table, line + 1) - 1;
+    }
+    return piece_table_length(table);
+}
+
+size_t piece_table_read(const PieceTable* table, size_t offset, size_t length, char* out) {
+    size_t total = piece_table_length(table);
+    if (offset >= total) return 0;
+    if (length > total - offset) length = total - offset;
+
+    read_node(table, table->root, 0, offset, offset + length, out);
+    return length;
+}
+
+// Each window is [offset - radius, offset + radius). The tree is walked in
+// order once for all of them, skipping subtrees no window reaches; *next
+// is the first window that does not end before base.
+static void read_node_around(const PieceTable* table, const PieceNode* node, size_t base,
+                             const size_t* offsets, size_t count, size_t radius, char* out, size_t* next) {
+    if (!node) return;
+
+    while (*next < count && offsets[*next] + radius <= base) (*next)++;
+    if (*next == count || offsets[*next] >= base + node->subtree_length + radius) return;
+
+    size_t piece_start = base + (node->left ? node->left->subtree_length : 0);
+    size_t piece_end = piece_start + node->length;
+    read_node_around(table, node->left, base, offsets, count, radius, out, next);
+
+    while (*next < count && offsets[*next] + radius <= piece_start) (*next)++;
+    const char* data = table->buffers[node->buffer].data + node->start;
+    for (size_t i = *next; i < count && offsets[i] < piece_end + radius; i++) {
+        size_t from = offsets[i] >= piece_start + radius ? offsets[i] - radius : piece_start;
+        size_t to = offsets[i] + radius < piece_end ? offsets[i] + radius : piece_end;
+        memcpy(out + i * 2 * radius + (from + radius - offsets[i]), data + (from - piece_start), to - from);
+    }
+
+    read_node_around(table, node->right, piece_end, offsets, count, radius, out, next);
+}
+
+// Copy the 2 * radius bytes around each of count sorted offsets to out,
+// one window after another. Bytes outside the document read as 0.
+void piece_table_read_around(const PieceTable* table, const size_t* offsets, size_t count, size_t radius,
+                             char* out) {
+    size_t next = 0;
+    memset(out, 0, count * 2 * radius);
+    read_node_around(table, table->root, 0, offsets, count, radius, out, &next);
+}
+
+int piece_table_for_each(const PieceTable* table, PieceVisitor visit, void* context) {
+    return visit_node(table, table->root, 0, 0, visit, context);
+}
+
+int piece_table_for_each_from(const PieceTable* table, size_t from, PieceVisitor visit, void* context) {
+    return visit_node(table, table->root, 0, from, visit, context);
+}
+
+// Link buffer text [start, start + length) into the document at offset
+static int insert_piece(PieceTable* table, size_t offset, int buffer, size_t start, size_t length,
+                        size_t first_newline, size_t newlines) {
+    if (extend_piece(table, table->root, offset, buffer, start, length, newlines)) {
+        return 1;
+    }
+
+    PieceNode* node = node_create(table, buffer, start, length, first_newline, newlines);
+    if (!node) return 0;
+
+    PieceNode* left;
+    PieceNode* right;
+    if (!split(table, table->root, offset, &left, &right)) {
+        table->root = merge(left, right);
+        arena_release(&table->arena, node, sizeof(PieceNode));
+        return 0;
+    }
+
+    table->root = merge(merge(left, node), right);
+    return 1;
+}
+
+int piece_table_insert(PieceTable* table, size_t offset, const char* text, size_t length) {
+    if (offset > piece_table_length(table)) return 0;
+    if (length == 0) return 1;
+
+    PieceBuffer* add = &table->buffers[PIECE_ADD];
+    size_t start = add->length;
+    size_t first_newline = add->newlines.count;
+
+    if (!piece_buffer_append(add, text, length)) return 0;
+    return insert_piece(table, offset, PIECE_ADD, start, length, first_newline,
+                        add->newlines.count - first_newline);
+}
+
+// Insert text that is already in one of the buffers, such as an earlier
+// insert being redone. Nothing is copied.
+int piece_table_insert_span(PieceTable* table, size_t offset, int buffer, size_t start, size_t length) {
+    const PieceBuffer* buf = &table->buffers[buffer];
+    if (offset > piece_table_length(table) || start + length > buf->length) return 0;
+    if (length == 0) return 1;
+
+    size_t first_newline = line_index_lower_bound(&buf->newlines, 0, buf->newlines.count, start);
+    size_t end_newline = line_index_lower_bound(&buf->newlines, first_newline, buf->newlines.count, start + length);
+    return insert_piece(table, offset, buffer, start, length, first_newline, end_newline - first_newline);
+}
+
+int piece_table_delete(PieceTable* table, size_t offset, size_t length) {
+    size_t total = piece_table_length(table);
+    if (offset > total) return 0;
+    if (length > total - offset) length = total - offset;
+    if (length == 0) return 1;
+
+    PieceNode* left;
+    PieceNode* middle;
+    PieceNode* right;
+
+    if (!split(table, table->root, offset, &left, &right)) {
+        table->root = merge(left, right);
+        return 0;
+    }
+    if (!split(table, right, length, &middle, &right)) {
+        table->root = merge(merge(left, middle), right);
+        return 0;
+    }
+
+    node_release(table, middle);
+    table->root = merge(left, right);
+    return 1;
+}
+
+typedef struct {
+    PieceSpan* spans;
+    size_t count;
+    size_t capacity;
+} SpanList;
+
+static int span_push(SpanList* list, int buffer, size_t start, size_t length) {
+    if (length == 0) return 1;
+
+    // Text that continues the previous span in its buffer joins it
+    if (list->count > 0) {
+        PieceSpan* last = &list->spans[list->count - 1];
+        if (last->buffer == buffer && last->start + last->length == start) {
+            last->length += length;
+            return 1;
+        }
+    }
+
+    if (list->count == list->capacity) {
+        size_t new_capacity = list->capacity ? list->capacity * 2 : 64;
+        PieceSpan* grown = (PieceSpan*)realloc(list->spans, new_capacity * sizeof(PieceSpan));
+        if (!grown) return 0;
+        list->spans = grown;
+        list->capacity = new_capacity;
+    }
+    list->spans[list->count].buffer = buffer;
+    list->spans[list->count].start = start;
+    list->spans[list->count].length = length;
+    list->count++;
+    return 1;
+}
+
+static int collect_node(const PieceNode* node, SpanList* list) {
+    if (!node) return 1;
+    return collect_node(node->left, list) &&
+           span_push(list, node->buffer, node->start, node->length) &&
+           collect_node(node->right, list);
+}
+
+// The document's pieces in order, in a malloc'd array
+int piece_table_get_spans(const PieceTable* table, PieceSpan** spans, size_t* count) {
+    SpanList list = { NULL, 0, 0 };
+    if (!collect_node(table->root, &list)) {
+        free(list.spans);
+        return 0;
+    }
+    *spans = list.spans;
+    *count = list.count;
+    return 1;
+}
+
+// First newline at or after target among those from `from` on; cheap when
+// the answer is close to `from`
+static size_t lower_bound_near(const LineIndex* index, size_t from, size_t target) {
+    size_t low = from;
+    size_t high = from;
+    size_t step = 1;
+
+    while (high < index->count && line_index_get(index, high) < target) {
+        low = high + 1;
+        high += step;
+        step *= 2;
+    }
+    if (high > index->count) high = index->count;
+    return line_index_lower_bound(index, low, high, target);
+}
+
+// Replace the whole tree with one built from spans, such as a version
+// saved by piece_table_get_spans. The treap is built in a single left to
+// right pass: a stack holds its right spine, and each new node takes the
+// lower priority part of the spine as its left subtree.
+int piece_table_rebuild(PieceTable* table, const PieceSpan* spans, size_t count) {
+    PieceNode** nodes = (PieceNode**)malloc((count > 0 ? count : 1) * sizeof(PieceNode*));
+    if (!nodes) return 0;
+
+    // Spans of one buffer mostly come in rising order, so each newline
+    // lookup starts from where the last one in that buffer ended up
+    size_t last_start[2] = { 0, 0 };
+    size_t last_newline[2] = { 0, 0 };
+    for (size_t i = 0; i < count; i++) {
+        int buffer = spans[i].buffer;
+        const LineIndex* newlines = &table->buffers[buffer].newlines;
+        size_t from = spans[i].start >= last_start[buffer] ? last_newline[buffer] : 0;
+        size_t first_newline = lower_bound_near(newlines, from, spans[i].start);
+        size_t end_newline = lower_bound_near(newlines, first_newline, spans[i].start + spans[i].length);
+        last_start[buffer] = spans[i].start;
+        last_newline[buffer] = first_newline;
+
+        nodes[i] = node_create(table, spans[i].buffer, spans[i].start, spans[i].length,
+                               first_newline, end_newline - first_newline);
+        if (!nodes[i]) {
+            while (i > 0) {
+                arena_release(&table->arena, nodes[--i], sizeof(PieceNode));
+            }
+            free(nodes);
+            return 0;
+        }
+    }
+
+    // nodes[] is reused as the stack; it never holds more than were read
+    size_t depth = 0;
+    for (size_t i = 0; i < count; i++) {
+        PieceNode* node = nodes[i];
+        PieceNode* below = NULL;
+        while (depth > 0 && nodes[depth - 1]->priority < node->priority) {
+            below = nodes[--depth];
+            node_update(below);
+        }
+        node->left = below;
+        if (depth > 0) {
+            nodes[depth - 1]->right = node;
+        }
+        nodes[depth++] = node;
+    }
+    while (depth > 0) {
+        node_update(nodes[--depth]);
+    }
+
+    node_release(table, table->root);
+    table->root = count > 0 ? nodes[0] : NULL;
+    free(nodes);
+    return 1;
+}
+
+// Copy the spans covering document text [from, to) into list. The cursor
+// (*index, *base) only moves forward, so a whole replace walks the old
+// pieces once.
+static int copy_spans(const PieceSpan* spans, size_t count, size_t* index, size_t* base,
+                      size_t from, size_t to, SpanList* list) {
+    while (from < to && *index < count) {
+        const PieceSpan* span = &spans[*index];
+        if (*base + span->length <= from) {
+            *base += span->length;
+            (*index)++;
+            continue;
+        }
+
+        size_t end = *base + span->length < to ? *base + span->length : to;
+        if (!span_push(list, span->buffer, span->start + (from - *base), end - from)) return 0;
+        from = end;
+    }
+    return 1;
+}
+
+// Replace every range [ranges[2i], ranges[2i + 1]) with text in one pass.
+// Ranges must be sorted and must not overlap. The text is added to the
+// add buffer once and every replacement links to that copy; whatever lies
+// between the ranges keeps pointing at the old text.
+int piece_table_replace(PieceTable* table, const size_t* ranges, size_t count, const char* text, size_t length) {
+    size_t total = piece_table_length(table);
+    for (size_t i = 0; i < count; i++) {
+        if (ranges[2 * i] > ranges[2 * i + 1] || ranges[2 * i + 1] > total) return 0;
+        if (i > 0 && ranges[2 * i] < ranges[2 * i - 1]) return 0;
+    }
+    if (count == 0) return 1;
+
+    PieceBuffer* add = &table->buffers[PIECE_ADD];
+    size_t source = add->length;
+    if (length > 0 && !piece_buffer_append(add, text, length)) return 0;
+
+    PieceSpan* old;
+    size_t old_count;
+    if (!piece_table_get_spans(table, &old, &old_count)) return 0;
+
+    SpanList list = { NULL, 0, 0 };
+    size_t index = 0;
+    size_t base = 0;
+    size_t from = 0;
+    int ok = 1;
+    for (size_t i = 0; ok && i < count; i++) {
+        ok = copy_spans(old, old_count, &index, &base, from, ranges[2 * i], &list) &&
+             span_push(&list, PIECE_ADD, source, length);
+        from = ranges[2 * i + 1];
+    }
+    ok = ok && copy_spans(old, old_count, &index, &base, from, total, &list) &&
+         piece_table_rebuild(table, list.spans, list.count);
+
+    free(list.spans);
+    free(old);
+    return ok;
+}
+
+// Add text to the add buffer without putting it in the document, for a
+// later piece_table_splice; *source is where it starts
+int piece_table_append(PieceTable* table, const char* text, size_t length, size_t* source) {
+    PieceBuffer* add = &table->buffers[PIECE_ADD];
+    *source = add->length;
+    return length == 0 || piece_buffer_append(add, text, length);
+}
+
+// Make sorted, non-overlapping edits in one pass from left to right: the
+// text before each edit is split off the front of the rest of the tree
+// and joined to the end of the result. The tree between edits is kept as
+// it is and each split and join only walks one edge of it, so a batch
+// costs about a tree walk per edit, however many pieces there are.
+//
+// When inverse is not NULL it receives the edits that undo these ones.
+// The text each edit removes is copied to removed, one after another,
+// and their sources are offsets there rather than in the add buffer.
+//
+// Short pieces next to an edit are copied to the end of the add buffer
+// with its new text as one piece. Typing at many cursors would otherwise
+// leave a few pieces per cursor per key, and every later walk of the
+// tree would pay for them.
+int piece_table_splice(PieceTable* table, const PieceEdit* edits, size_t count, PieceEdit* inverse,
+                       char* removed) {
+    size_t total = piece_table_length(table);
+    PieceBuffer* add = &table->buffers[PIECE_ADD];
+    size_t add_length = add->length;
+    for (size_t i = 0; i < count; i++) {
+        if (edits[i].start > edits[i].end || edits[i].end > total) return 0;
+        if (i > 0 && edits[i].start < edits[i - 1].end) return 0;
+        if (edits[i].source > add_length || edits[i].length > add_length - edits[i].source) return 0;
+    }
+
+    // Joined text goes past the end of the add buffer and is indexed once
+    // all of it is there, so its newlines come after every indexed one
+    const LineIndex* newlines = &add->newlines;
+    size_t indexed = newlines->count;
+    int joining = piece_buffer_reserve(add, count * PIECE_JOIN_MAX);
+    size_t joined_length = 0;
+    size_t joined_newlines = 0;
+    size_t first_newline = 0;
+    size_t end_newline = 0;
+
+    PieceNode* done = NULL;
+    PieceNode* rest = table->root;
+    size_t consumed = 0;
+    size_t grown = 0;
+    size_t removed_length = 0;
+    int ok = 1;
+
+    for (size_t i = 0; ok && i < count; i++) {
+        const PieceEdit* edit = &edits[i];
+        size_t length = edit->end - edit->start;
+        PieceNode* head;
+        PieceNode* cut = NULL;
+        ok = split(table, rest, edit->start - consumed, &head, &rest);
+        done = merge(done, head);
+        if (!ok) break;
+        if (length > 0) {
+            ok = split(table, rest, length, &cut, &rest);
+        }
+        consumed = edit->end;
+
+        if (!ok) {
+            rest = merge(cut, rest);
+            break;
+        }
+
+        // The removed text is read out of its pieces before they go
+        if (inverse) {
+            read_node(table, cut, 0, 0, length, removed + removed_length);
+            inverse[i].start = edit->start + grown;
+            inverse[i].end = inverse[i].start + edit->length;
+            inverse[i].source = removed_length;
+            inverse[i].length = length;
+            removed_length += length;
+        }
+        node_release(table, cut);
+        grown += edit->length - length;
+
+        // Short pieces on either side are copied in with the new text as
+        // one piece, unless the next edit starts inside the one after
+        PieceNode* last = joining ? last_node(done) : NULL;
+        PieceNode* next = joining ? first_node(rest) : NULL;
+        size_t joined = edit->length;
+        if (last && last->length + joined <= PIECE_JOIN_MAX) {
+            joined += last->length;
+        } else {
+            last = NULL;
+        }
+        if (next && next->length + joined <= PIECE_JOIN_MAX &&
+            (i + 1 == count || edits[i + 1].start >= consumed + next->length)) {
+            joined += next->length;
+        } else {
+            next = NULL;
+        }
+        if ((edit->length > 0) + (last != NULL) + (next != NULL) < 2) {
+            last = NULL;
+            next = NULL;
+        }
+        if (edit->length == 0 && !last) continue;
+
+        // Edits typing the same key share its text, so its newlines are
+        // looked up once
+        size_t newline_count = 0;
+        if (edit->length > 0) {
+            if (i == 0 || edit->source != edits[i - 1].source || edit->length != edits[i - 1].length) {
+                first_newline = line_index_lower_bound(newlines, 0, indexed, edit->source);
+                end_newline = line_index_lower_bound(newlines, first_newline, indexed,
+                                                     edit->source + edit->length);
+            }
+            newline_count = end_newline - first_newline;
+        }
+        if (!last && !next) {
+            PieceNode* node = node_create(table, PIECE_ADD, edit->source, edit->length, first_newline,
+                                          newline_count);
+            ok = node != NULL;
+            done = merge(done, node);
+            continue;
+        }
+
+        char* text = add->data + add->length + joined_length;
+        if (last) {
+            memcpy(text, table->buffers[last->buffer].data + last->start, last->length);
+            text += last->length;
+            newline_count += last->newline_count;
+        }
+        memcpy(text, add->data + edit->source, edit->length);
+        if (next) {
+            memcpy(text + edit->length, table->buffers[next->buffer].data + next->start, next->length);
+            newline_count += next->newline_count;
+        }
+
+        if (last) {
+            // The last piece takes the joined text where it is, and the
+            // totals on the right edge above it grow to match
+            for (PieceNode* edge = done; edge; edge = edge->right) {
+                edge->subtree_length += joined - last->length;
+                edge->subtree_newlines += newline_count - last->newline_count;
+            }
+            last->buffer = PIECE_ADD;
+            last->start = add->length + joined_length;
+            last->length = joined;
+            last->first_newline = indexed + joined_newlines;
+            last->newline_count = newline_count;
+        } else {
+            PieceNode* node = node_create(table, PIECE_ADD, add->length + joined_length, joined,
+                                          indexed + joined_newlines, newline_count);
+            ok = node != NULL;
+            if (!ok) break;
+            done = merge(done, node);
+        }
+        if (next) {
+            rest = drop_first(rest);
+            consumed += next->length;
+            arena_release(&table->arena, next, sizeof(PieceNode));
+        }
+        joined_length += joined;
+        joined_newlines += newline_count;
+    }
+
+    table->root = merge(done, rest);
+    if (joined_length > 0) {
+        size_t from = add->length;
+        add->length += joined_length;
+        ok = piece_buffer_scan(add, from) && ok;
+    }
+    return ok;
+}
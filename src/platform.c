@@ -1,13 +1,240 @@
+// mkstemp, fchmod and realpath are POSIX, not C99
+#define _XOPEN_SOURCE 700
+
 #include "platform.h"
+#include "keyseq.h"
+#include <stdarg.h>
 
 #ifdef PLATFORM_UNIX
 #include <termios.h>
 #include <sys/ioctl.h>
 #include <sys/select.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <errno.h>
 #include <unistd.h>
 
+// Spans per writev call, below every system's IOV_MAX
+#define PLATFORM_WRITE_BATCH 256
+
+// Bytes taken from the terminal per read; a paste arrives in a few reads
+#define PLATFORM_INPUT_BUFFER 4096
+
 static struct termios original_termios;
 static int raw_mode_enabled = 0;
+
+// SIGWINCH is turned into a byte on this pipe so it can be polled
+static int resize_pipe[2] = { -1, -1 };
+
+// Bytes read from the terminal but not yet decoded into keys
+static unsigned char input_data[PLATFORM_INPUT_BUFFER];
+static size_t input_length = 0;
+
+// Text of the last paste, between the bracketed paste markers
+static char* paste_data = NULL;
+static size_t paste_length = 0;
+static size_t paste_capacity = 0;
+
+// How long a lone ESC waits for the rest of an escape sequence; see
+// platform_set_escape_timeout
+static int escape_timeout_ms = PLATFORM_ESC_TIMEOUT_MS;
+
+// A paste whose end marker never arrives is taken as over after this long
+#define PLATFORM_PASTE_TIMEOUT_MS 1000
+#endif
+
+// Output of the frame being drawn, sent with a single write at the end
+static char* frame_data = NULL;
+static size_t frame_length = 0;
+static size_t frame_capacity = 0;
+static int frame_open = 0;
+
+static void platform_flush_frame() {
+    if (frame_length == 0) return;
+    
+#ifdef PLATFORM_WINDOWS
+    fwrite(frame_data, 1, frame_length, stdout);
+    fflush(stdout);
+#else
+    // Anything printed through stdio before the frame goes out first
+    fflush(stdout);
+    
+    const char* data = frame_data;
+    size_t remaining = frame_length;
+    while (remaining > 0) {
+        ssize_t written = write(STDOUT_FILENO, data, remaining);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        data += written;
+        remaining -= written;
+    }
+#endif
+    frame_length = 0;
+}
+
+// Text and escape sequences are collected while a frame is open and
+// written straight away otherwise
+void platform_write(const char* data, size_t length) {
+    if (!frame_open) {
+        fwrite(data, 1, length, stdout);
+        fflush(stdout);
+        return;
+    }
+    
+    if (frame_length + length > frame_capacity) {
+        size_t new_capacity = frame_capacity ? frame_capacity : 16384;
+        while (new_capacity < frame_length + length) {
+            new_capacity *= 2;
+        }
+        char* grown = (char*)realloc(frame_data, new_capacity);
+        if (!grown) {
+            // Out of memory: keep going unbuffered
+            platform_flush_frame();
+            fwrite(data, 1, length, stdout);
+            fflush(stdout);
+            return;
+        }
+        frame_data = grown;
+        frame_capacity = new_capacity;
+    }
+    
+    memcpy(frame_data + frame_length, data, length);
+    frame_length += length;
+}
+
+static void platform_writef(const char* format, ...) {
+    char sequence[64];
+    va_list args;
+    
+    va_start(args, format);
+    int length = vsnprintf(sequence, sizeof(sequence), format, args);
+    va_end(args);
+    
+    if (length > 0) {
+        platform_write(sequence, (size_t)length < sizeof(sequence) ? (size_t)length : sizeof(sequence) - 1);
+    }
+}
+
+void platform_begin_frame() {
+    frame_open = 1;
+}
+
+void platform_end_frame() {
+    frame_open = 0;
+    platform_flush_frame();
+}
+
+#ifdef PLATFORM_UNIX
+static void on_resize(int signal_number) {
+    (void)signal_number;
+    int saved_errno = errno;
+    if (write(resize_pipe[1], "r", 1) < 0) {
+        // Pipe already full: a wakeup is pending anyway
+    }
+    errno = saved_errno;
+}
+
+static void watch_resize() {
+    if (resize_pipe[0] >= 0 || pipe(resize_pipe) < 0) return;
+    
+    fcntl(resize_pipe[0], F_SETFL, fcntl(resize_pipe[0], F_GETFL) | O_NONBLOCK);
+    fcntl(resize_pipe[1], F_SETFL, fcntl(resize_pipe[1], F_GETFL) | O_NONBLOCK);
+    
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = on_resize;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGWINCH, &action, NULL);
+}
+
+// Read whatever the terminal has, waiting up to timeout_ms (-1: forever)
+// for it. Returns 0 if nothing arrived.
+static int input_fill(int timeout_ms) {
+    if (input_length == sizeof(input_data)) return 1;
+    
+    if (timeout_ms >= 0) {
+        struct pollfd fd = { STDIN_FILENO, POLLIN, 0 };
+        if (poll(&fd, 1, timeout_ms) <= 0) return 0;
+    }
+    
+    ssize_t n = read(STDIN_FILENO, input_data + input_length, sizeof(input_data) - input_length);
+    if (n <= 0) return 0;
+    input_length += n;
+    return 1;
+}
+
+static void input_consume(size_t count) {
+    memmove(input_data, input_data + count, input_length - count);
+    input_length -= count;
+}
+
+// Move `count` buffered bytes into the paste text
+static void paste_take(size_t count) {
+    if (paste_length + count > paste_capacity) {
+        size_t capacity = paste_capacity ? paste_capacity : PLATFORM_INPUT_BUFFER;
+        while (capacity < paste_length + count) {
+            capacity *= 2;
+        }
+        char* grown = (char*)realloc(paste_data, capacity);
+        if (grown) {
+            paste_data = grown;
+            paste_capacity = capacity;
+        }
+    }
+    
+    // Out of memory: the rest of the paste is dropped, not typed in
+    if (paste_length + count <= paste_capacity) {
+        memcpy(paste_data + paste_length, input_data, count);
+        paste_length += count;
+    }
+    input_consume(count);
+}
+
+// Collect everything up to the paste end marker, however many reads it
+// takes. A possible partial marker at the end of the buffer is held back
+// until the next read completes or rules it out.
+static void input_read_paste() {
+    static const char end_marker[] = "\033[201~";
+    size_t marker_length = sizeof(end_marker) - 1;
+    
+    paste_length = 0;
+    while (1) {
+        size_t scanned = 0;
+        while (scanned < input_length) {
+            unsigned char* esc = (unsigned char*)memchr(input_data + scanned, '\033', input_length - scanned);
+            if (!esc) {
+                scanned = input_length;
+                break;
+            }
+            
+            size_t at = esc - input_data;
+            size_t compare = input_length - at < marker_length ? input_length - at : marker_length;
+            if (memcmp(esc, end_marker, compare) == 0) {
+                if (compare == marker_length) {
+                    paste_take(at);
+                    input_consume(marker_length);
+                    return;
+                }
+                scanned = at;
+                break;
+            }
+            scanned = at + 1;
+        }
+        
+        paste_take(scanned);
+        if (!input_fill(PLATFORM_PASTE_TIMEOUT_MS)) {
+            paste_take(input_length);
+            return;
+        }
+    }
+}
 #endif
 
 void platform_init_terminal() {
@@ -16,6 +243,7 @@ void platform_init_terminal() {
 #else
     // Save original terminal settings
     tcgetattr(STDIN_FILENO, &original_termios);
+    watch_resize();
 #endif
 }
 
@@ -29,20 +257,43 @@ void platform_cleanup_terminal() {
 
 void platform_clear_screen() {
 #ifdef PLATFORM_WINDOWS
+    platform_flush_frame();
     system("cls");
 #else
-    printf("\033[2J\033[H");
-    fflush(stdout);
+    platform_write("\033[2J\033[H", 7);
 #endif
 }
 
 void platform_set_cursor_position(int x, int y) {
 #ifdef PLATFORM_WINDOWS
+    // Console calls act at once, so text written before them must go first
+    platform_flush_frame();
     COORD coord = {x, y};
     SetConsoleCursorPosition(GetStdHandle(STD_OUTPUT_HANDLE), coord);
 #else
-    printf("\033[%d;%dH", y + 1, x + 1);
-    fflush(stdout);
+    platform_writef("\033[%d;%dH", y + 1, x + 1);
+#endif
+}
+
+// Scroll screen rows top..bottom (0-based, inclusive) up by count lines,
+// or down for a negative count, leaving blank rows behind. Returns 0 where
+// the terminal cannot do it and the caller must redraw instead.
+int platform_scroll_rows(int top, int bottom, int count) {
+#ifdef PLATFORM_WINDOWS
+    (void)top;
+    (void)bottom;
+    (void)count;
+    return 0;
+#else
+    // Confine the scroll to the margins, then restore the full screen
+    platform_writef("\033[%d;%dr", top + 1, bottom + 1);
+    if (count > 0) {
+        platform_writef("\033[%dS", count);
+    } else {
+        platform_writef("\033[%dT", -count);
+    }
+    platform_write("\033[r", 3);
+    return 1;
 #endif
 }
 
@@ -62,6 +313,7 @@ void platform_get_console_size(int* rows, int* cols) {
 
 void platform_set_color(int foreground, int background) {
 #ifdef PLATFORM_WINDOWS
+    platform_flush_frame();
     SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), 
                           foreground | (background << 4));
 #else
@@ -71,42 +323,41 @@ void platform_set_color(int foreground, int background) {
         color_code = 90 + (foreground - 8);  // Bright colors
     }
     
-    printf("\033[%dm", color_code);
-    fflush(stdout);
+    platform_writef("\033[%dm", color_code);
 #endif
 }
 
 void platform_reset_color() {
 #ifdef PLATFORM_WINDOWS
+    platform_flush_frame();
     SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), 
                           7 | (0 << 4));  // Default white on black
 #else
-    printf("\033[0m");
-    fflush(stdout);
+    platform_write("\033[0m", 4);
 #endif
 }
 
 void platform_hide_cursor() {
 #ifdef PLATFORM_WINDOWS
+    platform_flush_frame();
     CONSOLE_CURSOR_INFO cursorInfo;
     GetConsoleCursorInfo(GetStdHandle(STD_OUTPUT_HANDLE), &cursorInfo);
     cursorInfo.bVisible = FALSE;
     SetConsoleCursorInfo(GetStdHandle(STD_OUTPUT_HANDLE), &cursorInfo);
 #else
-    printf("\033[?25l");
-    fflush(stdout);
+    platform_write("\033[?25l", 6);
 #endif
 }
 
 void platform_show_cursor() {
 #ifdef PLATFORM_WINDOWS
+    platform_flush_frame();
     CONSOLE_CURSOR_INFO cursorInfo;
     GetConsoleCursorInfo(GetStdHandle(STD_OUTPUT_HANDLE), &cursorInfo);
     cursorInfo.bVisible = TRUE;
     SetConsoleCursorInfo(GetStdHandle(STD_OUTPUT_HANDLE), &cursorInfo);
 #else
-    printf("\033[?25h");
-    fflush(stdout);
+    platform_write("\033[?25h", 6);
 #endif
 }
 
@@ -129,10 +380,14 @@ static void set_raw_mode_internal(int enable) {
 
 void platform_set_raw_mode(int enable) {
 #ifdef PLATFORM_UNIX
+    // Bracketed paste goes with raw mode, so prompts read in cooked mode
+    // never see the paste markers
     if (enable && !raw_mode_enabled) {
         set_raw_mode_internal(1);
         raw_mode_enabled = 1;
+        platform_write("\033[?2004h", 8);
     } else if (!enable && raw_mode_enabled) {
+        platform_write("\033[?2004l", 8);
         set_raw_mode_internal(0);
         raw_mode_enabled = 0;
     }
@@ -152,6 +407,56 @@ void platform_set_raw_mode(int enable) {
 #endif
 }
 
+int platform_input_pending(int timeout_ms) {
+#ifdef PLATFORM_WINDOWS
+    return WaitForSingleObject(GetStdHandle(STD_INPUT_HANDLE), timeout_ms) == WAIT_OBJECT_0;
+#else
+    if (input_length > 0) return 1;
+    
+    struct pollfd fd = { STDIN_FILENO, POLLIN, 0 };
+    return poll(&fd, 1, timeout_ms) > 0;
+#endif
+}
+
+// Sleep until there is a key to read, the terminal was resized, or
+// timeout_ms passes (-1 waits forever). Returns PLATFORM_EVENT_* flags.
+int platform_wait_event(int timeout_ms) {
+#ifdef PLATFORM_WINDOWS
+    DWORD wait = WaitForSingleObject(GetStdHandle(STD_INPUT_HANDLE),
+                                     timeout_ms < 0 ? INFINITE : (DWORD)timeout_ms);
+    
+    // Resizes arrive as console input too; re-reading the size is cheap
+    return wait == WAIT_OBJECT_0 ? PLATFORM_EVENT_INPUT | PLATFORM_EVENT_RESIZE : 0;
+#else
+    if (input_length > 0) return PLATFORM_EVENT_INPUT;
+    
+    struct pollfd fds[2];
+    fds[0].fd = STDIN_FILENO;
+    fds[0].events = POLLIN;
+    fds[1].fd = resize_pipe[0];
+    fds[1].events = POLLIN;
+    
+    int ready;
+    do {
+        fds[0].revents = 0;
+        fds[1].revents = 0;
+        ready = poll(fds, resize_pipe[0] >= 0 ? 2 : 1, timeout_ms);
+    } while (ready < 0 && errno == EINTR);
+    
+    int events = 0;
+    if (ready > 0 && (fds[1].revents & POLLIN)) {
+        char drain[64];
+        while (read(resize_pipe[0], drain, sizeof(drain)) > 0) {
+        }
+        events |= PLATFORM_EVENT_RESIZE;
+    }
+    if (ready > 0 && (fds[0].revents & (POLLIN | POLLHUP | POLLERR))) {
+        events |= PLATFORM_EVENT_INPUT;
+    }
+    return events;
+#endif
+}
+
 int platform_get_key(KeyEvent* event) {
     event->key = 0;
     event->ctrl = 0;
@@ -177,6 +482,7 @@ int platform_get_key(KeyEvent* event) {
                 if (event->key == 0) {
                     continue;  // Skip non-character keys
                 }
+                return 1;
             }
             
             // Map Windows virtual keys to our cross-platform keys
@@ -191,64 +497,376 @@ int platform_get_key(KeyEvent* event) {
                 case VK_NEXT: event->key = KEY_PAGE_DOWN; break;
                 case VK_DELETE: event->key = KEY_DELETE; break;
                 case VK_BACK: event->key = KEY_BACKSPACE; break;
+                case VK_F1: event->key = KEY_F1; break;
             }
             
             return 1;
         }
     }
 #else
-    // Unix/Linux implementation
-    char ch;
-    if (read(STDIN_FILENO, &ch, 1) <= 0) {
+    // One read takes everything the terminal has; keys are then decoded
+    // from the buffer until it runs dry. An escape sequence cut off at the
+    // end of the buffer gets escape_timeout_ms for the rest to arrive.
+    if (input_length == 0 && !input_fill(-1)) {
         return 0;
     }
     
-    // Check for escape sequences
-    if (ch == '\033') {
-        // Check if this is an escape sequence
-        fd_set readset;
-        struct timeval timeout;
-        FD_ZERO(&readset);
-        FD_SET(STDIN_FILENO, &readset);
-        timeout.tv_sec = 0;
-        timeout.tv_usec = 100000;  // 100ms timeout
+    size_t used;
+    while ((used = keyseq_decode(input_data, input_length, 0, event)) == 0) {
+        if (!input_fill(escape_timeout_ms)) {
+            used = keyseq_decode(input_data, input_length, 1, event);
+            break;
+        }
+    }
+    input_consume(used);
+    
+    if (event->key == KEY_PASTE) {
+        input_read_paste();
+    }
+    return 1;
+#endif
+}
+
+// How long to wait after ESC for the rest of an escape sequence before
+// taking it as the ESC key. Lower is snappier; higher suits slow links.
+void platform_set_escape_timeout(int timeout_ms) {
+#ifdef PLATFORM_UNIX
+    escape_timeout_ms = timeout_ms < 0 ? 0 : timeout_ms;
+#else
+    (void)timeout_ms;
+#endif
+}
+
+// Text of the last KEY_PASTE event, valid until the next one
+const char* platform_get_paste(size_t* length) {
+#ifdef PLATFORM_UNIX
+    *length = paste_length;
+    return paste_data;
+#else
+    // Console pastes arrive as ordinary key events
+    *length = 0;
+    return NULL;
+#endif
+}
+
+int platform_map_file(const char* filename, char** data, size_t* length) {
+    *data = NULL;
+    *length = 0;
+    
+#ifdef PLATFORM_WINDOWS
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return 0;
+    
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        return 0;
+    }
+    if (size.QuadPart == 0) {
+        CloseHandle(file);
+        return 1;
+    }
+    
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping) return 0;
+    
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!view) return 0;
+    
+    *data = (char*)view;
+    *length = (size_t)size.QuadPart;
+    return 1;
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return 0;
+    
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return 0;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return 1;
+    }
+    
+    // Private read-only view: pages are faulted in on demand
+    void* view = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) return 0;
+    
+    *data = (char*)view;
+    *length = (size_t)st.st_size;
+    return 1;
+#endif
+}
+
+void platform_unmap_file(char* data, size_t length) {
+    if (!data) return;
+    
+#ifdef PLATFORM_WINDOWS
+    (void)length;
+    UnmapViewOfFile(data);
+#else
+    munmap(data, length);
+#endif
+}
+
+int platform_open_readonly(const char* filename, PlatformHandle* file, size_t* size) {
+#ifdef PLATFORM_WINDOWS
+    HANDLE handle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE) return 0;
+    
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(handle, &file_size)) {
+        CloseHandle(handle);
+        return 0;
+    }
+    
+    *file = handle;
+    *size = (size_t)file_size.QuadPart;
+    return 1;
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return 0;
+    
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return 0;
+    }
+    
+    *file = fd;
+    *size = (size_t)st.st_size;
+    return 1;
+#endif
+}
+
+char* platform_map_range(PlatformHandle file, size_t offset, size_t length) {
+#ifdef PLATFORM_WINDOWS
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping) return NULL;
+    
+    unsigned long long start = offset;
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, (DWORD)(start >> 32),
+                               (DWORD)(start & 0xFFFFFFFF), length);
+    CloseHandle(mapping);
+    return (char*)view;
+#else
+    // offset must be a multiple of the page size
+    void* view = mmap(NULL, length, PROT_READ, MAP_PRIVATE, file, (off_t)offset);
+    return view == MAP_FAILED ? NULL : (char*)view;
+#endif
+}
+
+void platform_close_file(PlatformHandle file) {
+#ifdef PLATFORM_WINDOWS
+    CloseHandle(file);
+#else
+    close(file);
+#endif
+}
+
+// Create an empty file next to `target` to write its new contents into.
+// It gets the target's permissions and owner so the rename does not change
+// them; if the owner cannot be kept the save fails instead. A target with
+// other hard links is opened itself for rewriting, since a rename would
+// split it from them: temp_path is left empty, the write is not safe
+// against a crash, and platform_commit_file cuts off the old tail.
+int platform_create_temp(const char* target, char* temp_path, size_t size, PlatformHandle* file) {
+#ifdef PLATFORM_WINDOWS
+    if (snprintf(temp_path, size, "%s.6r-%lu", target, GetCurrentProcessId()) >= (int)size) return 0;
+    
+    HANDLE handle = CreateFileA(temp_path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                                FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE) return 0;
+    
+    *file = handle;
+    return 1;
+#else
+    // Replace the file a symlink points to, not the link
+    char* resolved = realpath(target, NULL);
+    const char* path = resolved ? resolved : target;
+    
+    struct stat st;
+    int exists = stat(path, &st) == 0;
+    int fd = -1;
+    
+    if (exists && st.st_nlink > 1) {
+        temp_path[0] = '\0';
+        fd = open(path, O_WRONLY);
+    } else if (snprintf(temp_path, size, "%s.6r-XXXXXX", path) >= (int)size) {
+        errno = ENAMETOOLONG;
+    } else {
+        fd = mkstemp(temp_path);
+    }
+    
+    if (fd >= 0 && temp_path[0]) {
+        mode_t mode;
+        if (exists) {
+            mode = st.st_mode & 07777;
+            if ((st.st_uid != geteuid() || st.st_gid != getegid()) &&
+                fchown(fd, st.st_uid, st.st_gid) < 0) {
+                // Not ours to give away: the new file would change hands
+                int error = errno;
+                close(fd);
+                unlink(temp_path);
+                errno = error;
+                fd = -1;
+            }
+        } else {
+            // New file: what open() would have given it
+            mode_t mask = umask(0);
+            umask(mask);
+            mode = 0666 & ~mask;
+        }
+        if (fd >= 0) fchmod(fd, mode);
+    }
+    
+    int error = errno;
+    free(resolved);
+    errno = error;
+    if (fd < 0) return 0;
+    
+    *file = fd;
+    return 1;
+#endif
+}
+
+int platform_write_spans(PlatformHandle file, const PlatformSpan* spans, int count) {
+#ifdef PLATFORM_WINDOWS
+    for (int i = 0; i < count; i++) {
+        const char* data = spans[i].data;
+        size_t remaining = spans[i].length;
+        while (remaining > 0) {
+            DWORD chunk = remaining > 0x40000000 ? 0x40000000 : (DWORD)remaining;
+            DWORD written;
+            if (!WriteFile(file, data, chunk, &written, NULL)) return 0;
+            data += written;
+            remaining -= written;
+        }
+    }
+    return 1;
+#else
+    struct iovec vectors[PLATFORM_WRITE_BATCH];
+    
+    while (count > 0) {
+        int n = count < PLATFORM_WRITE_BATCH ? count : PLATFORM_WRITE_BATCH;
+        for (int i = 0; i < n; i++) {
+            vectors[i].iov_base = (void*)spans[i].data;
+            vectors[i].iov_len = spans[i].length;
+        }
         
-        if (select(STDIN_FILENO + 1, &readset, NULL, NULL, &timeout) > 0) {
-            char seq[3];
-            if (read(STDIN_FILENO, seq, 2) == 2) {
-                if (seq[0] == '[') {
-                    switch (seq[1]) {
-                        case 'A': event->key = KEY_UP; return 1;
-                        case 'B': event->key = KEY_DOWN; return 1;
-                        case 'C': event->key = KEY_RIGHT; return 1;
-                        case 'D': event->key = KEY_LEFT; return 1;
-                        case 'H': event->key = KEY_HOME; return 1;
-                        case 'F': event->key = KEY_END; return 1;
-                    }
-                    
-                    // Handle extended escape sequences
-                    if (seq[1] >= '0' && seq[1] <= '9') {
-                        if (read(STDIN_FILENO, &seq[2], 1) == 1 && seq[2] == '~') {
-                            switch (seq[1]) {
-                                case '3': event->key = KEY_DELETE; return 1;
-                                case '5': event->key = KEY_PAGE_UP; return 1;
-                                case '6': event->key = KEY_PAGE_DOWN; return 1;
-                            }
-                        }
-                    }
-                }
+        int first = 0;
+        while (first < n) {
+            ssize_t written = writev(file, vectors + first, n - first);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                return 0;
+            }
+            
+            // Drop what went out, trimming a partly written span
+            while (first < n && (size_t)written >= vectors[first].iov_len) {
+                written -= vectors[first].iov_len;
+                first++;
+            }
+            if (first < n) {
+                vectors[first].iov_base = (char*)vectors[first].iov_base + written;
+                vectors[first].iov_len -= written;
             }
         }
+        
+        spans += n;
+        count -= n;
+    }
+    return 1;
+#endif
+}
+
+// Flush the temp file to disk and move it over the target, so the target
+// holds either its old contents or the new ones, never a partial write
+int platform_commit_file(PlatformHandle file, const char* temp_path, const char* target) {
+#ifdef PLATFORM_WINDOWS
+    if (!FlushFileBuffers(file)) {
+        platform_discard_file(file, temp_path);
+        return 0;
     }
+    CloseHandle(file);
     
-    // Handle backspace and delete keys
-    if (ch == 127 || ch == 8) {
-        event->key = KEY_BACKSPACE;
-        return 1;
+    if (!MoveFileExA(temp_path, target, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        DeleteFileA(temp_path);
+        return 0;
+    }
+    return 1;
+#else
+    // Written in place: drop the old tail, and there is nothing to move
+    if (!temp_path[0]) {
+        off_t end = lseek(file, 0, SEEK_CUR);
+        int ok = end >= 0 && ftruncate(file, end) == 0 && fsync(file) == 0;
+        return close(file) == 0 && ok;
+    }
+    
+    if (fsync(file) < 0) {
+        platform_discard_file(file, temp_path);
+        return 0;
+    }
+    
+    // The temp file sits next to the resolved target, as does the rename
+    char* resolved = realpath(target, NULL);
+    const char* path = resolved ? resolved : target;
+    if (close(file) < 0 || rename(temp_path, path) < 0) {
+        unlink(temp_path);
+        free(resolved);
+        return 0;
+    }
+    
+    // Make the rename itself durable
+    char dir[512];
+    const char* slash = strrchr(path, '/');
+    if (slash) {
+        size_t length = slash == path ? 1 : (size_t)(slash - path);
+        if (length >= sizeof(dir)) {
+            free(resolved);
+            return 1;
+        }
+        memcpy(dir, path, length);
+        dir[length] = '\0';
+    } else {
+        strcpy(dir, ".");
     }
+    free(resolved);
     
-    // Regular character
-    event->key = ch;
+    int dir_fd = open(dir, O_RDONLY);
+    if (dir_fd >= 0) {
+        fsync(dir_fd);
+        close(dir_fd);
+    }
     return 1;
 #endif
+}
+
+void platform_discard_file(PlatformHandle file, const char* temp_path) {
+#ifdef PLATFORM_WINDOWS
+    CloseHandle(file);
+    DeleteFileA(temp_path);
+#else
+    close(file);
+    if (temp_path[0]) unlink(temp_path);
+#endif
+}
+
+// Processors available for background work
+int platform_cpu_count() {
+#ifdef PLATFORM_WINDOWS
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+#endif
 }
\ No newline at end of file
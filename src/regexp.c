@@ -0,0 +1,876 @@
+#include "regexp.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Groups may nest this deep before the pattern is refused
+#define REGEXP_MAX_DEPTH 1000
+
+// Where a scan stands relative to the ends of the line
+#define AT_BEGIN 1
+#define AT_END 2
+
+enum { NODE_EMPTY, NODE_SET, NODE_CAT, NODE_ALT, NODE_STAR, NODE_PLUS, NODE_QUEST, NODE_REPEAT, NODE_BEGIN, NODE_END };
+enum { OP_BYTE, OP_SPLIT, OP_JMP, OP_BEGIN, OP_END, OP_MATCH };
+
+typedef struct {
+    unsigned char bits[32];
+} ByteSet;
+
+typedef struct {
+    int type;
+    int left;
+    int right;
+    int set;
+    int min;
+    int max;             // -1 for no upper bound
+} Node;
+
+typedef struct {
+    int op;
+    int x;               // OP_BYTE: byte set; OP_SPLIT, OP_JMP: target
+    int y;               // OP_SPLIT: second target
+} Inst;
+
+// NFA states are kept as sets of instructions. Only the ones that wait for
+// something (a byte, the end of the line, or the match) tell two sets apart.
+typedef struct {
+    int* set;
+    int count;
+    int accept;
+    unsigned int hash;
+} DfaState;
+
+// One program plus the DFA built from it so far. State 0 is the dead state.
+typedef struct {
+    Inst* code;
+    int count;
+    int capacity;
+    DfaState* states;
+    int state_count;
+    int state_capacity;
+    int* next;           // state * class_count + class, -1 until built
+    int* buckets;        // hash of state sets, state index + 1, 0 empty
+    int bucket_count;
+    int start[2];        // start state without and with AT_BEGIN
+} Machine;
+
+// Sparse set of instruction indexes, cleared in constant time
+typedef struct {
+    int* dense;
+    int* sparse;
+    int count;
+    int match;
+} ThreadSet;
+
+struct Regexp {
+    ByteSet* sets;
+    int set_count;
+    unsigned char byte_class[256];
+    unsigned char class_byte[256];
+    int class_count;
+    Machine forward;     // the pattern, anchored where the scan starts
+    Machine reverse;     // the pattern backwards, preceded by .*
+    ThreadSet current;
+    ThreadSet following;
+    ThreadSet scratch;
+    int* stack;
+    int* key;
+    size_t memory;
+    size_t limit;
+    size_t nfa_bytes;
+};
+
+typedef struct {
+    const char* pattern;
+    size_t length;
+    size_t pos;
+    Node* nodes;
+    int node_count;
+    int node_capacity;
+    ByteSet* sets;
+    int set_count;
+    int set_capacity;
+    int depth;
+    const char* error;
+} Parser;
+
+static int set_has(const ByteSet* set, int ch) {
+    return (set->bits[ch >> 3] >> (ch & 7)) & 1;
+}
+
+static void set_add(ByteSet* set, int ch) {
+    set->bits[ch >> 3] |= (unsigned char)(1 << (ch & 7));
+}
+
+static void set_add_range(ByteSet* set, int from, int to) {
+    for (int ch = from; ch <= to; ch++) {
+        set_add(set, ch);
+    }
+}
+
+static void set_invert(ByteSet* set) {
+    for (int i = 0; i < 32; i++) {
+        set->bits[i] = (unsigned char)~set->bits[i];
+    }
+}
+
+// --- Parsing -------------------------------------------------------------
+
+static int parse_fail(Parser* parser, const char* error) {
+    if (!parser->error) parser->error = error;
+    return -1;
+}
+
+static int new_node(Parser* parser, int type, int left, int right) {
+    if (parser->node_count == parser->node_capacity) {
+        int new_capacity = parser->node_capacity ? parser->node_capacity * 2 : 64;
+        Node* grown = (Node*)realloc(parser->nodes, new_capacity * sizeof(Node));
+        if (!grown) return parse_fail(parser, "out of memory");
+        parser->nodes = grown;
+        parser->node_capacity = new_capacity;
+    }
+
+    Node* node = &parser->nodes[parser->node_count];
+    memset(node, 0, sizeof(Node));
+    node->type = type;
+    node->left = left;
+    node->right = right;
+    return parser->node_count++;
+}
+
+static ByteSet* new_set(Parser* parser) {
+    if (parser->set_count == parser->set_capacity) {
+        int new_capacity = parser->set_capacity ? parser->set_capacity * 2 : 16;
+        ByteSet* grown = (ByteSet*)realloc(parser->sets, new_capacity * sizeof(ByteSet));
+        if (!grown) return NULL;
+        parser->sets = grown;
+        parser->set_capacity = new_capacity;
+    }
+
+    ByteSet* set = &parser->sets[parser->set_count++];
+    memset(set, 0, sizeof(ByteSet));
+    return set;
+}
+
+static int set_node(Parser* parser, ByteSet** set) {
+    *set = new_set(parser);
+    if (!*set) return parse_fail(parser, "out of memory");
+
+    int node = new_node(parser, NODE_SET, -1, -1);
+    if (node >= 0) parser->nodes[node].set = parser->set_count - 1;
+    return node;
+}
+
+static int peek(const Parser* parser) {
+    return parser->pos < parser->length ? (unsigned char)parser->pattern[parser->pos] : -1;
+}
+
+// \d \w \s and their capitals; returns 0 if ch names no class
+static int add_class_escape(ByteSet* set, int ch) {
+    ByteSet class;
+    memset(&class, 0, sizeof(class));
+
+    switch (ch) {
+        case 'd': case 'D':
+            set_add_range(&class, '0', '9');
+            break;
+        case 'w': case 'W':
+            set_add_range(&class, '0', '9');
+            set_add_range(&class, 'a', 'z');
+            set_add_range(&class, 'A', 'Z');
+            set_add(&class, '_');
+            break;
+        case 's': case 'S':
+            set_add(&class, ' ');
+            set_add_range(&class, '\t', '\r');
+            break;
+        default:
+            return 0;
+    }
+
+    if (ch == 'D' || ch == 'W' || ch == 'S') set_invert(&class);
+    for (int i = 0; i < 32; i++) {
+        set->bits[i] |= class.bits[i];
+    }
+    return 1;
+}
+
+static int escape_byte(int ch) {
+    switch (ch) {
+        case 't': return '\t';
+        case 'n': return '\n';
+        case 'r': return '\r';
+        case 'f': return '\f';
+        case 'v': return '\v';
+        case '0': return '\0';
+    }
+    return ch;
+}
+
+// After '[': members up to the closing ']'. A ']' right at the start is
+// taken literally.
+static int parse_class(Parser* parser) {
+    ByteSet* set;
+    int node = set_node(parser, &set);
+    if (node < 0) return -1;
+
+    int negate = 0;
+    if (peek(parser) == '^') {
+        negate = 1;
+        parser->pos++;
+    }
+
+    int first = 1;
+    while (peek(parser) >= 0 && (peek(parser) != ']' || first)) {
+        int ch = peek(parser);
+        parser->pos++;
+        first = 0;
+
+        if (ch == '\\') {
+            if (peek(parser) < 0) return parse_fail(parser, "trailing backslash");
+            ch = peek(parser);
+            parser->pos++;
+            if (add_class_escape(set, ch)) continue;
+            ch = escape_byte(ch);
+        }
+
+        if (peek(parser) == '-' && parser->pos + 1 < parser->length && parser->pattern[parser->pos + 1] != ']') {
+            parser->pos++;
+            int to = peek(parser);
+            parser->pos++;
+            if (to == '\\') {
+                if (peek(parser) < 0) return parse_fail(parser, "trailing backslash");
+                to = escape_byte(peek(parser));
+                parser->pos++;
+            }
+            if (to < ch) return parse_fail(parser, "bad class range");
+            set_add_range(set, ch, to);
+        } else {
+            set_add(set, ch);
+        }
+    }
+
+    if (peek(parser) != ']') return parse_fail(parser, "missing ]");
+    parser->pos++;
+    if (negate) set_invert(set);
+    return node;
+}
+
+static int parse_alternation(Parser* parser);
+
+static int parse_atom(Parser* parser) {
+    int ch = peek(parser);
+    ByteSet* set;
+    int node;
+
+    parser->pos++;
+    switch (ch) {
+        case '(':
+            if (++parser->depth > REGEXP_MAX_DEPTH) return parse_fail(parser, "groups nested too deep");
+            if (peek(parser) == '?') {
+                if (parser->pos + 1 >= parser->length || parser->pattern[parser->pos + 1] != ':') {
+                    return parse_fail(parser, "unsupported group");
+                }
+                parser->pos += 2;
+            }
+            node = parse_alternation(parser);
+            if (node < 0) return -1;
+            if (peek(parser) != ')') return parse_fail(parser, "missing )");
+            parser->pos++;
+            parser->depth--;
+            return node;
+        case '[':
+            return parse_class(parser);
+        case '.':
+            node = set_node(parser, &set);
+            if (node >= 0) set_add_range(set, 0, 255);
+            return node;
+        case '^':
+            return new_node(parser, NODE_BEGIN, -1, -1);
+        case '$':
+            return new_node(parser, NODE_END, -1, -1);
+        case '*': case '+': case '?': case '{':
+            return parse_fail(parser, "nothing to repeat");
+        case '\\':
+            if (peek(parser) < 0) return parse_fail(parser, "trailing backslash");
+            ch = peek(parser);
+            parser->pos++;
+            node = set_node(parser, &set);
+            if (node >= 0 && !add_class_escape(set, ch)) set_add(set, escape_byte(ch));
+            return node;
+        default:
+            node = set_node(parser, &set);
+            if (node >= 0) set_add(set, ch);
+            return node;
+    }
+}
+
+static int parse_count(Parser* parser) {
+    int value = -1;
+    while (peek(parser) >= '0' && peek(parser) <= '9') {
+        value = (value < 0 ? 0 : value) * 10 + (peek(parser) - '0');
+        if (value > REGEXP_MAX_PROGRAM) return -2;
+        parser->pos++;
+    }
+    return value;
+}
+
+// "{m}", "{m,}" or "{m,n}" after an atom
+static int parse_braces(Parser* parser, int node) {
+    int min = parse_count(parser);
+    int max = min;
+
+    if (peek(parser) == ',') {
+        parser->pos++;
+        max = parse_count(parser);
+    }
+    if (min == -2 || max == -2) return parse_fail(parser, "repetition count too large");
+    if (min < 0 || peek(parser) != '}') return parse_fail(parser, "bad repetition");
+    if (max >= 0 && max < min) return parse_fail(parser, "bad repetition range");
+    parser->pos++;
+
+    int repeat = new_node(parser, NODE_REPEAT, node, -1);
+    if (repeat >= 0) {
+        parser->nodes[repeat].min = min;
+        parser->nodes[repeat].max = max;
+    }
+    return repeat;
+}
+
+static int parse_repeat(Parser* parser) {
+    int node = parse_atom(parser);
+
+    while (node >= 0) {
+        int ch = peek(parser);
+        if (ch == '*') {
+            node = new_node(parser, NODE_STAR, node, -1);
+        } else if (ch == '+') {
+            node = new_node(parser, NODE_PLUS, node, -1);
+        } else if (ch == '?') {
+            node = new_node(parser, NODE_QUEST, node, -1);
+        } else if (ch == '{') {
+            parser->pos++;
+            node = parse_braces(parser, node);
+            continue;
+        } else {
+            break;
+        }
+        parser->pos++;
+    }
+    return node;
+}
+
+static int parse_concatenation(Parser* parser) {
+    int node = -1;
+
+    while (peek(parser) >= 0 && peek(parser) != '|' && peek(parser) != ')') {
+        int next = parse_repeat(parser);
+        if (next < 0) return -1;
+        node = node < 0 ? next : new_node(parser, NODE_CAT, node, next);
+        if (node < 0) return -1;
+    }
+    return node < 0 ? new_node(parser, NODE_EMPTY, -1, -1) : node;
+}
+
+static int parse_alternation(Parser* parser) {
+    int node = parse_concatenation(parser);
+
+    while (node >= 0 && peek(parser) == '|') {
+        parser->pos++;
+        int next = parse_concatenation(parser);
+        if (next < 0) return -1;
+        node = new_node(parser, NODE_ALT, node, next);
+    }
+    return node;
+}
+
+// --- Compiling -----------------------------------------------------------
+
+static int emit(Machine* machine, int op, int x, int y) {
+    if (machine->count >= REGEXP_MAX_PROGRAM) return -1;
+    if (machine->count == machine->capacity) {
+        int new_capacity = machine->capacity ? machine->capacity * 2 : 64;
+        Inst* grown = (Inst*)realloc(machine->code, new_capacity * sizeof(Inst));
+        if (!grown) return -1;
+        machine->code = grown;
+        machine->capacity = new_capacity;
+    }
+
+    Inst* inst = &machine->code[machine->count];
+    inst->op = op;
+    inst->x = x;
+    inst->y = y;
+    return machine->count++;
+}
+
+// Thompson construction. Backwards, concatenations are emitted in reverse
+// and ^ and $ trade places, giving a program for the reversed text.
+static int compile_node(Machine* machine, const Node* nodes, int index, int backward);
+
+static int compile_star(Machine* machine, const Node* nodes, int child, int backward) {
+    int split = emit(machine, OP_SPLIT, 0, 0);
+    if (split < 0) return 0;
+    machine->code[split].x = machine->count;
+    if (!compile_node(machine, nodes, child, backward)) return 0;
+    if (emit(machine, OP_JMP, split, 0) < 0) return 0;
+    machine->code[split].y = machine->count;
+    return 1;
+}
+
+static int compile_node(Machine* machine, const Node* nodes, int index, int backward) {
+    const Node* node = &nodes[index];
+    int split, jump;
+
+    switch (node->type) {
+        case NODE_EMPTY:
+            return 1;
+        case NODE_SET:
+            return emit(machine, OP_BYTE, node->set, 0) >= 0;
+        case NODE_BEGIN:
+            return emit(machine, backward ? OP_END : OP_BEGIN, 0, 0) >= 0;
+        case NODE_END:
+            return emit(machine, backward ? OP_BEGIN : OP_END, 0, 0) >= 0;
+        case NODE_CAT:
+            if (backward) {
+                return compile_node(machine, nodes, node->right, backward) &&
+                       compile_node(machine, nodes, node->left, backward);
+            }
+            return compile_node(machine, nodes, node->left, backward) &&
+                   compile_node(machine, nodes, node->right, backward);
+        case NODE_ALT:
+            if ((split = emit(machine, OP_SPLIT, 0, 0)) < 0) return 0;
+            machine->code[split].x = machine->count;
+            if (!compile_node(machine, nodes, node->left, backward)) return 0;
+            if ((jump = emit(machine, OP_JMP, 0, 0)) < 0) return 0;
+            machine->code[split].y = machine->count;
+            if (!compile_node(machine, nodes, node->right, backward)) return 0;
+            machine->code[jump].x = machine->count;
+            return 1;
+        case NODE_STAR:
+            return compile_star(machine, nodes, node->left, backward);
+        case NODE_PLUS:
+            jump = machine->count;
+            if (!compile_node(machine, nodes, node->left, backward)) return 0;
+            if ((split = emit(machine, OP_SPLIT, jump, 0)) < 0) return 0;
+            machine->code[split].y = machine->count;
+            return 1;
+        case NODE_QUEST:
+            if ((split = emit(machine, OP_SPLIT, 0, 0)) < 0) return 0;
+            machine->code[split].x = machine->count;
+            if (!compile_node(machine, nodes, node->left, backward)) return 0;
+            machine->code[split].y = machine->count;
+            return 1;
+        case NODE_REPEAT:
+            // a{2,4} is a a a? a?, and a{2,} is a a a*
+            for (int i = 0; i < node->min; i++) {
+                if (!compile_node(machine, nodes, node->left, backward)) return 0;
+            }
+            if (node->max < 0) {
+                return compile_star(machine, nodes, node->left, backward);
+            }
+            for (int i = node->min; i < node->max; i++) {
+                if ((split = emit(machine, OP_SPLIT, 0, 0)) < 0) return 0;
+                machine->code[split].x = machine->count;
+                if (!compile_node(machine, nodes, node->left, backward)) return 0;
+                machine->code[split].y = machine->count;
+            }
+            return 1;
+    }
+    return 0;
+}
+
+// Bytes no set tells apart share a class, and DFA rows have one column
+// per class instead of one per byte
+static void compute_byte_classes(Regexp* regexp) {
+    int remap[256][2];
+
+    memset(regexp->byte_class, 0, sizeof(regexp->byte_class));
+    regexp->class_count = 1;
+    for (int s = 0; s < regexp->set_count; s++) {
+        int count = 0;
+        for (int i = 0; i < regexp->class_count; i++) {
+            remap[i][0] = remap[i][1] = -1;
+        }
+        for (int ch = 0; ch < 256; ch++) {
+            int* slot = &remap[regexp->byte_class[ch]][set_has(&regexp->sets[s], ch)];
+            if (*slot < 0) *slot = count++;
+            regexp->byte_class[ch] = (unsigned char)*slot;
+        }
+        regexp->class_count = count;
+    }
+    for (int ch = 255; ch >= 0; ch--) {
+        regexp->class_byte[regexp->byte_class[ch]] = (unsigned char)ch;
+    }
+}
+
+// --- Matching ------------------------------------------------------------
+
+static int thread_set_init(ThreadSet* set, int size) {
+    set->dense = (int*)malloc(size * sizeof(int));
+    set->sparse = (int*)malloc(size * sizeof(int));
+    set->count = 0;
+    set->match = 0;
+    return set->dense && set->sparse;
+}
+
+static void thread_set_free(ThreadSet* set) {
+    free(set->dense);
+    free(set->sparse);
+}
+
+static void thread_set_clear(ThreadSet* set) {
+    set->count = 0;
+    set->match = 0;
+}
+
+static int thread_set_has(const ThreadSet* set, int pc) {
+    int i = set->sparse[pc];
+    return i >= 0 && i < set->count && set->dense[i] == pc;
+}
+
+// Add pc and everything reachable from it without consuming a byte
+static void add_thread(Regexp* regexp, const Machine* machine, ThreadSet* set, int pc, int flags) {
+    int top = 0;
+
+    regexp->stack[top++] = pc;
+    while (top > 0) {
+        pc = regexp->stack[--top];
+        if (thread_set_has(set, pc)) continue;
+        set->sparse[pc] = set->count;
+        set->dense[set->count++] = pc;
+
+        const Inst* inst = &machine->code[pc];
+        switch (inst->op) {
+            case OP_JMP:
+                regexp->stack[top++] = inst->x;
+                break;
+            case OP_SPLIT:
+                regexp->stack[top++] = inst->y;
+                regexp->stack[top++] = inst->x;
+                break;
+            case OP_BEGIN:
+                if (flags & AT_BEGIN) regexp->stack[top++] = pc + 1;
+                break;
+            case OP_END:
+                if (flags & AT_END) regexp->stack[top++] = pc + 1;
+                break;
+            case OP_MATCH:
+                set->match = 1;
+                break;
+        }
+    }
+}
+
+// Threads of `from` that accept ch, advanced past it
+static void step(Regexp* regexp, const Machine* machine, const int* from, int count, int ch, ThreadSet* to) {
+    thread_set_clear(to);
+    for (int i = 0; i < count; i++) {
+        const Inst* inst = &machine->code[from[i]];
+        if (inst->op == OP_BYTE && set_has(&regexp->sets[inst->x], ch)) {
+            add_thread(regexp, machine, to, from[i] + 1, 0);
+        }
+    }
+}
+
+// Whether threads waiting for the end of the text match once it comes
+static int accepts_at_end(Regexp* regexp, const Machine* machine, const int* set, int count, int flags) {
+    ThreadSet* scratch = &regexp->scratch;
+
+    thread_set_clear(scratch);
+    for (int i = 0; i < count; i++) {
+        const Inst* inst = &machine->code[set[i]];
+        if (inst->op == OP_MATCH) return 1;
+        if (inst->op == OP_END) add_thread(regexp, machine, scratch, set[i] + 1, flags | AT_END);
+    }
+    return scratch->match;
+}
+
+static int compare_int(const void* a, const void* b) {
+    return *(const int*)a - *(const int*)b;
+}
+
+// The DFA state for a thread set: found in the cache, or built if the
+// cache has room. -1 once it is full.
+static int dfa_state(Regexp* regexp, Machine* machine, const ThreadSet* threads) {
+    int count = 0;
+    unsigned int hash = 2166136261u;
+
+    for (int i = 0; i < threads->count; i++) {
+        int op = machine->code[threads->dense[i]].op;
+        if (op == OP_BYTE || op == OP_END || op == OP_MATCH) {
+            regexp->key[count++] = threads->dense[i];
+        }
+    }
+    qsort(regexp->key, count, sizeof(int), compare_int);
+    for (int i = 0; i < count; i++) {
+        hash = (hash ^ (unsigned int)regexp->key[i]) * 16777619u;
+    }
+
+    int mask = machine->bucket_count - 1;
+    int slot = machine->bucket_count ? (int)(hash & mask) : 0;
+    while (machine->bucket_count && machine->buckets[slot]) {
+        DfaState* state = &machine->states[machine->buckets[slot] - 1];
+        if (state->hash == hash && state->count == count &&
+            memcmp(state->set, regexp->key, count * sizeof(int)) == 0) {
+            return machine->buckets[slot] - 1;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    size_t cost = sizeof(DfaState) + count * sizeof(int) + regexp->class_count * sizeof(int) + 2 * sizeof(int);
+    if (regexp->memory + cost > regexp->limit) return -1;
+
+    // Grow the state array, the transition rows and the hash table
+    if (machine->state_count == machine->state_capacity) {
+        int new_capacity = machine->state_capacity ? machine->state_capacity * 2 : 16;
+        DfaState* states = (DfaState*)realloc(machine->states, new_capacity * sizeof(DfaState));
+        if (!states) return -1;
+        machine->states = states;
+        int* next = (int*)realloc(machine->next, (size_t)new_capacity * regexp->class_count * sizeof(int));
+        if (!next) return -1;
+        machine->next = next;
+        machine->state_capacity = new_capacity;
+    }
+    if ((machine->state_count + 1) * 2 > machine->bucket_count) {
+        int new_count = machine->bucket_count ? machine->bucket_count * 2 : 64;
+        int* buckets = (int*)calloc(new_count, sizeof(int));
+        if (!buckets) return -1;
+        for (int i = 0; i < machine->state_count; i++) {
+            int s = (int)(machine->states[i].hash & (new_count - 1));
+            while (buckets[s]) s = (s + 1) & (new_count - 1);
+            buckets[s] = i + 1;
+        }
+        free(machine->buckets);
+        machine->buckets = buckets;
+        machine->bucket_count = new_count;
+        mask = new_count - 1;
+        slot = (int)(hash & mask);
+        while (machine->buckets[slot]) slot = (slot + 1) & mask;
+    }
+
+    int* set = (int*)malloc((count ? count : 1) * sizeof(int));
+    if (!set) return -1;
+    memcpy(set, regexp->key, count * sizeof(int));
+
+    int index = machine->state_count++;
+    DfaState* state = &machine->states[index];
+    state->set = set;
+    state->count = count;
+    state->accept = threads->match;
+    state->hash = hash;
+    for (int c = 0; c < regexp->class_count; c++) {
+        machine->next[(size_t)index * regexp->class_count + c] = -1;
+    }
+    machine->buckets[slot] = index + 1;
+    regexp->memory += cost;
+    return index;
+}
+
+static int dfa_start(Regexp* regexp, Machine* machine, int flags) {
+    int begin = (flags & AT_BEGIN) != 0;
+    if (machine->start[begin] >= 0) return machine->start[begin];
+
+    // The end of the line is only checked once the scan gets there
+    thread_set_clear(&regexp->current);
+    add_thread(regexp, machine, &regexp->current, 0, flags & AT_BEGIN);
+    machine->start[begin] = dfa_state(regexp, machine, &regexp->current);
+    return machine->start[begin];
+}
+
+// Finish a scan on the NFA from the threads in regexp->current, once the
+// DFA cache has no room for the states the text leads to
+static long long nfa_scan(Regexp* regexp, const Machine* machine, const unsigned char* text,
+                          size_t pos, size_t last, int backward, int flags, long long found) {
+    ThreadSet* current = &regexp->current;
+    ThreadSet* following = &regexp->following;
+
+    while (current->count > 0) {
+        if (current->match) found = (long long)pos;
+        if (pos == last) {
+            if ((flags & AT_END) && accepts_at_end(regexp, machine, current->dense, current->count, flags)) {
+                found = (long long)pos;
+            }
+            break;
+        }
+
+        int ch = backward ? text[pos - 1] : text[pos];
+        step(regexp, machine, current->dense, current->count, ch, following);
+        ThreadSet swap = *current;
+        *current = *following;
+        *following = swap;
+        pos = backward ? pos - 1 : pos + 1;
+        flags &= ~AT_BEGIN;
+        regexp->nfa_bytes++;
+    }
+    return found;
+}
+
+// Run a program over text from `first` towards `last`, forwards or
+// backwards, and return the last position where it was in a matching
+// state, or -1. flags say which ends of the line the scan starts and
+// stops at. Going forwards that is the longest match from `first`;
+// backwards, with the unanchored reverse program, the leftmost start.
+static long long scan(Regexp* regexp, Machine* machine, const unsigned char* text,
+                      size_t first, size_t last, int backward, int flags) {
+    long long found = -1;
+    size_t pos = first;
+    int stride = regexp->class_count;
+    int state = dfa_start(regexp, machine, flags);
+
+    if (state < 0) {
+        // add_thread already left the start threads in regexp->current
+        return nfa_scan(regexp, machine, text, pos, last, backward, flags, found);
+    }
+
+    for (;;) {
+        if (machine->states[state].accept) found = (long long)pos;
+        if (pos == last) break;
+
+        int ch = backward ? text[pos - 1] : text[pos];
+        int next = machine->next[(size_t)state * stride + regexp->byte_class[ch]];
+        if (next < 0) {
+            const DfaState* from = &machine->states[state];
+            step(regexp, machine, from->set, from->count, regexp->class_byte[regexp->byte_class[ch]], &regexp->current);
+            next = dfa_state(regexp, machine, &regexp->current);
+            if (next < 0) {
+                // regexp->current holds the threads after ch
+                pos = backward ? pos - 1 : pos + 1;
+                regexp->nfa_bytes++;
+                return nfa_scan(regexp, machine, text, pos, last, backward, flags & ~AT_BEGIN, found);
+            }
+            machine->next[(size_t)state * stride + regexp->byte_class[ch]] = next;
+        }
+
+        state = next;
+        pos = backward ? pos - 1 : pos + 1;
+        flags &= ~AT_BEGIN;
+        if (machine->states[state].count == 0) return found;
+    }
+
+    const DfaState* end = &machine->states[state];
+    if ((flags & AT_END) && accepts_at_end(regexp, machine, end->set, end->count, flags)) {
+        found = (long long)pos;
+    }
+    return found;
+}
+
+static void machine_free(Machine* machine) {
+    for (int i = 0; i < machine->state_count; i++) {
+        free(machine->states[i].set);
+    }
+    free(machine->states);
+    free(machine->next);
+    free(machine->buckets);
+    free(machine->code);
+}
+
+Regexp* regexp_compile(const char* pattern, size_t length, const char** error) {
+    Parser parser;
+    memset(&parser, 0, sizeof(parser));
+    parser.pattern = pattern;
+    parser.length = length;
+
+    int root = parse_alternation(&parser);
+    if (root >= 0 && parser.pos < parser.length) parse_fail(&parser, "unmatched )");
+
+    Regexp* regexp = (Regexp*)calloc(1, sizeof(Regexp));
+    if (!regexp) parse_fail(&parser, "out of memory");
+
+    if (!parser.error) {
+        regexp->sets = parser.sets;
+        regexp->set_count = parser.set_count;
+        regexp->limit = REGEXP_DEFAULT_CACHE;
+        parser.sets = NULL;
+
+        // The reverse program starts with .* so a match may begin anywhere
+        Machine* reverse = &regexp->reverse;
+        ByteSet any;
+        memset(&any, 0xFF, sizeof(any));
+        int ok = emit(reverse, OP_SPLIT, 1, 3) >= 0 && emit(reverse, OP_BYTE, regexp->set_count, 0) >= 0 &&
+                 emit(reverse, OP_JMP, 0, 0) >= 0 &&
+                 compile_node(reverse, parser.nodes, root, 1) && emit(reverse, OP_MATCH, 0, 0) >= 0 &&
+                 compile_node(&regexp->forward, parser.nodes, root, 0) && emit(&regexp->forward, OP_MATCH, 0, 0) >= 0;
+        if (!ok) parse_fail(&parser, "pattern too large");
+
+        ByteSet* sets = ok ? (ByteSet*)realloc(regexp->sets, (regexp->set_count + 1) * sizeof(ByteSet)) : NULL;
+        if (sets) {
+            regexp->sets = sets;
+            regexp->sets[regexp->set_count++] = any;
+        } else {
+            parse_fail(&parser, "out of memory");
+        }
+    }
+
+    if (!parser.error) {
+        int size = regexp->forward.count > regexp->reverse.count ? regexp->forward.count : regexp->reverse.count;
+        regexp->stack = (int*)malloc((2 * size + 2) * sizeof(int));
+        regexp->key = (int*)malloc(size * sizeof(int));
+        if (!thread_set_init(&regexp->current, size) || !thread_set_init(&regexp->following, size) ||
+            !thread_set_init(&regexp->scratch, size) || !regexp->stack || !regexp->key) {
+            parse_fail(&parser, "out of memory");
+        }
+    }
+
+    free(parser.nodes);
+    free(parser.sets);
+    if (parser.error) {
+        if (error) *error = parser.error;
+        regexp_free(regexp);
+        return NULL;
+    }
+
+    compute_byte_classes(regexp);
+    regexp->forward.start[0] = regexp->forward.start[1] = -1;
+    regexp->reverse.start[0] = regexp->reverse.start[1] = -1;
+
+    // State 0 of each DFA is the dead state every failing path ends in
+    thread_set_clear(&regexp->current);
+    dfa_state(regexp, &regexp->forward, &regexp->current);
+    dfa_state(regexp, &regexp->reverse, &regexp->current);
+    for (int c = 0; c < regexp->class_count; c++) {
+        regexp->forward.next[c] = 0;
+        regexp->reverse.next[c] = 0;
+    }
+    return regexp;
+}
+
+void regexp_free(Regexp* regexp) {
+    if (!regexp) return;
+
+    machine_free(&regexp->forward);
+    machine_free(&regexp->reverse);
+    thread_set_free(&regexp->current);
+    thread_set_free(&regexp->following);
+    thread_set_free(&regexp->scratch);
+    free(regexp->stack);
+    free(regexp->key);
+    free(regexp->sets);
+    free(regexp);
+}
+
+// States already built stay usable; only new ones are refused past it
+void regexp_set_cache_limit(Regexp* regexp, size_t limit) {
+    regexp->limit = limit;
+}
+
+void regexp_get_stats(const Regexp* regexp, RegexpStats* stats) {
+    stats->states = regexp->forward.state_count + regexp->reverse.state_count;
+    stats->memory = regexp->memory;
+    stats->nfa_bytes = regexp->nfa_bytes;
+}
+
+int regexp_search(Regexp* regexp, const char* text, size_t length, size_t from, size_t* start, size_t* end) {
+    const unsigned char* data = (const unsigned char*)text;
+    if (from > length) return 0;
+
+    // Backwards from the end of the line, the reversed pattern is last in
+    // a matching state at the leftmost position any match starts
+    long long first = scan(regexp, &regexp->reverse, data, length, from, 1, AT_BEGIN | (from == 0 ? AT_END : 0));
+    if (first < 0) return 0;
+
+    // From there, the longest match forwards
+    long long last = scan(regexp, &regexp->forward, data, (size_t)first, length, 0, (first == 0 ? AT_BEGIN : 0) | AT_END);
+    *start = (size_t)first;
+    *end = last >= first ? (size_t)last : (size_t)first;
+    return 1;
+}
\ No newline at end of file
@@ -0,0 +1,568 @@
+#include "search.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__))
+#define SEARCH_X86 1
+#include <immintrin.h>
+#endif
+
+typedef const char* (*SearchKernel)(const char* haystack, size_t length, const char* needle, size_t needle_length);
+
+// Candidates come from memchr on the first byte, which libc vectorizes
+static const char* find_scalar(const char* haystack, size_t length, const char* needle, size_t needle_length) {
+    const char* end = haystack + (length - needle_length) + 1;
+    const char* p = haystack;
+
+    while (p < end && (p = (const char*)memchr(p, needle[0], end - p)) != NULL) {
+        if (memcmp(p + 1, needle + 1, needle_length - 1) == 0) return p;
+        p++;
+    }
+    return NULL;
+}
+
+#ifdef SEARCH_X86
+// Compare the needle's first and last bytes against 16 positions at once;
+// only positions where both agree are checked in full
+static const char* find_sse2(const char* haystack, size_t length, const char* needle, size_t needle_length) {
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[needle_length - 1]);
+    size_t i = 0;
+
+    for (; i + needle_length - 1 + 16 <= length; i += 16) {
+        __m128i head = _mm_loadu_si128((const __m128i*)(haystack + i));
+        __m128i tail = _mm_loadu_si128((const __m128i*)(haystack + i + needle_length - 1));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(head, first), _mm_cmpeq_epi8(tail, last)));
+        while (mask) {
+            size_t at = i + __builtin_ctz(mask);
+            if (memcmp(haystack + at + 1, needle + 1, needle_length - 2) == 0) return haystack + at;
+            mask &= mask - 1;
+        }
+    }
+    return find_scalar(haystack + i, length - i, needle, needle_length);
+}
+
+__attribute__((target("avx2")))
+static const char* find_avx2(const char* haystack, size_t length, const char* needle, size_t needle_length) {
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[needle_length - 1]);
+    size_t i = 0;
+
+    for (; i + needle_length - 1 + 32 <= length; i += 32) {
+        __m256i head = _mm256_loadu_si256((const __m256i*)(haystack + i));
+        __m256i tail = _mm256_loadu_si256((const __m256i*)(haystack + i + needle_length - 1));
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(head, first), _mm256_cmpeq_epi8(tail, last)));
+        while (mask) {
+            size_t at = i + __builtin_ctz(mask);
+            if (memcmp(haystack + at + 1, needle + 1, needle_length - 2) == 0) return haystack + at;
+            mask &= mask - 1;
+        }
+    }
+    return find_sse2(haystack + i, length - i, needle, needle_length);
+}
+#endif
+
+// Long needles: skip ahead by how far the byte under the needle's end is
+// from the needle's end
+static const char* find_horspool(const char* haystack, size_t length, const char* needle, size_t needle_length) {
+    size_t skip[256];
+    unsigned char last = (unsigned char)needle[needle_length - 1];
+
+    for (int i = 0; i < 256; i++) {
+        skip[i] = needle_length;
+    }
+    for (size_t i = 0; i + 1 < needle_length; i++) {
+        skip[(unsigned char)needle[i]] = needle_length - 1 - i;
+    }
+
+    size_t i = 0;
+    while (i + needle_length <= length) {
+        unsigned char ch = (unsigned char)haystack[i + needle_length - 1];
+        if (ch == last && memcmp(haystack + i, needle, needle_length - 1) == 0) {
+            return haystack + i;
+        }
+        i += skip[ch];
+    }
+    return NULL;
+}
+
+#ifndef SEARCH_X86
+// Without SIMD, long needles skip faster than memchr can filter; the
+// skip table only pays off over a decent stretch of text
+static const char* find_portable(const char* haystack, size_t length, const char* needle, size_t needle_length) {
+    if (needle_length >= SEARCH_HORSPOOL_MIN && length >= needle_length * 64) {
+        return find_horspool(haystack, length, needle, needle_length);
+    }
+    return find_scalar(haystack, length, needle, needle_length);
+}
+#endif
+
+static SearchKernel select_kernel(void) {
+#ifdef SEARCH_X86
+    if (__builtin_cpu_supports("avx2")) return find_avx2;
+    return find_sse2;
+#else
+    return find_portable;
+#endif
+}
+
+static SearchKernel kernel = NULL;
+
+// Pool workers can get here before the main thread does. Whoever wins
+// the race stores the same pointer, so relaxed atomics are all it takes.
+static SearchKernel get_kernel(void) {
+    SearchKernel chosen = __atomic_load_n(&kernel, __ATOMIC_RELAXED);
+    if (!chosen) {
+        chosen = select_kernel();
+        __atomic_store_n(&kernel, chosen, __ATOMIC_RELAXED);
+    }
+    return chosen;
+}
+
+const char* search_memory(const char* haystack, size_t length, const char* needle, size_t needle_length) {
+    if (needle_length == 0 || needle_length > length) return NULL;
+    if (needle_length == 1) return (const char*)memchr(haystack, needle[0], length);
+    return get_kernel()(haystack, length, needle, needle_length);
+}
+
+int search_use_kernel(int kind) {
+    SearchKernel chosen;
+    switch (kind) {
+        case SEARCH_AUTO:
+            chosen = select_kernel();
+            break;
+        case SEARCH_SCALAR:
+            chosen = find_scalar;
+            break;
+        case SEARCH_HORSPOOL:
+            chosen = find_horspool;
+            break;
+#ifdef SEARCH_X86
+        case SEARCH_SSE2:
+            chosen = find_sse2;
+            break;
+        case SEARCH_AVX2:
+            if (!__builtin_cpu_supports("avx2")) return 0;
+            chosen = find_avx2;
+            break;
+#endif
+        default:
+            return 0;
+    }
+    __atomic_store_n(&kernel, chosen, __ATOMIC_RELAXED);
+    return 1;
+}
+
+// Walks the document one piece at a time. The last needle_length - 1 bytes
+// seen are kept so a match split between two pieces is still found.
+typedef struct {
+    const char* needle;
+    size_t length;
+    size_t offset;       // document offset of the next piece
+    size_t limit;        // matches starting past this are not wanted
+    char window[2 * SEARCH_MAX_QUERY];
+    size_t carried;
+    long long found;
+} SearchScan;
+
+static int search_visit(void* context, const char* data, size_t length) {
+    SearchScan* scan = (SearchScan*)context;
+    size_t keep = scan->length - 1;
+
+    if (scan->carried > 0) {
+        size_t head = length < keep ? length : keep;
+        memcpy(scan->window + scan->carried, data, head);
+        const char* hit = search_memory(scan->window, scan->carried + head, scan->needle, scan->length);
+        if (hit) {
+            scan->found = (long long)(scan->offset - scan->carried + (hit - scan->window));
+            return 0;
+        }
+    }
+
+    const char* hit = search_memory(data, length, scan->needle, scan->length);
+    if (hit) {
+        scan->found = (long long)(scan->offset + (hit - data));
+        return 0;
+    }
+
+    // Carry the tail of everything seen so far into the next piece
+    if (length >= keep) {
+        memcpy(scan->window, data + length - keep, keep);
+        scan->carried = keep;
+    } else {
+        size_t total = scan->carried + length;
+        size_t from = total > keep ? total - keep : 0;
+        memmove(scan->window, scan->window + from, scan->carried - from);
+        memcpy(scan->window + scan->carried - from, data, length);
+        scan->carried = total - from;
+    }
+
+    // Stop once no match starting at or before the limit can still end
+    scan->offset += length;
+    return scan->offset < scan->limit + scan->length;
+}
+
+static long long search_range(const PieceTable* table, size_t from, size_t limit, const char* needle, size_t length) {
+    SearchScan scan;
+    scan.needle = needle;
+    scan.length = length;
+    scan.offset = from;
+    scan.limit = limit;
+    scan.carried = 0;
+    scan.found = -1;
+
+    piece_table_for_each_from(table, from, search_visit, &scan);
+    return scan.found >= 0 && (size_t)scan.found <= limit ? scan.found : -1;
+}
+
+long long search_document(const PieceTable* table, size_t from, const char* needle, size_t length) {
+    size_t total = piece_table_length(table);
+    if (length == 0 || length > SEARCH_MAX_QUERY || length > total) return -1;
+    if (from > total) from = total;
+
+    long long found = search_range(table, from, total, needle, length);
+    if (found < 0 && from > 0) {
+        found = search_range(table, 0, from - 1, needle, length);
+    }
+    return found;
+}
+
+// Regular expressions never match across lines, so the document is fed to
+// the matcher a line at a time. Lines that lie within one piece are matched
+// in place; the few that straddle pieces are assembled in a scratch buffer.
+typedef struct {
+    size_t* ranges;      // [start, end) pairs
+    size_t count;
+    size_t capacity;
+} SearchRanges;
+
+static int ranges_add(SearchRanges* all, size_t start, size_t end) {
+    if (all->count == all->capacity) {
+        size_t new_capacity = all->capacity ? all->capacity * 2 : 64;
+        size_t* grown = (size_t*)realloc(all->ranges, new_capacity * 2 * sizeof(size_t));
+        if (!grown) return 0;
+        all->ranges = grown;
+        all->capacity = new_capacity;
+    }
+    all->ranges[2 * all->count] = start;
+    all->ranges[2 * all->count + 1] = end;
+    all->count++;
+    return 1;
+}
+
+typedef struct {
+    Regexp* pattern;
+    SearchRanges* all;   // collect every match instead of stopping at one
+    int failed;
+    size_t offset;       // document offset of the next piece
+    size_t line_start;   // document offset of the line being read
+    size_t from;
+    size_t limit;
+    char* line;
+    size_t line_length;
+    size_t line_capacity;
+    long long found;
+    size_t found_end;
+} RegexpScan;
+
+static int regexp_append(RegexpScan* scan, const char* data, size_t length) {
+    if (scan->line_length + length > scan->line_capacity) {
+        size_t new_capacity = scan->line_capacity ? scan->line_capacity : 256;
+        while (new_capacity < scan->line_length + length) {
+            new_capacity *= 2;
+        }
+        char* grown = (char*)realloc(scan->line, new_capacity);
+        if (!grown) return 0;
+        scan->line = grown;
+        scan->line_capacity = new_capacity;
+    }
+    memcpy(scan->line + scan->line_length, data, length);
+    scan->line_length += length;
+    return 1;
+}
+
+// Match one line; returns 0 once the scan is over. A '\r' before the line
+// break is not part of the line, as in buffer_get_line.
+static int regexp_line(RegexpScan* scan, const char* text, size_t length, int terminated) {
+    if (scan->line_start > scan->limit) return 0;
+    if (terminated && length > 0 && text[length - 1] == '\r') length--;
+
+    size_t column = scan->from > scan->line_start ? scan->from - scan->line_start : 0;
+    size_t start, end;
+    if (scan->all) {
+        while (column <= length && regexp_search(scan->pattern, text, length, column, &start, &end)) {
+            if (!ranges_add(scan->all, scan->line_start + start, scan->line_start + end)) {
+                scan->failed = 1;
+                return 0;
+            }
+            column = end > start ? end : start + 1;
+        }
+        return 1;
+    }
+    if (column <= length && regexp_search(scan->pattern, text, length, column, &start, &end)) {
+        if (scan->line_start + start <= scan->limit) {
+            scan->found = (long long)(scan->line_start + start);
+            scan->found_end = scan->line_start + end;
+        }
+        return 0;
+    }
+    return 1;
+}
+
+static int regexp_visit(void* context, const char* data, size_t length) {
+    RegexpScan* scan = (RegexpScan*)context;
+    const char* end = data + length;
+
+    while (data < end) {
+        const char* newline = (const char*)memchr(data, '\n', end - data);
+        if (!newline) {
+            scan->offset += end - data;
+            return regexp_append(scan, data, end - data);
+        }
+
+        size_t part = newline - data;
+        int more;
+        if (scan->line_length == 0) {
+            more = regexp_line(scan, data, part, 1);
+        } else {
+            if (!regexp_append(scan, data, part)) return 0;
+            more = regexp_line(scan, scan->line, scan->line_length, 1);
+            scan->line_length = 0;
+        }
+        scan->offset += part + 1;
+        scan->line_start = scan->offset;
+        if (!more) return 0;
+        data = newline + 1;
+    }
+    return 1;
+}
+
+static long long search_range_regexp(Regexp* pattern, const PieceTable* table, size_t from, size_t limit, size_t* end) {
+    RegexpScan scan;
+    memset(&scan, 0, sizeof(scan));
+    scan.pattern = pattern;
+    scan.from = from;
+    scan.limit = limit;
+    scan.found = -1;
+
+    // Start at the beginning of the line so ^ and the match start are
+    // judged against the whole line
+    scan.offset = piece_table_line_start(table, piece_table_line_at(table, from));
+    scan.line_start = scan.offset;
+
+    // The last line has no line break to end it
+    if (piece_table_for_each_from(table, scan.offset, regexp_visit, &scan)) {
+        regexp_line(&scan, scan.line, scan.line_length, 0);
+    }
+    free(scan.line);
+    *end = scan.found_end;
+    return scan.found;
+}
+
+long long search_document_regexp(Regexp* pattern, const PieceTable* table, size_t from, size_t* end) {
+    size_t total = piece_table_length(table);
+    if (!pattern) return -1;
+    if (from > total) from = total;
+
+    long long found = search_range_regexp(pattern, table, from, total, end);
+    if (found < 0 && from > 0) {
+        found = search_range_regexp(pattern, table, 0, from - 1, end);
+    }
+    return found;
+}
+
+// Compile the query as it stands and look for it from the origin
+static long long search_regexp_query(Search* search, const PieceTable* table) {
+    regexp_free(search->pattern);
+    search->pattern = NULL;
+
+    if (search->length == 0) {
+        search->found[0] = (long long)search->origin;
+        return search->found[0];
+    }
+    search->pattern = regexp_compile(search->query, search->length, NULL);
+    search->found[search->length] = search_document_regexp(search->pattern, table, search->origin, &search->found_end);
+    return search->found[search->length];
+}
+
+// Restart the background count for the query as it stands. With no
+// match in the whole document there is nothing to count.
+static long long search_count_all(Search* search, const PieceTable* table) {
+    long long current = search_current(search);
+    if (!search->pool) return current;
+
+    if (search->length == 0 || current < 0) {
+        search_pool_cancel(search->pool);
+    } else {
+        search_pool_start(search->pool, table, search->query, search->length, search->regexp);
+    }
+    return current;
+}
+
+void search_begin(Search* search, size_t origin) {
+    search->query[0] = '\0';
+    search->length = 0;
+    search->replacement[0] = '\0';
+    search->replacement_length = 0;
+    search->replacing = 0;
+    search->origin = origin;
+    search->found[0] = (long long)origin;
+    regexp_free(search->pattern);
+    search->pattern = NULL;
+}
+
+void search_free(Search* search) {
+    regexp_free(search->pattern);
+    search->pattern = NULL;
+    search_pool_destroy(search->pool);
+    search->pool = NULL;
+}
+
+long long search_type(Search* search, const PieceTable* table, char ch) {
+    if (search->length >= SEARCH_MAX_QUERY) return search_current(search);
+
+    long long previous = search->found[search->length];
+    search->query[search->length++] = ch;
+    search->query[search->length] = '\0';
+    if (search->regexp) {
+        search_regexp_query(search, table);
+        return search_count_all(search, table);
+    }
+
+    // Every match of the longer query is a match of the shorter one, so
+    // the search picks up at the match already found; without one there
+    // is nothing to look for
+    if (previous < 0) {
+        search->found[search->length] = -1;
+    } else {
+        search->found[search->length] = search_document(table, (size_t)previous, search->query, search->length);
+    }
+    return search_count_all(search, table);
+}
+
+long long search_erase(Search* search, const PieceTable* table) {
+    if (search->length > 0) {
+        search->query[--search->length] = '\0';
+    }
+    if (search->regexp) search_regexp_query(search, table);
+    return search_count_all(search, table);
+}
+
+long long search_next(Search* search, const PieceTable* table) {
+    long long current = search_current(search);
+    if (search->length == 0 || current < 0) return current;
+
+    // The next match starts after this one, as in the pool's count
+    if (search->regexp) {
+        size_t from = search->found_end > (size_t)current ? search->found_end : (size_t)current + 1;
+        search->found[search->length] = search_document_regexp(search->pattern, table, from, &search->found_end);
+    } else {
+        search->found[search->length] = search_document(table, (size_t)current + search->length, search->query, search->length);
+    }
+    return search->found[search->length];
+}
+
+// Switch between literal and regular expression search, keeping the query
+long long search_toggle_regexp(Search* search, const PieceTable* table) {
+    search->regexp = !search->regexp;
+    if (search->regexp) {
+        search_regexp_query(search, table);
+        return search_count_all(search, table);
+    }
+
+    regexp_free(search->pattern);
+    search->pattern = NULL;
+
+    // Literal matches build on each other, so redo them prefix by prefix
+    for (int i = 1; i <= search->length; i++) {
+        long long previous = search->found[i - 1];
+        search->found[i] = previous < 0 ? -1 : search_document(table, (size_t)previous, search->query, i);
+    }
+    return search_count_all(search, table);
+}
+
+// Match for the query as it stands; with an empty query, the origin
+long long search_current(const Search* search) {
+    return search->found[search->length];
+}
+
+// Stop counting; must be called before the document changes
+void search_end(Search* search) {
+    if (search->pool) search_pool_cancel(search->pool);
+}
+
+// Take in matches counted since the last poll; returns 1 if there were any
+int search_poll(Search* search) {
+    return search->pool ? search_pool_poll(search->pool) : 0;
+}
+
+int search_running(const Search* search) {
+    return search->pool ? search_pool_running(search->pool) : 0;
+}
+
+// Where the current match stands among those counted so far: *index is
+// 1-based, 0 if it has not been counted yet. Returns 0 without a count.
+int search_count(const Search* search, size_t* index, size_t* total) {
+    long long current = search_current(search);
+    if (!search->pool || search->length == 0 || current < 0) return 0;
+
+    const long long* matches = search_pool_matches(search->pool, total);
+    size_t low = 0;
+    size_t high = *total;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (matches[mid] <= current) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    *index = low > 0 && matches[low - 1] == current ? low : 0;
+    return 1;
+}
+
+// Every match in the document, first to last and not overlapping, as
+// [start, end) pairs in a malloc'd array. NULL if the query is empty or
+// memory runs out.
+size_t* search_find_all(const Search* search, const PieceTable* table, size_t* count) {
+    SearchRanges all = { NULL, 0, 0 };
+    size_t total = piece_table_length(table);
+    *count = 0;
+
+    if (search->length == 0) return NULL;
+    if (search->regexp) {
+        if (!search->pattern) return NULL;
+
+        // One pass with the line scan, which collects instead of stopping
+        RegexpScan scan;
+        memset(&scan, 0, sizeof(scan));
+        scan.pattern = search->pattern;
+        scan.all = &all;
+        scan.limit = total;
+        if (piece_table_for_each(table, regexp_visit, &scan)) {
+            regexp_line(&scan, scan.line, scan.line_length, 0);
+        }
+        free(scan.line);
+        if (scan.failed) {
+            free(all.ranges);
+            return NULL;
+        }
+    } else {
+        long long start;
+        size_t from = 0;
+        while ((start = search_range(table, from, total, search->query, search->length)) >= 0) {
+            if (!ranges_add(&all, (size_t)start, (size_t)start + search->length)) {
+                free(all.ranges);
+                return NULL;
+            }
+            from = (size_t)start + search->length;
+        }
+    }
+
+    // An empty array still tells "no matches" apart from failure
+    if (!all.ranges) all.ranges = (size_t*)malloc(2 * sizeof(size_t));
+    *count = all.count;
+    return all.ranges;
+}
\ No newline at end of file
@@ -0,0 +1,517 @@
+#include "search_pool.h"
+#include "search.h"
+#include "platform.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef PLATFORM_UNIX
+#include <pthread.h>
+#endif
+
+// A piece of the document as it was when the search started
+typedef struct {
+    const char* data;
+    size_t length;
+    size_t offset;       // document offset of data[0]
+} SearchSpan;
+
+// Whole lines [start, end) of the document and the matches found there
+typedef struct {
+    size_t start;
+    size_t end;
+    long long* matches;
+    size_t count;
+    size_t capacity;
+    int done;
+} SearchChunk;
+
+// What one worker keeps between chunks: its own compiled pattern, since a
+// Regexp caches DFA states as it runs, and room to assemble lines
+typedef struct {
+    Regexp* pattern;
+    unsigned int job;
+    char* line;
+    size_t line_length;
+    size_t line_capacity;
+} SearchWorker;
+
+struct SearchPool {
+    int worker_count;
+    int shutdown;
+    int active;              // a search is running or has chunks to merge
+    int cancel;              // read by workers without the lock
+    unsigned int job;
+    char query[SEARCH_MAX_QUERY + 1];
+    size_t length;
+    int regexp;
+    size_t total;
+    SearchSpan* spans;
+    size_t span_count;
+    size_t span_capacity;
+    SearchChunk* chunks;
+    size_t chunk_count;
+    size_t next_chunk;       // next chunk to hand to a worker
+    size_t merged;           // chunks already moved into matches
+    int busy;                // workers inside a chunk
+    long long* matches;      // merged results, in document order
+    size_t match_count;
+    size_t match_capacity;
+#ifdef PLATFORM_UNIX
+    pthread_t workers[SEARCH_POOL_MAX_WORKERS];
+    pthread_mutex_t lock;
+    pthread_cond_t work;     // chunks are waiting, or the pool shuts down
+    pthread_cond_t idle;     // a worker finished a chunk
+#endif
+};
+
+static void search_pool_lock(SearchPool* pool) {
+#ifdef PLATFORM_UNIX
+    pthread_mutex_lock(&pool->lock);
+#else
+    (void)pool;
+#endif
+}
+
+static void search_pool_unlock(SearchPool* pool) {
+#ifdef PLATFORM_UNIX
+    pthread_mutex_unlock(&pool->lock);
+#else
+    (void)pool;
+#endif
+}
+
+static int cancelled(SearchPool* pool) {
+    return __atomic_load_n(&pool->cancel, __ATOMIC_RELAXED);
+}
+
+static int chunk_add(SearchChunk* chunk, size_t offset) {
+    if (chunk->count == chunk->capacity) {
+        size_t new_capacity = chunk->capacity ? chunk->capacity * 2 : 64;
+        long long* grown = (long long*)realloc(chunk->matches, new_capacity * sizeof(long long));
+        if (!grown) return 0;
+        chunk->matches = grown;
+        chunk->capacity = new_capacity;
+    }
+    chunk->matches[chunk->count++] = (long long)offset;
+    return 1;
+}
+
+// First span that ends after offset
+static size_t span_find(const SearchPool* pool, size_t offset) {
+    size_t low = 0;
+    size_t high = pool->span_count;
+
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (pool->spans[mid].offset + pool->spans[mid].length <= offset) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+// Literal matches do not overlap. The last length - 1 bytes of each span
+// are carried over to catch a match split between two spans.
+static void search_literal_chunk(SearchPool* pool, SearchChunk* chunk) {
+    size_t length = pool->length;
+    size_t keep = length - 1;
+    char window[2 * SEARCH_MAX_QUERY];
+    size_t carried = 0;
+    size_t allowed = chunk->start;
+
+    for (size_t i = span_find(pool, chunk->start); i < pool->span_count && pool->spans[i].offset < chunk->end; i++) {
+        if (cancelled(pool)) return;
+
+        const SearchSpan* span = &pool->spans[i];
+        size_t from = span->offset > chunk->start ? span->offset : chunk->start;
+        size_t to = span->offset + span->length < chunk->end ? span->offset + span->length : chunk->end;
+        const char* data = span->data + (from - span->offset);
+        size_t size = to - from;
+        const char* hit;
+
+        if (carried > 0) {
+            size_t head = size < keep ? size : keep;
+            memcpy(window + carried, data, head);
+
+            const char* p = window;
+            const char* end = window + carried + head;
+            while ((hit = search_memory(p, end - p, pool->query, length)) != NULL) {
+                size_t at = from - carried + (hit - window);
+                if (at >= from) break;
+                if (at >= allowed) {
+                    if (!chunk_add(chunk, at)) return;
+                    allowed = at + length;
+                }
+                p = hit + 1;
+            }
+        }
+
+        const char* p = data + (allowed > from ? (allowed - from < size ? allowed - from : size) : 0);
+        const char* end = data + size;
+        while ((hit = search_memory(p, end - p, pool->query, length)) != NULL) {
+            size_t at = from + (hit - data);
+            if (!chunk_add(chunk, at)) return;
+            allowed = at + length;
+            p = hit + length;
+        }
+
+        if (size >= keep) {
+            memcpy(window, data + size - keep, keep);
+            carried = keep;
+        } else {
+            size_t total = carried + size;
+            size_t drop = total > keep ? total - keep : 0;
+            memmove(window, window + drop, carried - drop);
+            memcpy(window + carried - drop, data, size);
+            carried = total - drop;
+        }
+    }
+}
+
+static int search_line(SearchWorker* worker, SearchChunk* chunk, size_t line_start, const char* text, size_t length, int terminated) {
+    size_t from = 0;
+    size_t start, end;
+
+    if (terminated && length > 0 && text[length - 1] == '\r') length--;
+    while (from <= length && regexp_search(worker->pattern, text, length, from, &start, &end)) {
+        if (!chunk_add(chunk, line_start + start)) return 0;
+        from = end > start ? end : start + 1;
+    }
+    return 1;
+}
+
+static int worker_append(SearchWorker* worker, const char* data, size_t length) {
+    if (worker->line_length + length > worker->line_capacity) {
+        size_t new_capacity = worker->line_capacity ? worker->line_capacity : 256;
+        while (new_capacity < worker->line_length + length) {
+            new_capacity *= 2;
+        }
+        char* grown = (char*)realloc(worker->line, new_capacity);
+        if (!grown) return 0;
+        worker->line = grown;
+        worker->line_capacity = new_capacity;
+    }
+    memcpy(worker->line + worker->line_length, data, length);
+    worker->line_length += length;
+    return 1;
+}
+
+// Regular expressions go line by line; lines split between spans are
+// assembled first
+static void search_regexp_chunk(SearchPool* pool, SearchWorker* worker, SearchChunk* chunk) {
+    size_t line_start = chunk->start;
+    worker->line_length = 0;
+
+    for (size_t i = span_find(pool, chunk->start); i < pool->span_count && pool->spans[i].offset < chunk->end; i++) {
+        const SearchSpan* span = &pool->spans[i];
+        size_t from = span->offset > chunk->start ? span->offset : chunk->start;
+        size_t to = span->offset + span->length < chunk->end ? span->offset + span->length : chunk->end;
+        const char* data = span->data + (from - span->offset);
+        const char* end = data + (to - from);
+
+        while (data < end) {
+            if (cancelled(pool)) return;
+
+            const char* newline = (const char*)memchr(data, '\n', end - data);
+            if (!newline) {
+                if (!worker_append(worker, data, end - data)) return;
+                break;
+            }
+
+            size_t part = newline - data;
+            size_t line_length = worker->line_length + part;
+            int ok;
+            if (worker->line_length == 0) {
+                ok = search_line(worker, chunk, line_start, data, part, 1);
+            } else {
+                ok = worker_append(worker, data, part) &&
+                     search_line(worker, chunk, line_start, worker->line, worker->line_length, 1);
+                worker->line_length = 0;
+            }
+            if (!ok) return;
+
+            line_start += line_length + 1;
+            data = newline + 1;
+        }
+    }
+
+    // Only the last chunk ends without a line break
+    if (chunk->end == pool->total) {
+        search_line(worker, chunk, line_start, worker->line, worker->line_length, 0);
+    }
+}
+
+static void search_chunk(SearchPool* pool, SearchWorker* worker, SearchChunk* chunk, unsigned int job) {
+    if (!pool->regexp) {
+        search_literal_chunk(pool, chunk);
+        return;
+    }
+
+    if (!worker->pattern || worker->job != job) {
+        regexp_free(worker->pattern);
+        worker->pattern = regexp_compile(pool->query, pool->length, NULL);
+        worker->job = job;
+    }
+    if (worker->pattern) {
+        search_regexp_chunk(pool, worker, chunk);
+    }
+}
+
+#ifdef PLATFORM_UNIX
+static void* search_pool_worker(void* arg) {
+    SearchPool* pool = (SearchPool*)arg;
+    SearchWorker worker;
+    memset(&worker, 0, sizeof(worker));
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->shutdown && !(pool->active && !pool->cancel && pool->next_chunk < pool->chunk_count)) {
+            pthread_cond_wait(&pool->work, &pool->lock);
+        }
+        if (pool->shutdown) break;
+
+        SearchChunk* chunk = &pool->chunks[pool->next_chunk++];
+        unsigned int job = pool->job;
+        pool->busy++;
+        pthread_mutex_unlock(&pool->lock);
+
+        search_chunk(pool, &worker, chunk, job);
+
+        pthread_mutex_lock(&pool->lock);
+        chunk->done = 1;
+        pool->busy--;
+        pthread_cond_broadcast(&pool->idle);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    regexp_free(worker.pattern);
+    free(worker.line);
+    return NULL;
+}
+#endif
+
+static int add_span(void* context, const char* data, size_t length) {
+    SearchPool* pool = (SearchPool*)context;
+
+    if (pool->span_count == pool->span_capacity) {
+        size_t new_capacity = pool->span_capacity ? pool->span_capacity * 2 : 64;
+        SearchSpan* grown = (SearchSpan*)realloc(pool->spans, new_capacity * sizeof(SearchSpan));
+        if (!grown) return 0;
+        pool->spans = grown;
+        pool->span_capacity = new_capacity;
+    }
+
+    SearchSpan* span = &pool->spans[pool->span_count];
+    span->data = data;
+    span->length = length;
+    span->offset = pool->span_count ? span[-1].offset + span[-1].length : 0;
+    pool->span_count++;
+    return 1;
+}
+
+// Drop the finished or cancelled search's chunks; no worker may be in one
+static void search_pool_release(SearchPool* pool) {
+    for (size_t i = 0; i < pool->chunk_count; i++) {
+        free(pool->chunks[i].matches);
+    }
+    free(pool->chunks);
+    pool->chunks = NULL;
+    pool->chunk_count = 0;
+    pool->span_count = 0;
+}
+
+SearchPool* search_pool_create(int workers) {
+    SearchPool* pool = (SearchPool*)calloc(1, sizeof(SearchPool));
+    if (!pool) return NULL;
+
+    if (workers > SEARCH_POOL_MAX_WORKERS) workers = SEARCH_POOL_MAX_WORKERS;
+#ifdef PLATFORM_UNIX
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+    for (int i = 0; i < workers; i++) {
+        if (pthread_create(&pool->workers[i], NULL, search_pool_worker, pool) != 0) break;
+        pool->worker_count++;
+    }
+#else
+    // No worker threads here: searches run to completion when started
+    (void)workers;
+#endif
+    return pool;
+}
+
+void search_pool_destroy(SearchPool* pool) {
+    if (!pool) return;
+
+    search_pool_cancel(pool);
+#ifdef PLATFORM_UNIX
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->worker_count; i++) {
+        pthread_join(pool->workers[i], NULL);
+    }
+    pthread_cond_destroy(&pool->idle);
+    pthread_cond_destroy(&pool->work);
+    pthread_mutex_destroy(&pool->lock);
+#endif
+    free(pool->spans);
+    free(pool->matches);
+    free(pool);
+}
+
+// Look for every match of the query. The document is split into chunks of
+// whole lines which the workers take in order; search_pool_poll merges the
+// results as the chunks finish. Cancels whatever search was running.
+int search_pool_start(SearchPool* pool, const PieceTable* table, const char* query, size_t length, int regexp) {
+    search_pool_cancel(pool);
+    if (length == 0 || length > SEARCH_MAX_QUERY) return 0;
+
+    memcpy(pool->query, query, length);
+    pool->query[length] = '\0';
+    pool->length = length;
+    pool->regexp = regexp;
+    pool->total = piece_table_length(table);
+
+    size_t capacity = pool->total / SEARCH_POOL_CHUNK + 1;
+    pool->chunks = (SearchChunk*)calloc(capacity, sizeof(SearchChunk));
+    if (!pool->chunks || !piece_table_for_each(table, add_span, pool)) {
+        search_pool_release(pool);
+        return 0;
+    }
+
+    size_t start = 0;
+    for (size_t i = 1; i < capacity; i++) {
+        size_t at = piece_table_line_start(table, piece_table_line_at(table, i * SEARCH_POOL_CHUNK));
+        if (at > start && at < pool->total) {
+            pool->chunks[pool->chunk_count].start = start;
+            pool->chunks[pool->chunk_count].end = at;
+            pool->chunk_count++;
+            start = at;
+        }
+    }
+    pool->chunks[pool->chunk_count].start = start;
+    pool->chunks[pool->chunk_count].end = pool->total;
+    pool->chunk_count++;
+
+    pool->next_chunk = 0;
+    pool->merged = 0;
+    pool->match_count = 0;
+    pool->job++;
+
+    search_pool_lock(pool);
+    pool->active = 1;
+    search_pool_unlock(pool);
+
+#ifdef PLATFORM_UNIX
+    if (pool->worker_count > 0) {
+        pthread_mutex_lock(&pool->lock);
+        pthread_cond_broadcast(&pool->work);
+        pthread_mutex_unlock(&pool->lock);
+        return 1;
+    }
+#endif
+
+    // Without workers the caller's thread does it all
+    SearchWorker worker;
+    memset(&worker, 0, sizeof(worker));
+    for (; pool->next_chunk < pool->chunk_count; pool->next_chunk++) {
+        search_chunk(pool, &worker, &pool->chunks[pool->next_chunk], pool->job);
+        pool->chunks[pool->next_chunk].done = 1;
+    }
+    regexp_free(worker.pattern);
+    free(worker.line);
+    return 1;
+}
+
+// Stop the running search. Returns once no worker reads the document.
+void search_pool_cancel(SearchPool* pool) {
+    search_pool_lock(pool);
+    if (pool->active) {
+        __atomic_store_n(&pool->cancel, 1, __ATOMIC_RELAXED);
+#ifdef PLATFORM_UNIX
+        while (pool->busy > 0) {
+            pthread_cond_wait(&pool->idle, &pool->lock);
+        }
+#endif
+        pool->active = 0;
+        __atomic_store_n(&pool->cancel, 0, __ATOMIC_RELAXED);
+    }
+    search_pool_unlock(pool);
+
+    search_pool_release(pool);
+    pool->match_count = 0;
+}
+
+// Move the matches of finished chunks into the match list, in document
+// order: a chunk is only merged after every chunk before it. Returns 1 if
+// the list grew or the search finished.
+int search_pool_poll(SearchPool* pool) {
+    if (!pool->active) return 0;
+
+    size_t ready = pool->merged;
+    search_pool_lock(pool);
+    while (ready < pool->chunk_count && pool->chunks[ready].done) {
+        ready++;
+    }
+    search_pool_unlock(pool);
+
+    int changed = 0;
+    for (; pool->merged < ready; pool->merged++) {
+        SearchChunk* chunk = &pool->chunks[pool->merged];
+        if (chunk->count == 0) continue;
+
+        if (pool->match_count + chunk->count > pool->match_capacity) {
+            size_t new_capacity = pool->match_capacity ? pool->match_capacity : 1024;
+            while (new_capacity < pool->match_count + chunk->count) {
+                new_capacity *= 2;
+            }
+            long long* grown = (long long*)realloc(pool->matches, new_capacity * sizeof(long long));
+            if (!grown) break;
+            pool->matches = grown;
+            pool->match_capacity = new_capacity;
+        }
+        memcpy(pool->matches + pool->match_count, chunk->matches, chunk->count * sizeof(long long));
+        pool->match_count += chunk->count;
+        free(chunk->matches);
+        chunk->matches = NULL;
+        changed = 1;
+    }
+
+    // Every chunk is in, so no worker will look at this search again
+    if (pool->merged == pool->chunk_count) {
+        search_pool_lock(pool);
+        pool->active = 0;
+        search_pool_unlock(pool);
+        search_pool_release(pool);
+        changed = 1;
+    }
+    return changed;
+}
+
+// Block until the running search has finished
+int search_pool_wait(SearchPool* pool) {
+#ifdef PLATFORM_UNIX
+    pthread_mutex_lock(&pool->lock);
+    while (pool->active && pool->busy + (pool->chunk_count - pool->next_chunk) > 0) {
+        pthread_cond_wait(&pool->idle, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+#endif
+    while (pool->active) {
+        search_pool_poll(pool);
+    }
+    return 1;
+}
+
+int search_pool_running(const SearchPool* pool) {
+    return pool->active;
+}
+
+const long long* search_pool_matches(const SearchPool* pool, size_t* count) {
+    *count = pool->match_count;
+    return pool->matches;
+}
\ No newline at end of file
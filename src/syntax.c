@@ -0,0 +1,535 @@
+#include "syntax.h"
+#include <ctype.h>
+
+// Mark text[from, to) as one highlight class; classes may be NULL when
+// only the state at the end of the line is wanted
+static void mark(unsigned char* classes, int from, int to, int class) {
+    if (classes && to > from) memset(classes + from, class, to - from);
+}
+
+static int is_word(char c) {
+    return isalnum((unsigned char)c) || c == '_';
+}
+
+static int word_in(const char* word, int length, const char* const* list) {
+    for (; *list; list++) {
+        if ((int)strlen(*list) == length && memcmp(*list, word, length) == 0) return 1;
+    }
+    return 0;
+}
+
+static int word_in_nocase(const char* word, int length, const char* const* list) {
+    for (; *list; list++) {
+        if ((int)strlen(*list) != length) continue;
+
+        int i = 0;
+        while (i < length && toupper((unsigned char)word[i]) == (*list)[i]) i++;
+        if (i == length) return 1;
+    }
+    return 0;
+}
+
+// End of a number starting at text[i]: digits, a point, an exponent with
+// its sign, and suffix or hex letters all belong to it
+static int number_end(const char* text, int length, int i) {
+    while (i < length) {
+        char c = text[i];
+        if ((c == '+' || c == '-') && i > 0 && (text[i - 1] == 'e' || text[i - 1] == 'E' ||
+                                                text[i - 1] == 'p' || text[i - 1] == 'P')) {
+            i++;
+        } else if (is_word(c) || c == '.') {
+            i++;
+        } else {
+            break;
+        }
+    }
+    return i;
+}
+
+// End of a quoted string whose opening quote is at text[i] - 1, just past
+// the closing quote, or length if the line ends first
+static int string_end(const char* text, int length, int i, char quote) {
+    while (i < length && text[i] != quote) {
+        i += text[i] == '\\' ? 2 : 1;
+    }
+    return i < length ? i + 1 : length;
+}
+
+// C and C++. A comment or string can run on to the next line, and so can
+// a preprocessor line ending in a backslash.
+#define C_NORMAL 0
+#define C_COMMENT 1
+#define C_STRING 2
+#define C_DIRECTIVE 3
+
+static const char* const c_keywords[] = {
+    "break", "case", "continue", "default", "do", "else", "for", "goto", "if", "return",
+    "sizeof", "switch", "while", "typedef", "extern", "static", "inline", "register",
+    "restrict", "volatile", "const", "struct", "union", "enum", "auto", "true", "false",
+    "NULL", "nullptr", "class", "namespace", "template", "typename", "public", "private",
+    "protected", "virtual", "new", "delete", "this", "using", "operator", "try", "catch",
+    "throw", NULL
+};
+
+static const char* const c_types[] = {
+    "void", "char", "short", "int", "long", "float", "double", "signed", "unsigned",
+    "_Bool", "bool", "size_t", "ssize_t", "ptrdiff_t", "FILE", NULL
+};
+
+static int c_continues(const char* text, int length) {
+    return length > 0 && text[length - 1] == '\\';
+}
+
+static int lex_c(int state, const char* text, int length, unsigned char* classes) {
+    int i = 0;
+    int directive = state == C_DIRECTIVE;
+
+    if (state == C_COMMENT) {
+        while (i + 1 < length && !(text[i] == '*' && text[i + 1] == '/')) i++;
+        if (i + 1 >= length) {
+            mark(classes, 0, length, HIGHLIGHT_COMMENT);
+            return C_COMMENT;
+        }
+        i += 2;
+        mark(classes, 0, i, HIGHLIGHT_COMMENT);
+    } else if (state == C_STRING) {
+        i = string_end(text, length, 0, '"');
+        mark(classes, 0, i, HIGHLIGHT_STRING);
+        if (i == length && c_continues(text, length)) return C_STRING;
+    } else if (!directive) {
+        int first = 0;
+        while (first < length && (text[first] == ' ' || text[first] == '\t')) first++;
+        directive = first < length && text[first] == '#';
+    }
+
+    int plain = directive ? HIGHLIGHT_DIRECTIVE : HIGHLIGHT_PLAIN;
+    while (i < length) {
+        char c = text[i];
+        char next = i + 1 < length ? text[i + 1] : '\0';
+        int end;
+
+        if (c == '/' && next == '/') {
+            mark(classes, i, length, HIGHLIGHT_COMMENT);
+            return C_NORMAL;
+        } else if (c == '/' && next == '*') {
+            end = i + 2;
+            while (end + 1 < length && !(text[end] == '*' && text[end + 1] == '/')) end++;
+            if (end + 1 >= length) {
+                mark(classes, i, length, HIGHLIGHT_COMMENT);
+                return C_COMMENT;
+            }
+            end += 2;
+            mark(classes, i, end, HIGHLIGHT_COMMENT);
+        } else if (c == '"' || c == '\'') {
+            end = string_end(text, length, i + 1, c);
+            mark(classes, i, end, HIGHLIGHT_STRING);
+            if (c == '"' && end == length && c_continues(text, length)) {
+                return C_STRING;
+            }
+        } else if (isdigit((unsigned char)c) || (c == '.' && isdigit((unsigned char)next))) {
+            end = number_end(text, length, i);
+            mark(classes, i, end, HIGHLIGHT_NUMBER);
+        } else if (is_word(c)) {
+            end = i;
+            while (end < length && is_word(text[end])) end++;
+            int class = plain;
+            if (directive) {
+                class = HIGHLIGHT_DIRECTIVE;
+            } else if (word_in(text + i, end - i, c_keywords)) {
+                class = HIGHLIGHT_KEYWORD;
+            } else if (word_in(text + i, end - i, c_types) ||
+                       (end - i > 2 && text[end - 2] == '_' && text[end - 1] == 't')) {
+                class = HIGHLIGHT_TYPE;
+            }
+            mark(classes, i, end, class);
+        } else {
+            end = i + 1;
+            mark(classes, i, end, plain);
+        }
+        i = end;
+    }
+    return directive && c_continues(text, length) ? C_DIRECTIVE : C_NORMAL;
+}
+
+// JSON strings cannot span lines, so every line starts afresh. A string
+// followed by a colon is an object key.
+static const char* const json_literals[] = { "true", "false", "null", NULL };
+
+static int lex_json(int state, const char* text, int length, unsigned char* classes) {
+    if (!classes) return state;
+
+    int i = 0;
+    while (i < length) {
+        char c = text[i];
+        int end;
+
+        if (c == '"') {
+            end = string_end(text, length, i + 1, '"');
+            int after = end;
+            while (after < length && (text[after] == ' ' || text[after] == '\t')) after++;
+            mark(classes, i, end, after < length && text[after] == ':' ? HIGHLIGHT_KEY : HIGHLIGHT_STRING);
+        } else if (c == '-' || isdigit((unsigned char)c)) {
+            end = number_end(text, length, i + 1);
+            mark(classes, i, end, HIGHLIGHT_NUMBER);
+        } else if (isalpha((unsigned char)c)) {
+            end = i;
+            while (end < length && isalpha((unsigned char)text[end])) end++;
+            mark(classes, i, end, word_in(text + i, end - i, json_literals) ? HIGHLIGHT_KEYWORD : HIGHLIGHT_PLAIN);
+        } else {
+            end = i + 1;
+            mark(classes, i, end, HIGHLIGHT_PLAIN);
+        }
+        i = end;
+    }
+    return state;
+}
+
+// YAML. A line ending in a block scalar indicator (| or >) starts a block
+// whose lines are indented deeper than it; the state is that indent + 1.
+static const char* const yaml_literals[] = {
+    "true", "false", "yes", "no", "on", "off", "null", "True", "False", "Yes", "No",
+    "TRUE", "FALSE", "NULL", "~", NULL
+};
+
+static int yaml_comment_at(const char* text, int i) {
+    return text[i] == '#' && (i == 0 || text[i - 1] == ' ' || text[i - 1] == '\t');
+}
+
+// Color a value from text[i] on and say whether it opens a block scalar
+static int yaml_value(const char* text, int length, int i, unsigned char* classes) {
+    while (i < length && text[i] == ' ') i++;
+    if (i >= length) return 0;
+
+    char c = text[i];
+    if (c == '|' || c == '>') {
+        int end = i + 1;
+        while (end < length && (text[end] == '-' || text[end] == '+' || isdigit((unsigned char)text[end]))) end++;
+        mark(classes, i, end, HIGHLIGHT_KEYWORD);
+        while (end < length && text[end] == ' ') end++;
+        if (end < length && yaml_comment_at(text, end)) {
+            mark(classes, end, length, HIGHLIGHT_COMMENT);
+            end = length;
+        }
+        return end == length;
+    }
+    if (c == '"' || c == '\'') {
+        int end = string_end(text, length, i + 1, c);
+        mark(classes, i, end, HIGHLIGHT_STRING);
+        i = end;
+    } else if (c == '&' || c == '*' || c == '!') {
+        int end = i + 1;
+        while (end < length && text[end] != ' ') end++;
+        mark(classes, i, end, HIGHLIGHT_TYPE);
+        return yaml_value(text, length, end, classes);
+    } else {
+        // A plain scalar runs to a comment or the end of the line
+        int end = i;
+        while (end < length && !yaml_comment_at(text, end)) end++;
+        int last = end;
+        while (last > i && text[last - 1] == ' ') last--;
+
+        int digits = i + (c == '-' || c == '+');
+        int class = HIGHLIGHT_PLAIN;
+        if (word_in(text + i, last - i, yaml_literals)) {
+            class = HIGHLIGHT_KEYWORD;
+        } else if (digits < last && isdigit((unsigned char)text[digits]) && number_end(text, last, digits) == last) {
+            class = HIGHLIGHT_NUMBER;
+        }
+        mark(classes, i, last, class);
+        i = end;
+    }
+
+    while (i < length && !yaml_comment_at(text, i)) i++;
+    mark(classes, i, length, HIGHLIGHT_COMMENT);
+    return 0;
+}
+
+static int lex_yaml(int state, const char* text, int length, unsigned char* classes) {
+    int indent = 0;
+    while (indent < length && text[indent] == ' ') indent++;
+
+    if (state > 0) {
+        // Blank lines do not end a block; shallower lines do
+        if (indent == length) {
+            mark(classes, 0, length, HIGHLIGHT_PLAIN);
+            return state;
+        }
+        if (indent > state - 1) {
+            mark(classes, 0, length, HIGHLIGHT_STRING);
+            return state;
+        }
+    }
+    mark(classes, 0, length, HIGHLIGHT_PLAIN);
+
+    if (length >= 3 && (memcmp(text, "---", 3) == 0 || memcmp(text, "...", 3) == 0) &&
+        (length == 3 || text[3] == ' ')) {
+        mark(classes, 0, 3, HIGHLIGHT_KEYWORD);
+        return yaml_value(text, length, 3, classes) ? 1 : 0;
+    }
+
+    // Sequence dashes, then a key if there is one
+    int i = indent;
+    while (i < length && text[i] == '-' && (i + 1 == length || text[i + 1] == ' ')) {
+        i += 2;
+        while (i < length && text[i] == ' ') i++;
+    }
+    if (i < length && yaml_comment_at(text, i)) {
+        mark(classes, i, length, HIGHLIGHT_COMMENT);
+        return 0;
+    }
+
+    int colon = i;
+    if (colon < length && (text[colon] == '"' || text[colon] == '\'')) {
+        colon = string_end(text, length, colon + 1, text[colon]);
+    }
+    while (colon < length && !(text[colon] == ':' && (colon + 1 == length || text[colon + 1] == ' ')) &&
+           !yaml_comment_at(text, colon)) {
+        colon++;
+    }
+    if (colon < length && text[colon] == ':') {
+        mark(classes, i, colon, HIGHLIGHT_KEY);
+        i = colon + 1;
+    }
+    return yaml_value(text, length, i, classes) ? indent + 1 : 0;
+}
+
+// Log files: a leading timestamp, level words and quoted strings. Nothing
+// carries over between lines.
+static const char* const log_errors[] = { "ERROR", "ERR", "FATAL", "CRITICAL", "CRIT", "SEVERE", "PANIC", NULL };
+static const char* const log_warnings[] = { "WARN", "WARNING", NULL };
+static const char* const log_notes[] = { "INFO", "NOTICE", NULL };
+static const char* const log_quiet[] = { "DEBUG", "TRACE", "VERBOSE", NULL };
+
+static int lex_log(int state, const char* text, int length, unsigned char* classes) {
+    if (!classes) return state;
+
+    mark(classes, 0, length, HIGHLIGHT_PLAIN);
+
+    // Timestamps are digits and separators, with single spaces between parts
+    int i = 0;
+    if (i < length && isdigit((unsigned char)text[i])) {
+        while (i < length) {
+            char c = text[i];
+            if (isdigit((unsigned char)c) || c == '-' || c == ':' || c == '.' || c == ',' || c == '/' ||
+                c == 'T' || c == 'Z' || c == '+') {
+                i++;
+            } else if (c == ' ' && i + 1 < length && isdigit((unsigned char)text[i + 1])) {
+                i++;
+            } else {
+                break;
+            }
+        }
+        mark(classes, 0, i, HIGHLIGHT_NUMBER);
+    }
+
+    while (i < length) {
+        char c = text[i];
+        int end = i + 1;
+
+        if (c == '"') {
+            end = string_end(text, length, i + 1, c);
+            mark(classes, i, end, HIGHLIGHT_STRING);
+        } else if (isalpha((unsigned char)c)) {
+            end = i;
+            while (end < length && is_word(text[end])) end++;
+            int class = HIGHLIGHT_PLAIN;
+            if (word_in_nocase(text + i, end - i, log_errors)) {
+                class = HIGHLIGHT_ERROR;
+            } else if (word_in_nocase(text + i, end - i, log_warnings)) {
+                class = HIGHLIGHT_WARNING;
+            } else if (word_in_nocase(text + i, end - i, log_notes)) {
+                class = HIGHLIGHT_KEYWORD;
+            } else if (word_in_nocase(text + i, end - i, log_quiet)) {
+                class = HIGHLIGHT_COMMENT;
+            }
+            mark(classes, i, end, class);
+        } else if (isdigit((unsigned char)c) && (i == 0 || !is_word(text[i - 1]))) {
+            end = number_end(text, length, i);
+            mark(classes, i, end, HIGHLIGHT_NUMBER);
+        }
+        i = end;
+    }
+    return state;
+}
+
+static int syntax_lex(int language, int state, const char* text, int length, unsigned char* classes) {
+    switch (language) {
+        case SYNTAX_C:    return lex_c(state, text, length, classes);
+        case SYNTAX_JSON: return lex_json(state, text, length, classes);
+        case SYNTAX_YAML: return lex_yaml(state, text, length, classes);
+        case SYNTAX_LOG:  return lex_log(state, text, length, classes);
+    }
+    mark(classes, 0, length, HIGHLIGHT_PLAIN);
+    return 0;
+}
+
+// State a buffer line ends in, reading it only if it is short enough to lex
+static int syntax_lex_line(int language, int state, TextBuffer* buffer, int index) {
+    int length = buffer_get_line_length(buffer, index);
+    if (length > SYNTAX_MAX_LINE) return state;
+
+    const char* text = buffer_get_line(buffer, index, &length);
+    return syntax_lex(language, state, text, length, NULL);
+}
+
+int syntax_detect(const char* filename) {
+    const char* dot = strrchr(filename, '.');
+    if (!dot) return SYNTAX_NONE;
+    dot++;
+
+    static const char* const c_names[] = { "c", "h", "cc", "cpp", "cxx", "hpp", "hh", "hxx", NULL };
+    static const char* const yaml_names[] = { "yaml", "yml", NULL };
+    int length = (int)strlen(dot);
+    if (word_in(dot, length, c_names)) return SYNTAX_C;
+    if (strcmp(dot, "json") == 0) return SYNTAX_JSON;
+    if (word_in(dot, length, yaml_names)) return SYNTAX_YAML;
+    if (strcmp(dot, "log") == 0) return SYNTAX_LOG;
+    return SYNTAX_NONE;
+}
+
+void syntax_free(Syntax* syntax) {
+    free(syntax->states);
+    free(syntax->classes);
+    memset(syntax, 0, sizeof(Syntax));
+}
+
+static int syntax_reserve(Syntax* syntax, int lines) {
+    if (lines <= syntax->capacity) return 1;
+
+    int new_capacity = syntax->capacity ? syntax->capacity : 1024;
+    while (new_capacity < lines) {
+        new_capacity *= 2;
+    }
+    int* grown = (int*)realloc(syntax->states, (size_t)new_capacity * sizeof(int));
+    if (!grown) return 0;
+    syntax->states = grown;
+    syntax->capacity = new_capacity;
+    return 1;
+}
+
+// Fold the buffer's edits into the cache. Lines below the last one changed
+// keep their states, moved to their new numbers, so lexing again after an
+// edit can stop as soon as it agrees with them.
+static void syntax_update(Syntax* syntax, BufferChanges changes) {
+    if (changes.first < 0) return;
+    if (changes.first < syntax->guess_line) syntax->guess_line = 0;
+    if (changes.first >= syntax->known) return;
+
+    // Lexing that stopped at `valid` left the states from there on
+    // following on from the old state of the line above, so that line
+    // needs the same recheck as an edited one
+    int stale = syntax->valid < syntax->known;
+    int recheck = syntax->recheck > syntax->valid - 1 ? syntax->recheck : syntax->valid - 1;
+    if (syntax->valid > changes.first) syntax->valid = changes.first;
+
+    int tail = changes.last == INT_MAX ? INT_MAX : changes.last + 1 - changes.delta;
+    if (tail >= syntax->known || !syntax_reserve(syntax, syntax->known + changes.delta)) {
+        syntax->known = syntax->valid;
+        return;
+    }
+    memmove(syntax->states + changes.last + 1, syntax->states + tail,
+            (size_t)(syntax->known - tail) * sizeof(int));
+    syntax->known += changes.delta;
+
+    // Lines still waiting from an earlier edit move along with the rest
+    if (stale && recheck >= changes.first) {
+        recheck = recheck > changes.last - changes.delta ? recheck + changes.delta : changes.last;
+    }
+    syntax->recheck = stale && recheck > changes.last ? recheck : changes.last;
+}
+
+// Pick the language for the buffer's file and take in its edits. Call
+// before drawing each frame.
+void syntax_attach(Syntax* syntax, TextBuffer* buffer) {
+    BufferChanges changes = buffer_take_changes(buffer);
+
+    if (strcmp(syntax->filename, buffer->filename) != 0) {
+        memcpy(syntax->filename, buffer->filename, sizeof(syntax->filename));
+        syntax->language = syntax_detect(buffer->filename);
+        syntax->known = 0;
+        syntax->valid = 0;
+        syntax->guess_line = 0;
+        return;
+    }
+    syntax_update(syntax, changes);
+}
+
+// Record that `line`, the first one not known to be right, ends in state
+static void syntax_store(Syntax* syntax, int line, int state) {
+    if (line < syntax->known) {
+        // Agreeing with a stale state past every edited line means the
+        // rest of the stale states are right too
+        if (line > syntax->recheck && syntax->states[line] == state) {
+            syntax->valid = syntax->known;
+            return;
+        }
+        syntax->states[line] = state;
+        syntax->valid = line + 1;
+        return;
+    }
+    if (!syntax_reserve(syntax, line + 1)) return;
+    syntax->states[line] = state;
+    syntax->known = line + 1;
+    syntax->valid = line + 1;
+}
+
+// Lexer state at the start of `line`, lexing any lines before it whose
+// state is not known yet
+int syntax_state_before(Syntax* syntax, TextBuffer* buffer, int line) {
+    if (syntax->language == SYNTAX_NONE || line <= 0) return 0;
+
+    if (line - syntax->valid > SYNTAX_MAX_CATCHUP) {
+        // Kept until an edit above the line, so typing in a view this far
+        // down does not lex the context again for every key
+        if (syntax->guess_line == line) return syntax->guess_state;
+
+        int state = 0;
+        for (int i = line - SYNTAX_CONTEXT; i < line; i++) {
+            state = syntax_lex_line(syntax->language, state, buffer, i);
+        }
+        syntax->guess_line = line;
+        syntax->guess_state = state;
+        return state;
+    }
+
+    while (syntax->valid < line) {
+        int i = syntax->valid;
+        int state = i > 0 ? syntax->states[i - 1] : 0;
+        int end = syntax_lex_line(syntax->language, state, buffer, i);
+
+        int before = syntax->valid;
+        syntax_store(syntax, i, end);
+        if (syntax->valid == before) break;
+    }
+    return syntax->valid >= line ? syntax->states[line - 1] : 0;
+}
+
+// Highlight classes for each byte of one line that starts in `state`;
+// *end_state is the state the line ends in. Valid until the next call.
+// NULL for lines longer than SYNTAX_MAX_LINE, whose text may be NULL.
+const unsigned char* syntax_highlight(Syntax* syntax, int line, int state, const char* text, int length, int* end_state) {
+    if (length > SYNTAX_MAX_LINE) {
+        *end_state = state;
+        if (syntax->language != SYNTAX_NONE && line == syntax->valid) {
+            syntax_store(syntax, line, state);
+        }
+        return NULL;
+    }
+
+    if (length + 1 > syntax->classes_capacity) {
+        int new_capacity = syntax->classes_capacity ? syntax->classes_capacity : 256;
+        while (new_capacity < length + 1) {
+            new_capacity *= 2;
+        }
+        unsigned char* grown = (unsigned char*)realloc(syntax->classes, (size_t)new_capacity);
+        if (!grown) return NULL;
+        syntax->classes = grown;
+        syntax->classes_capacity = new_capacity;
+    }
+
+    *end_state = syntax_lex(syntax->language, state, text, length, syntax->classes);
+    if (syntax->language != SYNTAX_NONE && line == syntax->valid) {
+        syntax_store(syntax, line, *end_state);
+    }
+    return syntax->classes;
+}
\ No newline at end of file
@@ -2,6 +2,228 @@
 #include <stdio.h>
 #include <string.h>
 
+// Unchanged cells tolerated inside one run before it is split in two;
+// rewriting a short gap is cheaper than a cursor move
+#define TUI_RUN_GAP 4
+
+static void tui_grid_free(TUIState* tui) {
+    free(tui->front);
+    free(tui->back);
+    tui->front = NULL;
+    tui->back = NULL;
+    tui->grid_rows = 0;
+    tui->grid_cols = 0;
+}
+
+// Size the grids to the terminal. The front grid starts out holding cells
+// no frame can produce, so the next present repaints everything.
+static void tui_grid_reset(TUIState* tui) {
+    size_t cells = (size_t)(tui->rows > 0 ? tui->rows : 0) * (size_t)(tui->cols > 0 ? tui->cols : 0);
+    
+    tui_grid_free(tui);
+    if (cells == 0) return;
+    
+    tui->front = (TUICell*)calloc(cells, sizeof(TUICell));
+    tui->back = (TUICell*)calloc(cells, sizeof(TUICell));
+    if (!tui->front || !tui->back) {
+        tui_grid_free(tui);
+        return;
+    }
+    tui->grid_rows = tui->rows;
+    tui->grid_cols = tui->cols;
+    tui->pen = -1;
+    tui->front_offset_y = tui->offset_y;
+}
+
+// Write text into the frame being composed, clipped to the row
+static void tui_put(TUIState* tui, int row, int col, const char* text, int length, unsigned char attr) {
+    if (!tui->back || row < 0 || row >= tui->grid_rows || col < 0) return;
+    
+    TUICell* cell = tui->back + row * tui->grid_cols;
+    for (int i = 0; i < length && col + i < tui->grid_cols; i++) {
+        char ch = text[i];
+        // One byte per cell: control characters would move the cursor
+        if (ch == '\t') ch = ' ';
+        else if ((unsigned char)ch < 32 || ch == 127) ch = '?';
+        cell[col + i].ch = ch;
+        cell[col + i].attr = attr;
+    }
+}
+
+static void tui_fill(TUIState* tui, int row, int col, int count, unsigned char attr) {
+    if (!tui->back || row < 0 || row >= tui->grid_rows) return;
+    
+    TUICell* cell = tui->back + row * tui->grid_cols;
+    for (int i = col; i < col + count && i < tui->grid_cols; i++) {
+        cell[i].ch = ' ';
+        cell[i].attr = attr;
+    }
+}
+
+// Recolor cells already composed, keeping their text
+static void tui_paint(TUIState* tui, int row, int col, int count, unsigned char attr) {
+    if (!tui->back || row < 0 || row >= tui->grid_rows) return;
+    
+    TUICell* cell = tui->back + row * tui->grid_cols;
+    for (int i = col < 0 ? 0 : col; i < col + count && i < tui->grid_cols; i++) {
+        cell[i].attr = attr;
+    }
+}
+
+// Color of each highlight class
+static const unsigned char tui_highlight_attrs[HIGHLIGHT_COUNT] = {
+    TUI_ATTR_DEFAULT,                                     // plain
+    TUI_ATTR(COLOR_MAGENTA, COLOR_BLACK),                 // keyword
+    TUI_ATTR(COLOR_CYAN, COLOR_BLACK),                    // type
+    TUI_ATTR(COLOR_GREEN, COLOR_BLACK),                   // string
+    TUI_ATTR(COLOR_YELLOW, COLOR_BLACK),                  // number
+    TUI_ATTR(COLOR_BLACK | COLOR_BRIGHT, COLOR_BLACK),    // comment
+    TUI_ATTR(COLOR_BLUE | COLOR_BRIGHT, COLOR_BLACK),     // directive
+    TUI_ATTR(COLOR_CYAN | COLOR_BRIGHT, COLOR_BLACK),     // key
+    TUI_ATTR(COLOR_RED | COLOR_BRIGHT, COLOR_BLACK),      // error
+    TUI_ATTR(COLOR_YELLOW | COLOR_BRIGHT, COLOR_BLACK),   // warning
+};
+
+// Color the shown part of a line by what the lexer makes of it. *state is
+// the state the line before ended in and becomes this line's.
+static void tui_mark_syntax(TUIState* tui, int row, int col, int index, const char* line, int line_len, int max_chars, int* state) {
+    if (tui->syntax.language == SYNTAX_NONE) return;
+    
+    const unsigned char* classes = syntax_highlight(&tui->syntax, index, *state, line, line_len, state);
+    if (!classes) return;
+    
+    int end = line_len < tui->offset_x + max_chars ? line_len : tui->offset_x + max_chars;
+    for (int i = tui->offset_x; i < end; ) {
+        int run = i + 1;
+        while (run < end && classes[run] == classes[i]) run++;
+        if (classes[i] != HIGHLIGHT_PLAIN) {
+            tui_paint(tui, row, col + i - tui->offset_x, run - i, tui_highlight_attrs[classes[i]]);
+        }
+        i = run;
+    }
+}
+
+// Next match of the find query in line[from, line_len)
+static int tui_next_match(const Search* search, const char* line, int line_len, int from, int* start, int* end) {
+    if (search->regexp) {
+        size_t match_start, match_end;
+        if (!search->pattern || !regexp_search(search->pattern, line, line_len, from, &match_start, &match_end)) return 0;
+        *start = (int)match_start;
+        *end = (int)match_end;
+        return 1;
+    }
+    
+    const char* hit = search_memory(line + from, line_len - from, search->query, search->length);
+    if (!hit) return 0;
+    *start = (int)(hit - line);
+    *end = *start + search->length;
+    return 1;
+}
+
+// Highlight the find query's matches on one drawn line, of which `line`
+// holds bytes [base, base + line_len) out of full_len; the match the
+// cursor sits on stands out from the rest
+static void tui_mark_matches(TUIState* tui, int row, int col, int index, const char* line, int line_len,
+                             int base, int full_len, int max_chars) {
+    const Search* search = tui->search;
+    if (!search || search->length == 0) return;
+    
+    int start, end;
+    int from = 0;
+    while (from <= line_len && tui_next_match(search, line, line_len, from, &start, &end)) {
+        int first = base + start - tui->offset_x;
+        int last = base + end - tui->offset_x;
+        if (first >= max_chars) break;
+        
+        // A regex match at an edge where the line was cut may be clipped,
+        // or match ^ or $ only because of the cut
+        int cut = search->regexp && ((start == 0 && base > 0) || (end == line_len && base + line_len < full_len));
+        if (last > 0 && !cut) {
+            if (first < 0) first = 0;
+            if (last > max_chars) last = max_chars;
+            int current = index == tui->cursor_y && base + start == tui->cursor_x;
+            tui_paint(tui, row, col + first, last - first,
+                      current ? TUI_ATTR(COLOR_BLACK, COLOR_YELLOW) : TUI_ATTR(COLOR_BLACK, COLOR_WHITE));
+        }
+        
+        // An empty match would be found again at the same place
+        from = end > start ? end : start + 1;
+    }
+}
+
+// Show the other cursors that fall on one drawn line, whose text starts at
+// document offset `start`. `next` is the first cursor not yet passed; the
+// one after the line's last cursor is returned.
+static size_t tui_mark_cursors(TUIState* tui, int row, int col, size_t start, int line_len, int max_chars,
+                               size_t next) {
+    const CursorSet* cursors = &tui->cursors;
+    unsigned char attr = TUI_ATTR(COLOR_BLACK, COLOR_CYAN);
+    
+    for (; next < cursors->count && cursors->offsets[next] <= start + (size_t)line_len; next++) {
+        int x = (int)(cursors->offsets[next] - start) - tui->offset_x;
+        if (x < 0 || x >= max_chars) continue;
+        
+        // Past the end of the line there is no character to color
+        if (x + tui->offset_x == line_len) {
+            tui_put(tui, row, col + x, "|", 1, attr);
+        } else {
+            tui_paint(tui, row, col + x, 1, attr);
+        }
+    }
+    return next;
+}
+
+static void tui_put_string(TUIState* tui, int row, int col, const char* text, unsigned char attr) {
+    tui_put(tui, row, col, text, (int)strlen(text), attr);
+}
+
+static void tui_set_pen(TUIState* tui, unsigned char attr) {
+    if (tui->pen == attr) return;
+    
+    if (attr == TUI_ATTR_DEFAULT) {
+        platform_reset_color();
+    } else {
+        platform_set_color(attr & 0x0F, attr >> 4);
+    }
+    tui->pen = attr;
+}
+
+// When the view moved by fewer lines than it shows, let the terminal shift
+// the text rows it already has and mirror that in the front grid, so the
+// diff below only finds the newly exposed rows
+static void tui_scroll_front(TUIState* tui) {
+    int text_rows = tui_get_max_display_lines(tui);
+    int delta = tui->offset_y - tui->front_offset_y;
+    int cols = tui->grid_cols;
+    
+    tui->front_offset_y = tui->offset_y;
+    if (delta == 0 || delta >= text_rows || -delta >= text_rows || text_rows > tui->grid_rows) return;
+    
+    // Exposed rows are cleared in the current colors
+    tui_set_pen(tui, TUI_ATTR_DEFAULT);
+    if (!platform_scroll_rows(0, text_rows - 1, delta)) return;
+    
+    int kept = text_rows - (delta > 0 ? delta : -delta);
+    TUICell* text = tui->front;
+    if (delta > 0) {
+        memmove(text, text + delta * cols, (size_t)kept * cols * sizeof(TUICell));
+        text += kept * cols;
+    } else {
+        memmove(text - delta * cols, text, (size_t)kept * cols * sizeof(TUICell));
+    }
+    for (int i = 0; i < (text_rows - kept) * cols; i++) {
+        text[i].ch = ' ';
+        text[i].attr = TUI_ATTR_DEFAULT;
+    }
+}
+
+static int tui_row_is_ascii(const TUICell* cells, int count) {
+    for (int i = 0; i < count; i++) {
+        if ((unsigned char)cells[i].ch >= 0x80) return 0;
+    }
+    return 1;
+}
+
 void tui_init(TUIState* tui) {
     platform_init_terminal();
     
@@ -13,6 +235,9 @@ void tui_init(TUIState* tui) {
     tui->offset_y = 0;
     tui->line_num_width = 6;
     
+    // Whatever is on screen now is unknown to us
+    tui_grid_reset(tui);
+    
 #ifdef PLATFORM_WINDOWS
     tui->stdout_handle = GetStdHandle(STD_OUTPUT_HANDLE);
     GetConsoleScreenBufferInfo(tui->stdout_handle, &tui->original_info);
@@ -34,6 +259,7 @@ void tui_cleanup(TUIState* tui) {
     platform_set_raw_mode(0);
     platform_reset_color();
     platform_clear_screen();
+    tui_grid_free(tui);
 }
 
 void tui_clear_screen() {
@@ -49,97 +275,293 @@ void tui_reset_color() {
 }
 
 void tui_draw(TUIState* tui, TextBuffer* buffer) {
-    platform_set_cursor_position(0, 0);
-    
     int max_display_lines = tui_get_max_display_lines(tui);
     int start_line = tui->offset_y;
     int end_line = start_line + max_display_lines;
+    int max_chars = tui->cols - tui->line_num_width - 1;
     
     if (end_line > buffer->line_count) {
         end_line = buffer->line_count;
     }
     
-    // Draw text area
+    // Only the lines on screen are colored, starting from the cached
+    // lexer state of the line above them
+    syntax_attach(&tui->syntax, buffer);
+    int state = syntax_state_before(&tui->syntax, buffer, start_line);
+    
+    // Other cursors are sorted, so the ones on screen follow the first one
+    // at or after the top line
+    size_t next_cursor = tui->cursors.count;
+    if (tui->cursors.count > 0 && start_line < end_line) {
+        next_cursor = cursor_set_lower_bound(&tui->cursors, buffer_get_offset(buffer, start_line, 0));
+    }
+    
+    // Compose text area
     for (int i = start_line; i < end_line; i++) {
-        platform_set_cursor_position(0, i - start_line);
+        int row = i - start_line;
+        char number[32];
         
-        // Draw line numbers
-        tui_set_color(COLOR_YELLOW, COLOR_BLACK);
-        printf("%*d | ", tui->line_num_width - 2, i + 1);
-        tui_reset_color();
+        // Line numbers
+        snprintf(number, sizeof(number), "%*d | ", tui->line_num_width - 2, i + 1);
+        tui_put_string(tui, row, 0, number, TUI_ATTR(COLOR_YELLOW, COLOR_BLACK));
+        int col = (int)strlen(number);
         
-        // Draw line content
-        char* line = buffer_get_line(buffer, i);
+        // Line content. A line too long to color is read only around the
+        // part on screen, with room on both sides for matches running into
+        // view, so scrolling along a line of many megabytes stays cheap.
+        int line_len = buffer_get_line_length(buffer, i);
+        int base = 0;
+        int part_len;
+        const char* line;
+        if (line_len > SYNTAX_MAX_LINE) {
+            base = tui->offset_x > SEARCH_MAX_QUERY ? tui->offset_x - SEARCH_MAX_QUERY : 0;
+            line = buffer_get_line_part(buffer, i, base, max_chars + 2 * SEARCH_MAX_QUERY, &part_len);
+        } else {
+            line = buffer_get_line(buffer, i, &part_len);
+        }
+        int shown = 0;
         if (line) {
-            int line_len = strlen(line);
-            int start_pos = tui->offset_x;
-            int max_chars = tui->cols - tui->line_num_width - 1;
-            
-            if (start_pos < line_len) {
-                int chars_to_show = line_len - start_pos;
-                if (chars_to_show > max_chars) {
-                    chars_to_show = max_chars;
-                }
-                for (int j = 0; j < chars_to_show; j++) {
-                    putchar(line[start_pos + j]);
+            if (tui->offset_x < line_len) {
+                shown = line_len - tui->offset_x;
+                if (shown > max_chars) {
+                    shown = max_chars;
                 }
+                tui_put(tui, row, col, line + tui->offset_x - base, shown, TUI_ATTR_DEFAULT);
             }
+            tui_mark_syntax(tui, row, col, i, line, line_len, max_chars, &state);
+            tui_mark_matches(tui, row, col, i, line, part_len, base, line_len, max_chars);
         }
         
         // Clear rest of line
-        for (int j = 0; j < tui->cols - (tui->line_num_width + (line ? strlen(line) - tui->offset_x : 0)); j++) {
-            putchar(' ');
+        tui_fill(tui, row, col + shown, tui->cols, TUI_ATTR_DEFAULT);
+        
+        if (next_cursor < tui->cursors.count) {
+            next_cursor = tui_mark_cursors(tui, row, col, buffer_get_offset(buffer, i, 0), line_len, max_chars,
+                                           next_cursor);
         }
     }
     
     // Clear remaining lines
     for (int i = end_line - start_line; i < max_display_lines; i++) {
-        platform_set_cursor_position(0, i);
-        for (int j = 0; j < tui->cols; j++) {
-            putchar(' ');
-        }
+        tui_fill(tui, i, 0, tui->cols, TUI_ATTR_DEFAULT);
     }
     
     tui_draw_status(tui, buffer);
+    
+    // The whole frame goes out in one write
+    platform_begin_frame();
+    tui_present(tui);
     tui_update_cursor(tui);
+    platform_end_frame();
+}
+
+// Paging mode: lines come straight from the pager's mapped windows and
+// offset_y mirrors its top line number once that is known
+void tui_draw_pager(TUIState* tui, Pager* pager) {
+    int max_display_lines = tui_get_max_display_lines(tui);
+    int max_chars = tui->cols - tui->line_num_width - 1;
+    long long top_line = pager_get_top_line(pager);
+    size_t offset = pager->top;
+    int row = 0;
+    
+    if (top_line >= 0) {
+        tui->offset_y = (int)top_line;
+    }
+    
+    for (; row < max_display_lines; row++) {
+        size_t length;
+        const char* line = pager_read_line(pager, &offset, tui->offset_x, max_chars, &length);
+        if (!line) break;
+        
+        char number[32];
+        if (top_line >= 0) {
+            snprintf(number, sizeof(number), "%*lld | ", tui->line_num_width - 2, top_line + row + 1);
+        } else {
+            snprintf(number, sizeof(number), "%*s | ", tui->line_num_width - 2, "?");
+        }
+        tui_put_string(tui, row, 0, number, TUI_ATTR(COLOR_YELLOW, COLOR_BLACK));
+        
+        int col = (int)strlen(number);
+        tui_put(tui, row, col, line, (int)length, TUI_ATTR_DEFAULT);
+        tui_fill(tui, row, col + (int)length, tui->cols, TUI_ATTR_DEFAULT);
+    }
+    
+    // Clear remaining lines
+    for (; row < max_display_lines; row++) {
+        tui_fill(tui, row, 0, tui->cols, TUI_ATTR_DEFAULT);
+    }
+    
+    // Status bar
+    unsigned char status_attr = TUI_ATTR(COLOR_WHITE, COLOR_BLACK);
+    char status[256];
+    tui_fill(tui, max_display_lines, 0, tui->cols, status_attr);
+    snprintf(status, sizeof(status), " %.*s [read-only]", (int)sizeof(status) - 14, pager->filename);
+    tui_put(tui, max_display_lines, 0, status, strlen(status) < 30 ? (int)strlen(status) : 30, status_attr);
+    
+    int progress = pager_get_index_progress(pager);
+    if (progress >= 0) {
+        snprintf(status, sizeof(status), "indexing %d%%", progress);
+        tui_put_string(tui, max_display_lines, tui->cols - 36, status, status_attr);
+    }
+    
+    long long line_count = pager_get_line_count(pager);
+    if (top_line >= 0 && line_count >= 0) {
+        snprintf(status, sizeof(status), "Ln %lld/%lld", top_line + 1, line_count);
+    } else if (top_line >= 0) {
+        snprintf(status, sizeof(status), "Ln %lld", top_line + 1);
+    } else {
+        snprintf(status, sizeof(status), "Ln ?");
+    }
+    tui_put_string(tui, max_display_lines, tui->cols - 20, status, status_attr);
+    
+    unsigned char help_attr = TUI_ATTR(COLOR_BLACK, COLOR_BLUE);
+    tui_fill(tui, max_display_lines + 1, 0, tui->cols, help_attr);
+    tui_put_string(tui, max_display_lines + 1, 0, " ^G:Go to line  ^O:Open  ^N:New  ^Q:Quit  F1:Help", help_attr);
+    
+    platform_begin_frame();
+    tui_present(tui);
+    platform_hide_cursor();
+    platform_end_frame();
 }
 
 void tui_draw_status(TUIState* tui, TextBuffer* buffer) {
     int max_display_lines = tui_get_max_display_lines(tui);
-    platform_set_cursor_position(0, max_display_lines);
+    unsigned char status_attr = TUI_ATTR(COLOR_WHITE, COLOR_BLACK);
+    char status[256];
     
     // Status bar background
-    tui_set_color(COLOR_WHITE, COLOR_BLACK);
-    for (int i = 0; i < tui->cols; i++) {
-        putchar(' ');
+    tui_fill(tui, max_display_lines, 0, tui->cols, status_attr);
+    
+    // File info, or the find prompt while one is open
+    if (tui->search) {
+        const Search* search = tui->search;
+        char note[64] = "";
+        size_t index, total;
+        if (search->regexp && search->length > 0 && !search->pattern) {
+            snprintf(note, sizeof(note), "  (invalid pattern)");
+        } else if (search->length > 0 && search_current(search) < 0) {
+            snprintf(note, sizeof(note), "  (not found)");
+        } else if (search_count(search, &index, &total)) {
+            // The count streams in while the workers are still going
+            if (search_running(search)) {
+                snprintf(note, sizeof(note), "  (%llu found so far)", (unsigned long long)total);
+            } else if (index > 0) {
+                snprintf(note, sizeof(note), "  (%llu of %llu)", (unsigned long long)index, (unsigned long long)total);
+            } else {
+                snprintf(note, sizeof(note), "  (%llu found)", (unsigned long long)total);
+            }
+        }
+        if (search->replacing) {
+            // Query and replacement get half of the room each
+            int room = (int)(sizeof(status) - 19) / 2;
+            snprintf(status, sizeof(status), " %s: %.*s  Replace: %.*s", search->regexp ? "Regex" : "Find",
+                     room, search->query, room, search->replacement);
+        } else {
+            // Clipped so the note always fits after the query
+            snprintf(status, sizeof(status), " %s: %.*s%s", search->regexp ? "Regex" : "Find",
+                     (int)(sizeof(status) - sizeof(note) - 8), search->query, note);
+        }
+        tui_put(tui, max_display_lines, 0, status, (int)strlen(status), status_attr);
+    } else if (tui->message[0]) {
+        snprintf(status, sizeof(status), " %s", tui->message);
+        tui_put(tui, max_display_lines, 0, status, (int)strlen(status), status_attr);
+    } else {
+        const char* filename = buffer->filename[0] ? buffer->filename : "[New File]";
+        snprintf(status, sizeof(status), " %s %s",
+                 filename, buffer->modified ? "(modified)" : "");
+        tui_put(tui, max_display_lines, 0, status, strlen(status) < 30 ? (int)strlen(status) : 30, status_attr);
     }
     
-    platform_set_cursor_position(0, max_display_lines);
+    // Background load progress
+    if (buffer->load_progress >= 0) {
+        snprintf(status, sizeof(status), "loading %d%%", buffer->load_progress);
+        tui_put_string(tui, max_display_lines, tui->cols - 36, status, status_attr);
+    }
     
-    // File info
-    char status[256];
-    const char* filename = buffer->filename[0] ? buffer->filename : "[New File]";
-    snprintf(status, sizeof(status), " %s %s", 
-             filename, buffer->modified ? "(modified)" : "");
-    printf("%-30.30s", status);
+    // Cursor count, the main one included
+    if (tui->cursors.count > 0 && buffer->load_progress < 0) {
+        snprintf(status, sizeof(status), "%llu cursors", (unsigned long long)tui->cursors.count + 1);
+        tui_put_string(tui, max_display_lines, tui->cols - 36, status, status_attr);
+    }
     
     // Cursor position
-    platform_set_cursor_position(tui->cols - 20, max_display_lines);
-    printf("Ln %d, Col %d", tui->cursor_y + 1, tui->cursor_x + 1);
+    snprintf(status, sizeof(status), "Ln %d, Col %d", tui->cursor_y + 1, tui->cursor_x + 1);
+    tui_put_string(tui, max_display_lines, tui->cols - 20, status, status_attr);
     
     // Second status line
-    platform_set_cursor_position(0, max_display_lines + 1);
-    
-    tui_set_color(COLOR_BLACK, COLOR_BLUE);
-    for (int i = 0; i < tui->cols; i++) {
-        putchar(' ');
+    unsigned char help_attr = TUI_ATTR(COLOR_BLACK, COLOR_BLUE);
+    tui_fill(tui, max_display_lines + 1, 0, tui->cols, help_attr);
+    const char* help = " ^S:Save  ^O:Open  ^N:New  ^F:Find  ^Q:Quit  F1:Help";
+    if (tui->search) {
+        help = tui->search->replacing ? " Enter:Replace all  ESC:Cancel  Tab:Find"
+                                      : " Enter:Done  ESC:Cancel  ^F:Next  ^R:Regex  Tab:Replace";
     }
+    tui_put_string(tui, max_display_lines + 1, 0, help, help_attr);
+}
+
+// Send the composed frame: only runs of cells that differ from what the
+// terminal already shows are written, then the frame becomes the front
+void tui_present(TUIState* tui) {
+    if (!tui->back) return;
+    
+    int cols = tui->grid_cols;
+    int cursor_row = -1;
+    int cursor_col = -1;
     
-    platform_set_cursor_position(0, max_display_lines + 1);
+    tui_scroll_front(tui);
     
-    printf(" ^S:Save  ^O:Open  ^N:New  ^Q:Quit  F1:Help");
+    for (int row = 0; row < tui->grid_rows; row++) {
+        TUICell* back = tui->back + row * cols;
+        TUICell* front = tui->front + row * cols;
+        
+        if (memcmp(back, front, cols * sizeof(TUICell)) == 0) continue;
+        
+        // Multi-byte characters take fewer columns than cells, so a row
+        // holding any is always rewritten whole from its first column
+        if (!tui_row_is_ascii(back, cols) || !tui_row_is_ascii(front, cols)) {
+            platform_set_cursor_position(0, row);
+            for (int col = 0; col < cols; col++) {
+                tui_set_pen(tui, back[col].attr);
+                platform_write(&back[col].ch, 1);
+            }
+            cursor_row = -1;
+            continue;
+        }
+        
+        int col = 0;
+        while (col < cols) {
+            if (back[col].ch == front[col].ch && back[col].attr == front[col].attr) {
+                col++;
+                continue;
+            }
+            
+            // Extend the run over short stretches of unchanged cells
+            int end = col + 1;
+            int same = 0;
+            for (int i = col + 1; i < cols && same <= TUI_RUN_GAP; i++) {
+                if (back[i].ch == front[i].ch && back[i].attr == front[i].attr) {
+                    same++;
+                } else {
+                    same = 0;
+                    end = i + 1;
+                }
+            }
+            
+            if (cursor_row != row || cursor_col != col) {
+                platform_set_cursor_position(col, row);
+            }
+            for (int i = col; i < end; i++) {
+                tui_set_pen(tui, back[i].attr);
+                platform_write(&back[i].ch, 1);
+            }
+            cursor_row = row;
+            cursor_col = end;
+            col = end;
+        }
+    }
     
-    tui_reset_color();
+    memcpy(tui->front, tui->back, (size_t)tui->grid_rows * cols * sizeof(TUICell));
+    tui_set_pen(tui, TUI_ATTR_DEFAULT);
 }
 
 void tui_update_cursor(TUIState* tui) {
@@ -164,6 +586,7 @@ void tui_handle_resize(TUIState* tui) {
     if (new_cols != tui->cols || new_rows != tui->rows) {
         tui->cols = new_cols;
         tui->rows = new_rows;
+        tui_grid_reset(tui);
         
         // Adjust cursor position if needed
         if (tui->cursor_x >= new_cols - tui->line_num_width) {
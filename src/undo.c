@@ -0,0 +1,219 @@
+#include "undo.h"
+#include <stdlib.h>
+#include <string.h>
+
+// What a record owns, plus the add buffer text it inserts
+static size_t record_memory(const UndoRecord* record) {
+    size_t text = record->text || record->type == UNDO_INSERT ? record->length : 0;
+    return sizeof(UndoRecord) + text + record->added;
+}
+
+static void drop_record(UndoLog* log, UndoRecord* record) {
+    log->memory -= record_memory(record);
+    free(record->text);
+    record->text = NULL;
+}
+
+// Undone edits are forgotten once a new one is made
+static void drop_redo(UndoLog* log) {
+    while (log->count > log->current) {
+        drop_record(log, &log->records[--log->count]);
+    }
+}
+
+// Forget whole groups from the oldest end until the log fits its limit
+static void enforce_limit(UndoLog* log) {
+    while (log->memory > log->limit && log->first < log->current) {
+        unsigned int group = log->records[log->first].group;
+        while (log->first < log->current && log->records[log->first].group == group) {
+            drop_record(log, &log->records[log->first++]);
+        }
+    }
+}
+
+static UndoRecord* append_record(UndoLog* log) {
+    drop_redo(log);
+
+    // Reuse the slots of dropped records before growing
+    if (log->first > 0 && log->count == log->capacity) {
+        memmove(log->records, log->records + log->first, (log->count - log->first) * sizeof(UndoRecord));
+        log->count -= log->first;
+        log->current -= log->first;
+        log->first = 0;
+    }
+    if (log->count == log->capacity) {
+        size_t new_capacity = log->capacity ? log->capacity * 2 : 64;
+        UndoRecord* grown = (UndoRecord*)realloc(log->records, new_capacity * sizeof(UndoRecord));
+        if (!grown) return NULL;
+        log->records = grown;
+        log->capacity = new_capacity;
+    }
+
+    UndoRecord* record = &log->records[log->count++];
+    memset(record, 0, sizeof(UndoRecord));
+    record->group = log->group;
+    log->current = log->count;
+    log->sealed = 0;
+    return record;
+}
+
+// The newest record, if the next typed edit may still be folded into it
+static UndoRecord* open_record(UndoLog* log, int type) {
+    if (log->sealed || log->current == log->first || log->current != log->count) return NULL;
+
+    UndoRecord* record = &log->records[log->count - 1];
+    return record->type == type && record->typed ? record : NULL;
+}
+
+void undo_init(UndoLog* log) {
+    memset(log, 0, sizeof(UndoLog));
+    log->limit = UNDO_DEFAULT_LIMIT;
+}
+
+void undo_free(UndoLog* log) {
+    undo_clear(log);
+    free(log->records);
+    log->records = NULL;
+    log->capacity = 0;
+}
+
+void undo_clear(UndoLog* log) {
+    for (size_t i = log->first; i < log->count; i++) {
+        free(log->records[i].text);
+    }
+    log->first = 0;
+    log->current = 0;
+    log->count = 0;
+    log->memory = 0;
+    log->sealed = 0;
+}
+
+void undo_set_limit(UndoLog* log, size_t limit) {
+    log->limit = limit;
+    drop_redo(log);
+    enforce_limit(log);
+}
+
+// Every record made from here until the next call is undone as one step
+void undo_begin_group(UndoLog* log) {
+    log->group++;
+}
+
+// Stop the newest record from absorbing further typing, e.g. after an undo
+void undo_seal(UndoLog* log) {
+    log->sealed = 1;
+}
+
+int undo_record_insert(UndoLog* log, size_t offset, size_t source, size_t length, int typed) {
+    UndoRecord* record = open_record(log, UNDO_INSERT);
+
+    // Typing extends the run when it continues right where the last
+    // character went, both in the document and in the add buffer
+    if (record && typed && record->offset + record->length == offset &&
+        record->source + record->length == source) {
+        record->length += length;
+        log->memory += length;
+        enforce_limit(log);
+        return 1;
+    }
+
+    record = append_record(log);
+    if (!record) return 0;
+
+    record->type = UNDO_INSERT;
+    record->offset = offset;
+    record->length = length;
+    record->source = source;
+    record->typed = typed;
+    log->memory += record_memory(record);
+    enforce_limit(log);
+    return 1;
+}
+
+// Takes ownership of text, which must come from malloc
+int undo_record_delete(UndoLog* log, size_t offset, char* text, size_t length, int typed) {
+    UndoRecord* record = open_record(log, UNDO_DELETE);
+
+    // Backspace grows the run at its front, Delete at its back
+    if (record && typed && (offset + length == record->offset || offset == record->offset)) {
+        char* grown = (char*)realloc(record->text, record->length + length);
+        if (grown) {
+            if (offset == record->offset) {
+                memcpy(grown + record->length, text, length);
+            } else {
+                memmove(grown + length, grown, record->length);
+                memcpy(grown, text, length);
+                record->offset = offset;
+            }
+            record->text = grown;
+            record->length += length;
+            log->memory += length;
+            free(text);
+            enforce_limit(log);
+            return 1;
+        }
+    }
+
+    record = append_record(log);
+    if (!record) {
+        free(text);
+        return 0;
+    }
+
+    record->type = UNDO_DELETE;
+    record->offset = offset;
+    record->length = length;
+    record->text = text;
+    record->typed = typed;
+    log->memory += record_memory(record);
+    enforce_limit(log);
+    return 1;
+}
+
+// Takes ownership of version, which must come from malloc; length is its
+// size in bytes
+int undo_record_swap(UndoLog* log, size_t offset, char* version, size_t length) {
+    UndoRecord* record = append_record(log);
+    if (!record) {
+        free(version);
+        return 0;
+    }
+
+    record->type = UNDO_SWAP;
+    record->offset = offset;
+    record->length = length;
+    record->text = version;
+    log->memory += record_memory(record);
+    enforce_limit(log);
+    return 1;
+}
+
+// Takes ownership of edits, which must come from malloc; length is their
+// size in bytes, count the number of edits and added the add buffer bytes
+// they insert
+int undo_record_splice(UndoLog* log, size_t offset, char* edits, size_t length, size_t count, size_t added) {
+    UndoRecord* record = append_record(log);
+    if (!record) {
+        free(edits);
+        return 0;
+    }
+
+    record->type = UNDO_SPLICE;
+    record->offset = offset;
+    record->length = length;
+    record->source = count;
+    record->added = added;
+    record->text = edits;
+    log->memory += record_memory(record);
+    enforce_limit(log);
+    return 1;
+}
+
+// Hand a swap record the version that was just swapped out
+void undo_swap_version(UndoLog* log, UndoRecord* record, char* version, size_t length) {
+    log->memory -= record_memory(record);
+    free(record->text);
+    record->text = version;
+    record->length = length;
+    log->memory += record_memory(record);
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+// Checks that every keystroke is answered with a single write() of the
+// whole frame.
+//
+// Usage: frame_writes path/to/6r
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <unistd.h>
+#include "pty_trace.h"
+
+typedef struct {
+    const char* name;
+    const char* keys;
+} KeyCase;
+
+static const KeyCase key_cases[] = {
+    { "type a character", "x" },
+    { "cursor down", "\x1b[B" },
+    { "cursor right", "\x1b[C" },
+    { "page down", "\x1b[6~" },
+    { "page up", "\x1b[5~" },
+    { "backspace", "\x7f" },
+    { "enter", "\r" },
+    { "end", "\x1b[F" },
+};
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s path/to/6r\n", argv[0]);
+        return 2;
+    }
+
+    char document[64];
+    if (!pty_trace_make_document(document, sizeof(document), 1000)) {
+        perror("frame_writes: document");
+        return 2;
+    }
+    if (!pty_trace_start(argv[1], document, 24, 80)) {
+        perror("frame_writes: start");
+        unlink(document);
+        return 2;
+    }
+
+    size_t bytes;
+    int startup = pty_trace_frame(&bytes);
+    int failures = 0;
+    if (startup < 0) {
+        printf("FAIL  startup: the editor never waited for input\n");
+        failures++;
+    } else {
+        printf("      startup: %d writes (first paint and messages)\n", startup);
+    }
+
+    size_t count = sizeof(key_cases) / sizeof(key_cases[0]);
+    for (size_t i = 0; failures == 0 && i < count; i++) {
+        if (!pty_trace_send(key_cases[i].keys)) {
+            perror("frame_writes: key");
+            failures++;
+            break;
+        }
+
+        int writes = pty_trace_frame(&bytes);
+        int ok = writes == 1;
+        printf("%s  %s: %d writes, %llu bytes\n", ok ? "ok  " : "FAIL", key_cases[i].name, writes,
+               (unsigned long long)bytes);
+        if (!ok) failures++;
+    }
+
+    pty_trace_stop();
+    unlink(document);
+
+    if (failures > 0) {
+        printf("frame_writes: %d failed\n", failures);
+        return 1;
+    }
+    printf("frame_writes: every key drew its frame with one write\n");
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,157 @@
+#define _GNU_SOURCE
+#include "pty_trace.h"
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/ptrace.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+// Give up on a frame that has not finished by then
+#define FRAME_TIMEOUT_MS 5000
+
+static int master = -1;
+static pid_t child = -1;
+
+static long long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Keep the terminal's output queue empty so the editor never blocks in write
+static void drain(void) {
+    char data[65536];
+    while (read(master, data, sizeof(data)) > 0) {
+    }
+}
+
+int pty_trace_make_document(char* path, size_t size, int lines) {
+    snprintf(path, size, "/tmp/6r-pty-XXXXXX");
+    int fd = mkstemp(path);
+    if (fd < 0) return 0;
+
+    // Lines of different lengths and letters, so no two rows of the screen
+    // share much and redrawing one costs about its length
+    FILE* file = fdopen(fd, "w");
+    if (!file) return 0;
+    unsigned int seed = 1;
+    for (int i = 0; i < lines; i++) {
+        fprintf(file, "line %d:", i);
+        seed = seed * 1103515245 + 12345;
+        int length = 40 + (int)((seed >> 16) % 100);
+        for (int j = 0; j < length; j++) {
+            seed = seed * 1103515245 + 12345;
+            fputc((seed >> 16) % 6 == 0 ? ' ' : 'a' + (int)((seed >> 16) % 26), file);
+        }
+        fputc('\n', file);
+    }
+    return fclose(file) == 0;
+}
+
+int pty_trace_start(const char* editor, const char* document, int rows, int cols) {
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0) return 0;
+
+    struct winsize size = { (unsigned short)rows, (unsigned short)cols, 0, 0 };
+    ioctl(master, TIOCSWINSZ, &size);
+    const char* slave_name = ptsname(master);
+
+    child = fork();
+    if (child < 0) return 0;
+    if (child == 0) {
+        setsid();
+        int slave = open(slave_name, O_RDWR);
+        if (slave < 0) _exit(127);
+        ioctl(slave, TIOCSCTTY, 0);
+        dup2(slave, 0);
+        dup2(slave, 1);
+        dup2(slave, 2);
+        close(slave);
+        close(master);
+        setenv("TERM", "xterm", 1);
+
+        ptrace(PTRACE_TRACEME, 0, NULL, NULL);
+        raise(SIGSTOP);
+        execl(editor, editor, document, (char*)NULL);
+        _exit(127);
+    }
+
+    int status;
+    if (waitpid(child, &status, 0) < 0 || !WIFSTOPPED(status)) return 0;
+    ptrace(PTRACE_SETOPTIONS, child, NULL, PTRACE_O_TRACESYSGOOD | PTRACE_O_TRACEEXEC | PTRACE_O_EXITKILL);
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+    return ptrace(PTRACE_SYSCALL, child, NULL, NULL) == 0;
+}
+
+int pty_trace_send(const char* keys) {
+    return write(master, keys, strlen(keys)) == (ssize_t)strlen(keys);
+}
+
+// Whether a syscall entry is the editor waiting for input with no timeout
+static int is_idle_wait(const struct __ptrace_syscall_info* info) {
+#ifdef SYS_poll
+    if (info->entry.nr == SYS_poll) return (int)info->entry.args[2] < 0;
+#endif
+    if (info->entry.nr == SYS_ppoll) return info->entry.args[2] == 0;
+    return 0;
+}
+
+int pty_trace_frame(size_t* bytes) {
+    int writes = 0;
+    long long deadline = now_ms() + FRAME_TIMEOUT_MS;
+    *bytes = 0;
+
+    while (now_ms() < deadline) {
+        drain();
+
+        int status;
+        pid_t pid = waitpid(child, &status, WNOHANG);
+        if (pid < 0) return -1;
+        if (pid == 0) {
+            usleep(1000);
+            continue;
+        }
+        if (WIFEXITED(status) || WIFSIGNALED(status)) return -1;
+
+        int signal_number = 0;
+        if (WSTOPSIG(status) == (SIGTRAP | 0x80)) {
+            struct __ptrace_syscall_info info;
+            if (ptrace(PTRACE_GET_SYSCALL_INFO, child, (void*)sizeof(info), &info) > 0 &&
+                info.op == PTRACE_SYSCALL_INFO_ENTRY) {
+                long nr = (long)info.entry.nr;
+                if ((nr == SYS_write || nr == SYS_writev) && info.entry.args[0] == 1) {
+                    writes++;
+                    if (nr == SYS_write) *bytes += info.entry.args[2];
+                }
+                if (is_idle_wait(&info)) {
+                    ptrace(PTRACE_SYSCALL, child, NULL, NULL);
+                    return writes;
+                }
+            }
+        } else if (WSTOPSIG(status) != SIGTRAP) {
+            // Pass real signals on; the exec event stop is ours
+            signal_number = WSTOPSIG(status);
+        }
+        ptrace(PTRACE_SYSCALL, child, NULL, (void*)(long)signal_number);
+    }
+    return -1;
+}
+
+void pty_trace_stop(void) {
+    if (child > 0) {
+        kill(child, SIGKILL);
+        waitpid(child, NULL, 0);
+        child = -1;
+    }
+    if (master >= 0) {
+        close(master);
+        master = -1;
+    }
+}
\ No newline at end of file
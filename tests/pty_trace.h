@@ -0,0 +1,25 @@
+#ifndef PTY_TRACE_H
+#define PTY_TRACE_H
+
+#include <stddef.h>
+
+// Runs the editor on a pseudo terminal under ptrace and lets it draw one
+// frame at a time. A frame is everything the editor writes to the terminal
+// between reading a key and going back to wait for input with no timeout.
+// Linux only: syscalls are read with PTRACE_GET_SYSCALL_INFO.
+
+// Write a document of `lines` numbered lines of random words to a new
+// temp file
+int pty_trace_make_document(char* path, size_t size, int lines);
+
+int pty_trace_start(const char* editor, const char* document, int rows, int cols);
+int pty_trace_send(const char* keys);
+
+// Run until the editor waits for input again. Returns its write calls to
+// the terminal and their bytes through *bytes, or -1 if it exits or never
+// settles.
+int pty_trace_frame(size_t* bytes);
+
+void pty_trace_stop(void);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,95 @@
+// Checks that scrolling the view by a line sends far less than a redraw
+// of the text area: the terminal scrolls the rows it already shows and
+// only the row that comes into view is drawn.
+//
+// Usage: scroll_bytes path/to/6r
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <unistd.h>
+#include "pty_trace.h"
+
+#define ROWS 60
+#define COLS 200
+
+// Keys pressed before measuring, to get the cursor to the view's edge
+#define LEAD_IN 80
+
+// Scroll steps measured in each direction
+#define STEPS 20
+
+static int press(const char* keys, int times, size_t* total, size_t* worst) {
+    *total = 0;
+    *worst = 0;
+    for (int i = 0; i < times; i++) {
+        size_t bytes;
+        if (!pty_trace_send(keys) || pty_trace_frame(&bytes) < 0) return 0;
+        *total += bytes;
+        if (bytes > *worst) *worst = bytes;
+    }
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s path/to/6r\n", argv[0]);
+        return 2;
+    }
+
+    char document[64];
+    if (!pty_trace_make_document(document, sizeof(document), 3000)) {
+        perror("scroll_bytes: document");
+        return 2;
+    }
+    if (!pty_trace_start(argv[1], document, ROWS, COLS)) {
+        perror("scroll_bytes: start");
+        unlink(document);
+        return 2;
+    }
+
+    // The first paint draws every text row, which is what scrolling must beat
+    size_t redraw;
+    if (pty_trace_frame(&redraw) < 0) {
+        printf("FAIL  startup: the editor never waited for input\n");
+        pty_trace_stop();
+        unlink(document);
+        return 1;
+    }
+    printf("      first paint: %llu bytes\n", (unsigned long long)redraw);
+    size_t limit = redraw / 4;
+
+    size_t total, worst;
+    int failures = 0;
+
+    static const struct {
+        const char* name;
+        const char* keys;
+        int lead_in;
+    } cases[] = {
+        { "scroll down", "\x1b[B", LEAD_IN },
+        { "scroll up", "\x1b[A", LEAD_IN - STEPS },
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        if (!press(cases[i].keys, cases[i].lead_in, &total, &worst) ||
+            !press(cases[i].keys, STEPS, &total, &worst)) {
+            printf("FAIL  %s: the editor never settled\n", cases[i].name);
+            failures++;
+            break;
+        }
+        int ok = worst <= limit;
+        printf("%s  %s: %llu bytes per step, %llu at most (limit %llu)\n", ok ? "ok  " : "FAIL", cases[i].name,
+               (unsigned long long)(total / STEPS), (unsigned long long)worst, (unsigned long long)limit);
+        if (!ok) failures++;
+    }
+
+    pty_trace_stop();
+    unlink(document);
+
+    if (failures > 0) {
+        printf("scroll_bytes: %d failed\n", failures);
+        return 1;
+    }
+    printf("scroll_bytes: every scroll step sent less than a quarter of a redraw\n");
+    return 0;
+}
\ No newline at end of file